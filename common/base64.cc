@@ -0,0 +1,528 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/base64.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// The kernels are built with target attributes, so the rest of the code
+// doesn't require the instructions they use.
+#define BASE64_X86_KERNELS 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define BASE64_NEON_KERNEL 1
+#include <arm_neon.h>
+#endif
+
+namespace base64 {
+
+namespace {
+
+const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const uint8_t kInvalid = 0xff;
+
+// Vector kernels may store this much past the decoded data.
+const size_t kDecodeSlack = 32;
+
+// Kernels process whole blocks from the start of the input, and return how
+// many input bytes they consumed, a multiple of 3 for encoding and of 4 for
+// decoding. A decoding kernel stops before the first block holding an
+// invalid character, the scalar loop then reports it.
+typedef size_t (*EncodeKernel)(const uint8_t* in, size_t length, char* out);
+typedef size_t (*DecodeKernel)(const char* in, size_t length, uint8_t* out);
+
+pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+uint8_t g_decode_table[256];
+Kernel g_kernel = KERNEL_SCALAR;
+EncodeKernel g_encode = NULL;
+DecodeKernel g_decode = NULL;
+
+size_t EncodeScalar(const uint8_t* in, size_t length, char* out) {
+  size_t i = 0;
+  for (; i + 3 <= length; i += 3) {
+    uint32_t triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    *out++ = kAlphabet[triple >> 18];
+    *out++ = kAlphabet[(triple >> 12) & 0x3f];
+    *out++ = kAlphabet[(triple >> 6) & 0x3f];
+    *out++ = kAlphabet[triple & 0x3f];
+  }
+  return i;
+}
+
+size_t DecodeScalar(const char* in, size_t length, uint8_t* out) {
+  const uint8_t* table = g_decode_table;
+  size_t i = 0;
+  for (; i + 4 <= length; i += 4) {
+    uint32_t a = table[static_cast<uint8_t>(in[i])];
+    uint32_t b = table[static_cast<uint8_t>(in[i + 1])];
+    uint32_t c = table[static_cast<uint8_t>(in[i + 2])];
+    uint32_t d = table[static_cast<uint8_t>(in[i + 3])];
+    if ((a | b | c | d) & 0xc0)
+      break;
+    uint32_t quad = (a << 18) | (b << 12) | (c << 6) | d;
+    *out++ = quad >> 16;
+    *out++ = quad >> 8;
+    *out++ = quad;
+  }
+  return i;
+}
+
+#if defined(BASE64_X86_KERNELS)
+
+// The SSSE3 and AVX2 kernels follow Wojciech Muła's pshufb based
+// algorithms: bytes are spread to 6-bit indices with multiplies, and
+// mapped from and to ASCII with nibble lookup tables.
+
+__attribute__((target("ssse3")))
+__m128i EncodeBlockSSSE3(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  __m128i indices = _mm_or_si128(t1, t3);
+
+  __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+  const __m128i shift = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_mm_shuffle_epi8(shift, reduced), indices);
+}
+
+// Loads 16 bytes for each 12 encoded.
+__attribute__((target("ssse3")))
+size_t EncodeSSSE3(const uint8_t* in, size_t length, char* out) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 12, out += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     EncodeBlockSSSE3(block));
+  }
+  return i;
+}
+
+// Stores 16 bytes for each 12 decoded.
+__attribute__((target("ssse3")))
+size_t DecodeSSSE3(const char* in, size_t length, uint8_t* out) {
+  const __m128i lut_lo = _mm_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+  const __m128i zero = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16, out += 12) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(block, 4), mask_2f);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(block, mask_2f));
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)) !=
+        0xffff)
+      break;
+
+    __m128i eq_2f = _mm_cmpeq_epi8(block, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    __m128i values = _mm_add_epi8(block, roll);
+
+    __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), merged);
+  }
+  return i;
+}
+
+// Loads 28 bytes for each 24 encoded, 12 per 128-bit lane.
+__attribute__((target("avx2")))
+size_t EncodeAVX2(const uint8_t* in, size_t length, char* out) {
+  const __m256i spread = _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i shift = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+      '/' - 63, 'A', 0, 0);
+
+  size_t i = 0;
+  for (; i + 28 <= length; i += 24, out += 32) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    block = _mm256_shuffle_epi8(block, spread);
+
+    __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    __m256i indices = _mm256_or_si256(t1, t3);
+
+    __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    reduced = _mm256_or_si256(reduced,
+                              _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    __m256i encoded =
+        _mm256_add_epi8(_mm256_shuffle_epi8(shift, reduced), indices);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), encoded);
+  }
+  return i;
+}
+
+// Stores 32 bytes for each 24 decoded.
+__attribute__((target("avx2")))
+size_t DecodeAVX2(const char* in, size_t length, uint8_t* out) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i pack = _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32, out += 24) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(block, 4),
+                                          mask_2f);
+    __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(block, mask_2f));
+    __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    if (!_mm256_testz_si256(lo, hi))
+      break;
+
+    __m256i eq_2f = _mm256_cmpeq_epi8(block, mask_2f);
+    __m256i roll = _mm256_shuffle_epi8(lut_roll,
+                                       _mm256_add_epi8(eq_2f, hi_nibbles));
+    __m256i values = _mm256_add_epi8(block, roll);
+
+    __m256i merged =
+        _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    merged = _mm256_shuffle_epi8(merged, pack);
+    merged = _mm256_permutevar8x32_epi32(
+        merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), merged);
+  }
+  return i;
+}
+
+bool CPUHasSSSE3() {
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  return ecx & bit_SSSE3;
+}
+
+bool CPUHasAVX2() {
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  // The OS must also save the YMM registers.
+  if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+    return false;
+  unsigned xcr0_lo, xcr0_hi;
+  __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  if ((xcr0_lo & 0x6) != 0x6)
+    return false;
+
+  if (__get_cpuid_max(0, NULL) < 7)
+    return false;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return ebx & bit_AVX2;
+}
+
+#endif  // defined(BASE64_X86_KERNELS)
+
+#if defined(BASE64_NEON_KERNEL)
+
+// vld3/vst4 do the (de)interleaving, so each lane holds one position of
+// the 3 byte or 4 character groups.
+
+uint8x16_t IndexToASCII(uint8x16_t indices) {
+  uint8x16_t offset = vdupq_n_u8('A');
+  offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(26)),
+                                     vdupq_n_u8('a' - 26 - 'A')));
+  offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(52)),
+                                     vdupq_n_u8('0' - 52 - ('a' - 26))));
+  offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(62)),
+                                     vdupq_n_u8('+' - 62 - ('0' - 52))));
+  offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(63)),
+                                     vdupq_n_u8('/' - 63 - ('+' - 62))));
+  return vaddq_u8(indices, offset);
+}
+
+// Clears |valid| lanes holding characters outside the alphabet.
+uint8x16_t ASCIIToIndex(uint8x16_t c, uint8x16_t* valid) {
+  uint8x16_t upper = vcltq_u8(vsubq_u8(c, vdupq_n_u8('A')), vdupq_n_u8(26));
+  uint8x16_t lower = vcltq_u8(vsubq_u8(c, vdupq_n_u8('a')), vdupq_n_u8(26));
+  uint8x16_t digit = vcltq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(10));
+  uint8x16_t plus = vceqq_u8(c, vdupq_n_u8('+'));
+  uint8x16_t slash = vceqq_u8(c, vdupq_n_u8('/'));
+
+  uint8x16_t index = vandq_u8(upper, vsubq_u8(c, vdupq_n_u8('A')));
+  index = vorrq_u8(index, vandq_u8(lower, vsubq_u8(c, vdupq_n_u8('a' - 26))));
+  index = vorrq_u8(index, vandq_u8(digit, vaddq_u8(c, vdupq_n_u8(52 - '0'))));
+  index = vorrq_u8(index, vandq_u8(plus, vdupq_n_u8(62)));
+  index = vorrq_u8(index, vandq_u8(slash, vdupq_n_u8(63)));
+
+  uint8x16_t known = vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, plus));
+  *valid = vandq_u8(*valid, vorrq_u8(known, slash));
+  return index;
+}
+
+size_t EncodeNEON(const uint8_t* in, size_t length, char* out) {
+  size_t i = 0;
+  for (; i + 48 <= length; i += 48, out += 64) {
+    uint8x16x3_t bytes = vld3q_u8(in + i);
+    uint8x16x4_t chars;
+    chars.val[0] = vshrq_n_u8(bytes.val[0], 2);
+    chars.val[1] = vorrq_u8(
+        vshlq_n_u8(vandq_u8(bytes.val[0], vdupq_n_u8(0x03)), 4),
+        vshrq_n_u8(bytes.val[1], 4));
+    chars.val[2] = vorrq_u8(
+        vshlq_n_u8(vandq_u8(bytes.val[1], vdupq_n_u8(0x0f)), 2),
+        vshrq_n_u8(bytes.val[2], 6));
+    chars.val[3] = vandq_u8(bytes.val[2], vdupq_n_u8(0x3f));
+    for (int j = 0; j < 4; ++j)
+      chars.val[j] = IndexToASCII(chars.val[j]);
+    vst4q_u8(reinterpret_cast<uint8_t*>(out), chars);
+  }
+  return i;
+}
+
+size_t DecodeNEON(const char* in, size_t length, uint8_t* out) {
+  size_t i = 0;
+  for (; i + 64 <= length; i += 64, out += 48) {
+    uint8x16x4_t chars = vld4q_u8(reinterpret_cast<const uint8_t*>(in + i));
+    uint8x16_t valid = vdupq_n_u8(0xff);
+    uint8x16_t a = ASCIIToIndex(chars.val[0], &valid);
+    uint8x16_t b = ASCIIToIndex(chars.val[1], &valid);
+    uint8x16_t c = ASCIIToIndex(chars.val[2], &valid);
+    uint8x16_t d = ASCIIToIndex(chars.val[3], &valid);
+
+    uint8x8_t folded = vand_u8(vget_low_u8(valid), vget_high_u8(valid));
+    if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) != ~UINT64_C(0))
+      break;
+
+    uint8x16x3_t bytes;
+    bytes.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+    bytes.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+    bytes.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+    vst3q_u8(out, bytes);
+  }
+  return i;
+}
+
+#endif  // defined(BASE64_NEON_KERNEL)
+
+bool IsSupported(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR:
+      return true;
+#if defined(BASE64_X86_KERNELS)
+    case KERNEL_SSSE3:
+      return CPUHasSSSE3();
+    case KERNEL_AVX2:
+      return CPUHasAVX2();
+#endif
+#if defined(BASE64_NEON_KERNEL)
+    case KERNEL_NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+void SetKernel(Kernel kernel) {
+  g_kernel = kernel;
+  switch (kernel) {
+#if defined(BASE64_X86_KERNELS)
+    case KERNEL_SSSE3:
+      g_encode = EncodeSSSE3;
+      g_decode = DecodeSSSE3;
+      break;
+    case KERNEL_AVX2:
+      g_encode = EncodeAVX2;
+      g_decode = DecodeAVX2;
+      break;
+#endif
+#if defined(BASE64_NEON_KERNEL)
+    case KERNEL_NEON:
+      g_encode = EncodeNEON;
+      g_decode = DecodeNEON;
+      break;
+#endif
+    default:
+      g_kernel = KERNEL_SCALAR;
+      g_encode = EncodeScalar;
+      g_decode = DecodeScalar;
+      break;
+  }
+}
+
+void Init() {
+  for (int i = 0; i < 256; ++i)
+    g_decode_table[i] = kInvalid;
+  for (int i = 0; i < 64; ++i)
+    g_decode_table[static_cast<uint8_t>(kAlphabet[i])] = i;
+
+  const Kernel kPreferred[] = {
+    KERNEL_AVX2, KERNEL_SSSE3, KERNEL_NEON, KERNEL_SCALAR,
+  };
+  for (size_t i = 0; i < sizeof(kPreferred) / sizeof(kPreferred[0]); ++i) {
+    if (IsSupported(kPreferred[i])) {
+      SetKernel(kPreferred[i]);
+      break;
+    }
+  }
+}
+
+}  // namespace
+
+size_t EncodedLength(size_t length) {
+  return (length + 2) / 3 * 4;
+}
+
+void Encode(const char* data, size_t length, std::string* out) {
+  pthread_once(&g_init_once, Init);
+
+  out->resize(EncodedLength(length));
+  if (!length)
+    return;
+
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+  char* o = &(*out)[0];
+
+  size_t done = g_encode(in, length, o);
+  done += EncodeScalar(in + done, length - done, o + done / 3 * 4);
+  in += done;
+  o += done / 3 * 4;
+
+  switch (length - done) {
+    case 1:
+      o[0] = kAlphabet[in[0] >> 2];
+      o[1] = kAlphabet[(in[0] & 0x03) << 4];
+      o[2] = '=';
+      o[3] = '=';
+      break;
+    case 2:
+      o[0] = kAlphabet[in[0] >> 2];
+      o[1] = kAlphabet[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+      o[2] = kAlphabet[(in[1] & 0x0f) << 2];
+      o[3] = '=';
+      break;
+  }
+}
+
+std::string Encode(const std::string& data) {
+  std::string encoded;
+  Encode(data.data(), data.size(), &encoded);
+  return encoded;
+}
+
+bool Decode(const char* data, size_t length, std::string* out) {
+  pthread_once(&g_init_once, Init);
+
+  if (length && length % 4 == 0 && data[length - 1] == '=') {
+    --length;
+    if (data[length - 1] == '=')
+      --length;
+  }
+  if (length % 4 == 1)
+    return false;
+
+  size_t tail = length % 4;
+  size_t decoded_length = length / 4 * 3 + (tail ? tail - 1 : 0);
+  out->resize(decoded_length + kDecodeSlack);
+  uint8_t* o = reinterpret_cast<uint8_t*>(&(*out)[0]);
+
+  size_t done = g_decode(data, length - tail, o);
+  done += DecodeScalar(data + done, length - tail - done, o + done / 4 * 3);
+  if (done != length - tail) {
+    out->clear();
+    return false;
+  }
+  o += done / 4 * 3;
+
+  if (tail) {
+    uint32_t group = 0;
+    for (size_t i = 0; i < tail; ++i) {
+      uint8_t value = g_decode_table[static_cast<uint8_t>(data[done + i])];
+      if (value == kInvalid) {
+        out->clear();
+        return false;
+      }
+      group = (group << 6) | value;
+    }
+    if (tail == 2) {
+      o[0] = group >> 4;
+    } else {
+      o[0] = group >> 10;
+      o[1] = group >> 2;
+    }
+  }
+
+  out->resize(decoded_length);
+  return true;
+}
+
+Kernel ActiveKernel() {
+  pthread_once(&g_init_once, Init);
+  return g_kernel;
+}
+
+const char* KernelName(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_SSSE3:
+      return "ssse3";
+    case KERNEL_AVX2:
+      return "avx2";
+    case KERNEL_NEON:
+      return "neon";
+    default:
+      return "scalar";
+  }
+}
+
+bool UseKernel(Kernel kernel) {
+  pthread_once(&g_init_once, Init);
+  if (!IsSupported(kernel))
+    return false;
+  SetKernel(kernel);
+  return true;
+}
+
+}  // namespace base64
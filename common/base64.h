@@ -0,0 +1,45 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_BASE64_H_
+#define COMMON_BASE64_H_
+
+#include <stddef.h>
+
+#include <string>
+
+// Base64 (RFC 4648, standard alphabet) codec. The output is sized once up
+// front, and the bulk of the input goes through a vectorized kernel chosen
+// at runtime for the CPU: AVX2 or SSSE3 on x86, NEON on ARM builds that
+// enable it, and a table-driven scalar loop otherwise and for the tails.
+namespace base64 {
+
+enum Kernel {
+  KERNEL_SCALAR,
+  KERNEL_SSSE3,
+  KERNEL_AVX2,
+  KERNEL_NEON,
+};
+
+// Padding included.
+size_t EncodedLength(size_t length);
+
+// Replaces the contents of |out|.
+void Encode(const char* data, size_t length, std::string* out);
+std::string Encode(const std::string& data);
+
+// Decodes padded or unpadded input into |out|, replacing its contents.
+// Returns false on characters outside the alphabet or a truncated group.
+bool Decode(const char* data, size_t length, std::string* out);
+
+// The kernel in use, the best one the CPU supports unless overridden.
+Kernel ActiveKernel();
+const char* KernelName(Kernel kernel);
+// For benchmarks. Returns false, keeping the current kernel, if the CPU or
+// the build doesn't support |kernel|.
+bool UseKernel(Kernel kernel);
+
+}  // namespace base64
+
+#endif  // COMMON_BASE64_H_
@@ -0,0 +1,165 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the base64 codec throughput for each kernel the CPU supports,
+// and for the byte-at-a-time codec it replaced, over buffers of the sizes
+// FileStream.readBase64()/writeBase64() see. Prints one tab-separated line
+// per case: operation, kernel, buffer size, MB/s.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <string>
+
+#include "common/base64.h"
+
+namespace {
+
+const size_t kSizes[] = { 64, 4 * 1024, 256 * 1024, 4 * 1024 * 1024 };
+// Each case runs for about this long.
+const double kCaseSeconds = 0.5;
+
+double NowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The codec previously in filesystem_context.cc.
+const char* kChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmn"
+                     "opqrstuvwxyz0123456789+/";
+
+std::string LegacyEncode(std::string input) {
+  std::string encoded;
+  size_t input_len = input.length();
+
+  for (size_t i = 0; i < input_len;) {
+    unsigned triple = input[i];
+    i++;
+
+    triple <<= 8;
+    if (i < input_len)
+      triple |= input[i];
+    i++;
+
+    triple <<= 8;
+    if (i < input_len)
+      triple |= input[i];
+    i++;
+
+    encoded.push_back(kChars[(triple & 0xfc0000) >> 18]);
+    encoded.push_back(kChars[(triple & 0x3f000) >> 12]);
+    encoded.push_back((i > input_len + 1) ? '='
+                                          : kChars[(triple & 0xfc0) >> 6]);
+    encoded.push_back((i > input_len) ? '=' : kChars[triple & 0x3f]);
+  }
+
+  return encoded;
+}
+
+int LegacyDecodeOne(char c) {
+  if (c < '0') {
+    if (c == '+')
+      return 62;
+    if (c == '/')
+      return 63;
+    return -1;
+  }
+  if (c <= '9')
+    return c - '0' + 52;
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  return -1;
+}
+
+std::string LegacyDecode(std::string input) {
+  std::string decoded;
+  int input_len = input.length(), decoded_bits = 0, c = 0, i;
+
+  for (i = 0; i < input_len;) {
+    c = input[i++];
+    if (c == '=')
+      break;
+    int decoded_byte = LegacyDecodeOne(c);
+    if (decoded_byte < 0)
+      continue;
+
+    decoded_bits |= decoded_byte;
+    if (i % 4 == 0) {
+      decoded.push_back(static_cast<char>(decoded_bits >> 16));
+      decoded.push_back(static_cast<char>(decoded_bits >> 8));
+      decoded.push_back(static_cast<char>(decoded_bits));
+      decoded_bits = 0;
+    } else {
+      decoded_bits <<= 6;
+    }
+  }
+
+  return decoded;
+}
+
+void PrintResult(const char* operation, const char* kernel, size_t size,
+                 size_t iterations, double seconds) {
+  double megabytes = static_cast<double>(size) * iterations / (1024 * 1024);
+  printf("%s\t%s\t%zu\t%.1f\n", operation, kernel, size, megabytes / seconds);
+}
+
+// |legacy| runs the replaced codec instead of the current kernel.
+void RunCases(const std::string& data, const char* kernel, bool legacy) {
+  std::string encoded = base64::Encode(data);
+  std::string output;
+
+  size_t iterations = 0;
+  double start = NowSeconds();
+  double elapsed;
+  do {
+    if (legacy)
+      output = LegacyEncode(data);
+    else
+      base64::Encode(data.data(), data.size(), &output);
+    ++iterations;
+    elapsed = NowSeconds() - start;
+  } while (elapsed < kCaseSeconds);
+  PrintResult("encode", kernel, data.size(), iterations, elapsed);
+
+  iterations = 0;
+  start = NowSeconds();
+  do {
+    if (legacy)
+      output = LegacyDecode(encoded);
+    else if (!base64::Decode(encoded.data(), encoded.size(), &output))
+      abort();
+    ++iterations;
+    elapsed = NowSeconds() - start;
+  } while (elapsed < kCaseSeconds);
+  PrintResult("decode", kernel, data.size(), iterations, elapsed);
+}
+
+}  // namespace
+
+int main() {
+  const base64::Kernel kKernels[] = {
+    base64::KERNEL_SCALAR, base64::KERNEL_SSSE3, base64::KERNEL_AVX2,
+    base64::KERNEL_NEON,
+  };
+
+  printf("operation\tkernel\tbytes\tMB/s\n");
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+    std::string data(kSizes[i], '\0');
+    srand(kSizes[i]);
+    for (size_t j = 0; j < data.size(); ++j)
+      data[j] = static_cast<char>(rand());
+
+    RunCases(data, "legacy", true);
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k) {
+      if (base64::UseKernel(kKernels[k]))
+        RunCases(data, base64::KernelName(kKernels[k]), false);
+    }
+  }
+
+  return 0;
+}
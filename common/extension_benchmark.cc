@@ -0,0 +1,280 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/extension_benchmark.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <iostream>
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+}  // extern "C"
+
+namespace {
+
+uint64_t g_allocations = 0;
+pthread_mutex_t g_message_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+}  // namespace
+
+// Counting allocators. Benchmarks are linked with -rdynamic so these also
+// take precedence over the C library for the dlopen()ed extension module.
+extern "C" {
+
+void* malloc(size_t size) {
+  __sync_fetch_and_add(&g_allocations, 1);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  __sync_fetch_and_add(&g_allocations, 1);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  __sync_fetch_and_add(&g_allocations, 1);
+  return __libc_realloc(ptr, size);
+}
+
+}  // extern "C"
+
+namespace benchmark {
+
+ExtensionHost::ExtensionHost()
+    : module_(NULL),
+      next_instance_(1),
+      created_(NULL),
+      destroyed_(NULL),
+      handle_message_(NULL),
+      handle_sync_message_(NULL),
+      message_callback_(NULL),
+      message_callback_data_(NULL),
+      message_count_(0) {
+  // Instance 0 is never used by Crosswalk.
+  instance_data_.push_back(NULL);
+}
+
+bool ExtensionHost::Load(const std::string& module_path) {
+  module_ = dlopen(module_path.c_str(), RTLD_NOW);
+  if (!module_) {
+    std::cerr << "Can't load " << module_path << ": " << dlerror() << "\n";
+    return false;
+  }
+
+  XW_Initialize_Func initialize = reinterpret_cast<XW_Initialize_Func>(
+      dlsym(module_, "XW_Initialize"));
+  if (!initialize) {
+    std::cerr << module_path << " is not a Crosswalk extension.\n";
+    return false;
+  }
+
+  return initialize(1, ExtensionHost::GetInterface) == XW_OK;
+}
+
+XW_Instance ExtensionHost::CreateInstance() {
+  XW_Instance instance = next_instance_++;
+  instance_data_.push_back(NULL);
+  if (created_)
+    created_(instance);
+  return instance;
+}
+
+void ExtensionHost::DestroyInstance(XW_Instance instance) {
+  if (destroyed_)
+    destroyed_(instance);
+  instance_data_[instance] = NULL;
+}
+
+void ExtensionHost::PostMessage(XW_Instance instance,
+                                const std::string& message) {
+  if (handle_message_)
+    handle_message_(instance, message.c_str());
+}
+
+std::string ExtensionHost::SendSyncMessage(XW_Instance instance,
+                                           const std::string& message) {
+  sync_reply_.clear();
+  if (handle_sync_message_)
+    handle_sync_message_(instance, message.c_str());
+  return sync_reply_;
+}
+
+void ExtensionHost::SetMessageCallback(MessageCallback callback,
+                                       void* user_data) {
+  pthread_mutex_lock(&g_message_mutex);
+  message_callback_ = callback;
+  message_callback_data_ = user_data;
+  pthread_mutex_unlock(&g_message_mutex);
+}
+
+// static
+const void* ExtensionHost::GetInterface(const char* name) {
+  static const XW_CoreInterface kCoreInterface = {
+    ExtensionHost::SetExtensionName,
+    ExtensionHost::SetJavaScriptAPI,
+    ExtensionHost::RegisterInstanceCallbacks,
+    ExtensionHost::RegisterShutdownCallback,
+    ExtensionHost::SetInstanceData,
+    ExtensionHost::GetInstanceData
+  };
+  static const XW_MessagingInterface kMessagingInterface = {
+    ExtensionHost::RegisterMessage,
+    ExtensionHost::OnPostMessage
+  };
+  static const XW_Internal_SyncMessagingInterface kSyncMessagingInterface = {
+    ExtensionHost::RegisterSyncMessage,
+    ExtensionHost::OnSetSyncReply
+  };
+
+  if (strcmp(name, XW_CORE_INTERFACE) == 0)
+    return &kCoreInterface;
+  if (strcmp(name, XW_MESSAGING_INTERFACE) == 0)
+    return &kMessagingInterface;
+  if (strcmp(name, XW_INTERNAL_SYNC_MESSAGING_INTERFACE) == 0)
+    return &kSyncMessagingInterface;
+
+  // Optional interfaces, extensions cope with their absence.
+  return NULL;
+}
+
+// static
+void ExtensionHost::SetExtensionName(XW_Extension, const char* name) {
+  GetInstance().name_ = name;
+}
+
+// static
+void ExtensionHost::SetJavaScriptAPI(XW_Extension, const char*) {}
+
+// static
+void ExtensionHost::RegisterInstanceCallbacks(
+    XW_Extension,
+    XW_CreatedInstanceCallback created,
+    XW_DestroyedInstanceCallback destroyed) {
+  GetInstance().created_ = created;
+  GetInstance().destroyed_ = destroyed;
+}
+
+// static
+void ExtensionHost::RegisterShutdownCallback(XW_Extension,
+                                             XW_ShutdownCallback) {}
+
+// static
+void ExtensionHost::SetInstanceData(XW_Instance instance, void* data) {
+  GetInstance().instance_data_[instance] = data;
+}
+
+// static
+void* ExtensionHost::GetInstanceData(XW_Instance instance) {
+  return GetInstance().instance_data_[instance];
+}
+
+// static
+void ExtensionHost::RegisterMessage(XW_Extension,
+                                    XW_HandleMessageCallback handle_message) {
+  GetInstance().handle_message_ = handle_message;
+}
+
+// static
+void ExtensionHost::OnPostMessage(XW_Instance instance, const char* message) {
+  ExtensionHost& host = GetInstance();
+
+  pthread_mutex_lock(&g_message_mutex);
+  host.message_count_++;
+  host.last_message_ = message;
+  if (host.message_callback_)
+    host.message_callback_(instance, message, host.message_callback_data_);
+  pthread_mutex_unlock(&g_message_mutex);
+}
+
+// static
+void ExtensionHost::RegisterSyncMessage(
+    XW_Extension,
+    XW_HandleSyncMessageCallback handle_message) {
+  GetInstance().handle_sync_message_ = handle_message;
+}
+
+// static
+void ExtensionHost::OnSetSyncReply(XW_Instance, const char* reply) {
+  GetInstance().sync_reply_ = reply;
+}
+
+uint64_t AllocationCount() {
+  return __sync_fetch_and_add(&g_allocations, 0);
+}
+
+int64_t NowMicroseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+Measurement::Measurement(const std::string& name)
+    : name_(name),
+      allocations_(0),
+      bytes_(0),
+      start_time_(0),
+      start_allocations_(0) {}
+
+void Measurement::Start() {
+  start_allocations_ = AllocationCount();
+  start_time_ = NowMicroseconds();
+}
+
+void Measurement::Stop() {
+  int64_t elapsed = NowMicroseconds() - start_time_;
+  allocations_ += AllocationCount() - start_allocations_;
+  samples_.push_back(elapsed);
+}
+
+void Measurement::Stop(uint64_t bytes) {
+  Stop();
+  bytes_ += bytes;
+}
+
+// static
+void Measurement::PrintHeader() {
+  printf("case\tcalls\tmean_us\tp50_us\tp99_us\tmax_us\tallocs_per_call"
+         "\tmb_per_s\n");
+}
+
+void Measurement::Print() const {
+  if (samples_.empty()) {
+    printf("%s\t0\t-\t-\t-\t-\t-\t-\n", name_.c_str());
+    return;
+  }
+
+  std::vector<int64_t> sorted(samples_);
+  std::sort(sorted.begin(), sorted.end());
+
+  int64_t total = 0;
+  for (size_t i = 0; i < sorted.size(); ++i)
+    total += sorted[i];
+
+  size_t calls = sorted.size();
+  printf("%s\t%zu\t%.1f\t%lld\t%lld\t%lld\t%.1f\t",
+         name_.c_str(),
+         calls,
+         static_cast<double>(total) / calls,
+         static_cast<long long>(sorted[calls / 2]),  // NOLINT
+         static_cast<long long>(sorted[(calls * 99) / 100]),  // NOLINT
+         static_cast<long long>(sorted[calls - 1]),  // NOLINT
+         static_cast<double>(allocations_) / calls);
+  if (bytes_ && total)
+    printf("%.1f\n", bytes_ / (1024.0 * 1024.0) / (total / 1e6));
+  else
+    printf("-\n");
+  fflush(stdout);
+}
+
+}  // namespace benchmark
@@ -0,0 +1,124 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_EXTENSION_BENCHMARK_H_
+#define COMMON_EXTENSION_BENCHMARK_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "common/XW_Extension.h"
+#include "common/XW_Extension_SyncMessage.h"
+#include "common/utils.h"
+
+namespace benchmark {
+
+// Loads an extension module the way Crosswalk does, through dlopen() and
+// XW_Initialize(), and provides it with fake XW interfaces so its instances
+// can be driven without a runtime. Messages posted by the extension are
+// counted and the last one is kept.
+class ExtensionHost {
+ public:
+  typedef void (*MessageCallback)(XW_Instance instance, const char* message,
+                                  void* user_data);
+
+  static ExtensionHost& GetInstance() {
+    static ExtensionHost instance;
+    return instance;
+  }
+
+  bool Load(const std::string& module_path);
+
+  XW_Instance CreateInstance();
+  void DestroyInstance(XW_Instance instance);
+
+  void PostMessage(XW_Instance instance, const std::string& message);
+  std::string SendSyncMessage(XW_Instance instance,
+                              const std::string& message);
+
+  // Called, possibly from another thread, for every message posted by the
+  // extension.
+  void SetMessageCallback(MessageCallback callback, void* user_data);
+
+  uint64_t message_count() const { return message_count_; }
+  const std::string& last_message() const { return last_message_; }
+  const std::string& name() const { return name_; }
+
+ private:
+  ExtensionHost();
+
+  static const void* GetInterface(const char* name);
+
+  static void SetExtensionName(XW_Extension extension, const char* name);
+  static void SetJavaScriptAPI(XW_Extension extension, const char* api);
+  static void RegisterInstanceCallbacks(XW_Extension extension,
+                                        XW_CreatedInstanceCallback created,
+                                        XW_DestroyedInstanceCallback destroyed);
+  static void RegisterShutdownCallback(XW_Extension extension,
+                                       XW_ShutdownCallback shutdown);
+  static void SetInstanceData(XW_Instance instance, void* data);
+  static void* GetInstanceData(XW_Instance instance);
+  static void RegisterMessage(XW_Extension extension,
+                              XW_HandleMessageCallback handle_message);
+  static void OnPostMessage(XW_Instance instance, const char* message);
+  static void RegisterSyncMessage(XW_Extension extension,
+                                  XW_HandleSyncMessageCallback handle_message);
+  static void OnSetSyncReply(XW_Instance instance, const char* reply);
+
+  void* module_;
+  std::string name_;
+  XW_Instance next_instance_;
+  std::vector<void*> instance_data_;
+
+  XW_CreatedInstanceCallback created_;
+  XW_DestroyedInstanceCallback destroyed_;
+  XW_HandleMessageCallback handle_message_;
+  XW_HandleSyncMessageCallback handle_sync_message_;
+
+  MessageCallback message_callback_;
+  void* message_callback_data_;
+  uint64_t message_count_;
+  std::string last_message_;
+  std::string sync_reply_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExtensionHost);
+};
+
+// Number of malloc(), calloc() and realloc() calls made by the process so
+// far, extension modules included.
+uint64_t AllocationCount();
+
+// Monotonic clock, in microseconds.
+int64_t NowMicroseconds();
+
+// Collects per-call samples of a benchmark case and reports them as one
+// tab-separated line: name, calls, mean, p50, p99 and max latency in
+// microseconds, allocations per call, and MB/s for the cases that process
+// bytes.
+class Measurement {
+ public:
+  explicit Measurement(const std::string& name);
+
+  void Start();
+  void Stop();
+  // For a call that processed |bytes|.
+  void Stop(uint64_t bytes);
+
+  static void PrintHeader();
+  void Print() const;
+
+ private:
+  std::string name_;
+  std::vector<int64_t> samples_;
+  uint64_t allocations_;
+  uint64_t bytes_;
+  int64_t start_time_;
+  uint64_t start_allocations_;
+};
+
+}  // namespace benchmark
+
+#endif  // COMMON_EXTENSION_BENCHMARK_H_
@@ -8,17 +8,116 @@
       'type': 'loadable_module',
       'variables': {
         'packages': [
-          'capi-appfw-application',
+          'glib-2.0',
+          'zlib',
         ],
       },
+      'conditions': [
+        ['tizen == 1', {
+          'variables': { 'packages': ['capi-appfw-application'] },
+        }],
+        ['extension_host_os == "desktop"', {
+          'variables': { 'packages': ['libudev'] },
+        }],
+      ],
       'sources': [
         'filesystem_api.js',
+        'filesystem_archive_job.cc',
+        'filesystem_archive_job.h',
+        'filesystem_batch_job.cc',
+        'filesystem_batch_job.h',
+        'filesystem_charset.cc',
+        'filesystem_charset.h',
         'filesystem_context.cc',
         'filesystem_context.h',
+        'filesystem_copy_job.cc',
+        'filesystem_copy_job.h',
+        'filesystem_delete_job.cc',
+        'filesystem_delete_job.h',
+        'filesystem_find_job.cc',
+        'filesystem_find_job.h',
+        'filesystem_hash.cc',
+        'filesystem_hash.h',
+        'filesystem_hash_job.cc',
+        'filesystem_hash_job.h',
+        'filesystem_job.cc',
+        'filesystem_job.h',
+        'filesystem_list_job.cc',
+        'filesystem_list_job.h',
+        'filesystem_root_table.cc',
+        'filesystem_root_table.h',
+        'filesystem_storage.cc',
+        'filesystem_storage.h',
+        'filesystem_storage_desktop.cc',
+        'filesystem_storage_tizen.cc',
+        'filesystem_stream.cc',
+        'filesystem_stream.h',
+        'filesystem_tree_walker.cc',
+        'filesystem_tree_walker.h',
+        'filesystem_usage_job.cc',
+        'filesystem_usage_job.h',
+        'filesystem_utils.cc',
+        'filesystem_utils.h',
+        'filesystem_watcher.cc',
+        'filesystem_watcher.h',
+        'filesystem_worker_pool.cc',
+        'filesystem_worker_pool.h',
+        '../common/base64.cc',
+        '../common/base64.h',
       ],
       'includes': [
         '../common/pkg-config.gypi',
       ],
+      'libraries': [
+        '-lpthread',
+      ],
     },
   ],
+  'conditions': [
+    ['build_benchmarks == 1', {
+      'targets': [
+        {
+          'target_name': 'base64_benchmark',
+          'type': 'executable',
+          'libraries': [
+            '-lpthread',
+          ],
+          'sources': [
+            '../common/base64.cc',
+            '../common/base64.h',
+            '../common/base64_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'filesystem_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'tizen_filesystem',
+          ],
+          'variables': {
+            'packages': [
+              'glib-2.0',
+            ]
+          },
+          'includes': [
+            '../common/pkg-config.gypi',
+          ],
+          'ldflags': [
+            # Lets the counting allocators override the ones of the C library
+            # for the dlopen()ed extension module.
+            '-rdynamic',
+          ],
+          'libraries': [
+            '-ldl',
+            '-lpthread',
+          ],
+          'sources': [
+            'filesystem_benchmark.cc',
+            '../common/extension_benchmark.cc',
+            '../common/extension_benchmark.h',
+          ],
+        },
+      ],
+    }],
+  ],
 }
@@ -3,11 +3,14 @@
 // found in the LICENSE file.
 
 var _callbacks = {};
+var _progress_callbacks = {};
 var _next_reply_id = 0;
 
 var _listeners = {};
 var _next_listener_id = 0;
 
+var _watch_callbacks = {};
+
 var getNextReplyId = function() {
   return _next_reply_id++;
 };
@@ -25,12 +28,23 @@ var postMessage = function(msg, callback) {
   _callbacks[reply_id] = callback;
   msg.reply_id = reply_id;
   extension.postMessage(JSON.stringify(msg));
+  return reply_id;
 };
 
 extension.setMessageListener(function(json) {
   var msg = JSON.parse(json);
-  if (msg.cmd === 'storageChanged') {
-    handleStorageChanged(msg);
+  if (msg.cmd === 'storagesChanged') {
+    handleStoragesChanged(msg);
+  } else if (msg.cmd === 'FileWatchEvents') {
+    var onchange = _watch_callbacks[msg.watchId];
+    if (typeof(onchange) === 'function')
+      onchange(msg.events);
+  } else if (msg.cmd === 'FileJobProgress' ||
+             msg.cmd === 'FileListFilesChunk' ||
+             msg.cmd === 'FileFindChunk') {
+    var progress = _progress_callbacks[msg.reply_id];
+    if (typeof(progress) === 'function')
+      progress(msg);
   } else {
     var reply_id = msg.reply_id;
     var callback = _callbacks[reply_id];
@@ -38,6 +52,7 @@ extension.setMessageListener(function(json) {
       callback(msg);
       delete msg.reply_id;
       delete _callbacks[reply_id];
+      delete _progress_callbacks[reply_id];
     } else {
       console.log('Invalid reply_id from Tizen Filesystem: ' + reply_id);
     }
@@ -87,6 +102,7 @@ function FileSystemManager() {
     },
     enumerable: true
   });
+  defineReadOnlyProperty(this, 'archive', new ArchiveManager());
 }
 
 FileSystemManager.prototype.resolve = function(location, onsuccess,
@@ -152,10 +168,14 @@ FileSystemManager.prototype.listStorages = function(onsuccess, onerror) {
   });
 };
 
-function handleStorageChanged(msg) {
-  var storage = msg.storage;
-  _listeners.forEach(function(id) {
-    _listeners[id](new FileSystemStorage(storage.label, storage.type, storage.state))
+// A burst of changes, such as the partitions of a card being mounted, comes
+// as one message with the storages whose state changed.
+function handleStoragesChanged(msg) {
+  msg.storages.forEach(function(storage) {
+    for (var id in _listeners) {
+      _listeners[id](new FileSystemStorage(storage.label, storage.type,
+                                           storage.state));
+    }
   });
 }
 
@@ -171,14 +191,210 @@ FileSystemManager.prototype.addStorageStateChangeListener = function(onsuccess,
 };
 
 FileSystemManager.prototype.removeStorageStateChangeListener = function(watchId) {
-  if (!(typeof(watchId) !== 'number'))
+  if (typeof(watchId) !== 'number')
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
-  var index = _listeners.indexOf(watchId);
-  if (~index)
-    _listeners.slice(index, 1);
-  else
+  if (!_listeners.hasOwnProperty(watchId))
     throw new tizen.WebAPIException(tizen.WebAPIException.NOT_FOUND_ERR);
+  delete _listeners[watchId];
+};
+
+// Calls onchange(events) with the changes below |directory|, a File or a
+// virtual path, instead of polling it with listFiles(). Each event has a
+// type ('created', 'modified', 'deleted' or 'overflow' when events were
+// lost), a fullPath and isDirectory. Events are coalesced over 100 ms.
+// With options.recursive, subdirectories are watched too.
+FileSystemManager.prototype.addDirectoryWatch = function(directory, onchange,
+    options) {
+  if (!(onchange instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var fullPath = directory instanceof File ? directory.fullPath : directory;
+  if (!is_string(fullPath))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var result = sendSyncMessage('FileAddDirectoryWatch', {
+    fullPath: fullPath,
+    recursive: !!(options && options.recursive)
+  });
+  if (result.isError)
+    throw new tizen.WebAPIException(result.errorCode);
+
+  _watch_callbacks[result.value] = onchange;
+  return result.value;
+};
+
+FileSystemManager.prototype.removeWatch = function(watchId) {
+  if (typeof(watchId) !== 'number')
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var result = sendSyncMessage('FileRemoveWatch', { watchId: watchId });
+  if (result.isError)
+    throw new tizen.WebAPIException(result.errorCode);
+
+  delete _watch_callbacks[watchId];
+};
+
+// Passes onsuccess(usage) the usage of the tree below |directory|, a File
+// or a virtual path such as a storage label: bytes, allocatedBytes, files,
+// directories, and extensions with the files and bytes per lowercase
+// extension. Results are kept natively until something in the tree
+// changes, so repeated calls are immediate.
+FileSystemManager.prototype.getDirectoryUsage = function(directory, onsuccess,
+    onerror) {
+  if (!(onsuccess instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      arguments.length > 2)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var fullPath = directory instanceof File ? directory.fullPath : directory;
+  if (!is_string(fullPath))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var jobId = postMessage({
+    cmd: 'FileGetDirectoryUsage',
+    fullPath: fullPath
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+    } else {
+      onsuccess(result.value);
+    }
+  });
+
+  return new FileJob(jobId);
+};
+
+// Runs copies, moves and deletions in one message. Each operation is
+// {type: 'copy' or 'move', originFilePath, destinationFilePath, overwrite}
+// or {type: 'delete', path, recursive}, with full virtual paths. onsuccess
+// gets one result per operation, in order, with an error for the failed
+// ones: the batch itself fails only when it is cancelled.
+// options: stopOnError, parallelism, onprogress(finishedCount, totalCount).
+FileSystemManager.prototype.batch = function(operations, onsuccess, onerror,
+    options) {
+  if (!(operations instanceof Array))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onsuccess !== null && !(onsuccess instanceof Function) &&
+      arguments.length > 1)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      arguments.length > 2)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options !== null && typeof(options) !== 'object' &&
+      arguments.length > 3)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  options = options || {};
+
+  var jobId = postMessage({
+    cmd: 'FileBatch',
+    operations: operations,
+    stopOnError: !!options.stopOnError,
+    parallelism: is_integer(options.parallelism) ?
+        Number(options.parallelism) : undefined
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+      return;
+    }
+    if (!onsuccess)
+      return;
+
+    var results = result.value.map(function(item) {
+      if (!item.isError)
+        return { isError: false };
+      return { isError: true, error: new tizen.WebAPIError(item.errorCode) };
+    });
+    onsuccess(results);
+  });
+  if (options.onprogress instanceof Function) {
+    _progress_callbacks[jobId] = function(progress) {
+      options.onprogress(progress.processed, progress.total);
+    };
+  }
+
+  return new FileJob(jobId);
+};
+
+// Zip, tar and gzipped tar archives, handled natively and streamed, so
+// archives of any size can be used. Both methods take full virtual paths or
+// Files, and options: overwrite and onprogress(processedBytes, totalBytes).
+function ArchiveManager() {
+}
+
+function toFullPath(location) {
+  var fullPath = location instanceof File ? location.fullPath : location;
+  if (!is_string(fullPath))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  return fullPath;
+}
+
+function postArchiveMessage(message, onsuccess, onerror, options) {
+  if (onsuccess !== null && !(onsuccess instanceof Function) &&
+      onsuccess !== undefined)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      onerror !== undefined)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options !== null && options !== undefined &&
+      typeof(options) !== 'object')
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  options = options || {};
+  message.overwrite = !!options.overwrite;
+
+  var jobId = postMessage(message, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+    } else if (onsuccess) {
+      onsuccess();
+    }
+  });
+  if (options.onprogress instanceof Function) {
+    _progress_callbacks[jobId] = function(progress) {
+      options.onprogress(progress.processed, progress.total);
+    };
+  }
+
+  return new FileJob(jobId);
+}
+
+// Extracts |archive| below the |destination| directory. Entries that would
+// land outside of it fail the extraction, and links are skipped.
+ArchiveManager.prototype.extract = function(archive, destination, onsuccess,
+    onerror, options) {
+  return postArchiveMessage({
+    cmd: 'FileExtractArchive',
+    archivePath: toFullPath(archive),
+    destinationPath: toFullPath(destination)
+  }, onsuccess, onerror, options);
+};
+
+// Archives the files and directories in |sources| to |destination|, in
+// options.format, 'zip', 'tar' or 'tar.gz', or else the format its
+// extension names. options.level is the compression level, 0 to 9.
+ArchiveManager.prototype.create = function(sources, destination, onsuccess,
+    onerror, options) {
+  if (!(sources instanceof Array))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options && options.format !== undefined && !is_string(options.format))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options && options.level !== undefined && !is_integer(options.level))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  return postArchiveMessage({
+    cmd: 'FileCreateArchive',
+    sources: sources.map(toFullPath),
+    destinationPath: toFullPath(destination),
+    format: options ? options.format : undefined,
+    level: options && options.level !== undefined ?
+        Number(options.level) : undefined
+  }, onsuccess, onerror, options);
 };
 
 function FileFilter(name, startModified, endModified, startCreated, endCreated) {
@@ -243,13 +459,12 @@ function FileStream(streamID, encoding) {
     return status.bytesAvailable;
   };
 
-  defineReadOnlyProperty(this, 'eof', false);
-  defineReadOnlyProperty(this, 'bytesAvailable', 0);
-
   Object.defineProperties(this, {
     'streamID': { get: getStreamID, enumerable: false },
     'encoding': { get: getEncoding, enumerable: false },
-    'position': { get: getPosition, set: setPosition, enumerable: true }
+    'position': { get: getPosition, set: setPosition, enumerable: true },
+    'eof': { get: isEof, enumerable: true },
+    'bytesAvailable': { get: getBytesAvailable, enumerable: true }
   });
 }
 
@@ -349,22 +564,58 @@ FileStream.prototype.writeBase64 = function(base64Data) {
     throw new tizen.WebAPIException(result.errorCode);
 };
 
-function File(fullPath, parent) {
+// Writes are buffered natively until the stream is read, repositioned or
+// closed. flush() hands them to the system, and with |sync| also waits for
+// them to reach the storage.
+FileStream.prototype.flush = function(sync) {
+  var result = sendSyncMessage('FileStreamFlush', {
+    streamID: this.streamID,
+    sync: !!sync
+  });
+  if (result.isError)
+    throw new tizen.WebAPIException(result.errorCode);
+};
+
+// Handle on a native job, like a copy, that can be cancelled. The job then
+// fails with ABORT_ERR.
+function FileJob(jobId) {
+  defineReadOnlyProperty(this, 'jobId', jobId);
+}
+
+FileJob.prototype.cancel = function() {
+  extension.postMessage(JSON.stringify({
+    cmd: 'FileCancelJob',
+    jobId: this.jobId
+  }));
+};
+
+// Attributes delivered along with a directory listing stay valid for this
+// long, in ms, enough for the listing to be rendered without a FileStat per
+// entry. Those queried with FileStat are kept for 5 ms.
+var _listing_stat_ttl = 1000;
+
+function File(fullPath, parent, initialStat) {
   this.fullPath = fullPath;
   this.parent = parent;
 
   var stat_cached = undefined;
-  var stat_last_time = undefined;
+  var stat_expires = 0;
+
+  if (initialStat) {
+    initialStat.isError = false;
+    stat_cached = { isError: false, value: initialStat };
+    stat_expires = Date.now() + _listing_stat_ttl;
+  }
 
   function stat() {
     var now = Date.now();
-    if (stat_cached === undefined || (now - stat_last_time) > 5) {
+    if (stat_cached === undefined || now > stat_expires) {
       var result = sendSyncMessage('FileStat', { fullPath: fullPath });
       if (result.isError)
         return result;
 
       stat_cached = result;
-      stat_last_time = now;
+      stat_expires = now + 5;
       result.value.isError = result.isError;
       return result.value;
     }
@@ -456,7 +707,49 @@ File.prototype.toURI = function() {
   return status.value;
 };
 
-File.prototype.listFiles = function(onsuccess, onerror, filter) {
+// Hands the file to the renderer without its bytes crossing the message
+// channel: the permissions are checked once here, and the returned uri, of
+// the file itself, is read directly, e.g. as a media or image source.
+// options.offset and options.length describe a byte range, as advisory
+// metadata only: the uri still gives access to the whole file. Returns
+// {uri, size, offset, length, lastModified, etag, headers}, headers being
+// the Last-Modified, ETag, Cache-Control, Content-Length and, for a range,
+// Content-Range to serve or cache that range with.
+File.prototype.exportURI = function(options) {
+  if (options !== null && options !== undefined &&
+      typeof(options) !== 'object')
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  options = options || {};
+  if (options.offset !== undefined && !is_integer(options.offset))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options.length !== undefined && !is_integer(options.length))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var status = sendSyncMessage('FileExportURI', {
+    fullPath: this.fullPath,
+    offset: options.offset !== undefined ? Number(options.offset) : undefined,
+    length: options.length !== undefined ? Number(options.length) : undefined
+  });
+  if (status.isError)
+    throw new tizen.WebAPIException(status.errorCode);
+
+  var result = status.value;
+  return {
+    uri: result.uri,
+    size: result.size,
+    offset: result.offset,
+    length: result.length,
+    lastModified: new Date(result.modified * 1000),
+    etag: result.etag,
+    headers: result.headers
+  };
+};
+
+// options.offset, options.limit - optional, list a page of the directory
+// options.onchunk(files), options.chunkSize - optional, deliver the entries
+//   of huge directories in batches; onsuccess then gets the last batch
+File.prototype.listFiles = function(onsuccess, onerror, filter, options) {
   if (!(onsuccess instanceof Function))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (onerror !== null && !(onerror instanceof Function) &&
@@ -465,32 +758,174 @@ File.prototype.listFiles = function(onsuccess, onerror, filter) {
   if (filter !== null && !(filter instanceof FileFilter) &&
       arguments.length > 2)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options !== null && typeof(options) !== 'object' &&
+      arguments.length > 3)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
-  postMessage({
+  options = options || {};
+  var onchunk = options.onchunk instanceof Function ? options.onchunk : null;
+
+  // Entries come with their attributes, to seed the stat cache of each File.
+  var toFiles = function(entries) {
+    var file_list = [];
+    for (var i = 0; i < entries.length; i++) {
+      var entry = entries[i];
+      if (is_string(entry))
+        file_list.push(new File(entry, this));
+      else
+        file_list.push(new File(entry.fullPath, this,
+                                entry.size !== undefined ? entry : undefined));
+    }
+    return file_list;
+  }.bind(this);
+
+  var jobId = postMessage({
     cmd: 'FileListFiles',
     fullPath: this.fullPath,
-    filter: filter ? filter.toString() : ''
+    filter: filter ? filter.toString() : '',
+    withStat: true,
+    offset: is_integer(options.offset) ? Number(options.offset) : undefined,
+    limit: is_integer(options.limit) ? Number(options.limit) : undefined,
+    chunkSize: onchunk ? (Number(options.chunkSize) || 500) : undefined
   }, function(result) {
     if (result.isError) {
       if (onerror)
         onerror(new tizen.WebAPIError(result.errorCode));
     } else if (onsuccess) {
-      var file_list = [];
+      onsuccess(toFiles(result.value));
+    }
+  });
+  if (onchunk) {
+    _progress_callbacks[jobId] = function(chunk) {
+      onchunk(toFiles(chunk.value));
+    };
+  }
+};
+
+File.prototype.find = function(onsuccess, onerror, options) {
+  if (!(onsuccess instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      arguments.length > 1)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options !== null && typeof(options) !== 'object' &&
+      arguments.length > 2)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (!this.isDirectory)
+    throw new tizen.WebAPIException(tizen.WebAPIException.IO_ERR);
 
-      for (var i = 0; i < result.value.length; i++)
-        file_list.push(new File(result.value[i], getFileParent(result.value[i])));
+  options = options || {};
+  var onchunk = options.onchunk instanceof Function ? options.onchunk : null;
 
-      onsuccess(file_list);
+  var regex = options.regex;
+  var ignoreCase = !!options.ignoreCase;
+  if (regex instanceof RegExp) {
+    ignoreCase = ignoreCase || regex.ignoreCase;
+    regex = regex.source;
+  }
+  var toTime = function(date) {
+    if (date instanceof Date)
+      return date.getTime();
+    return is_integer(date) ? Number(date) : undefined;
+  };
+  var toNumber = function(value) {
+    return is_integer(value) ? Number(value) : undefined;
+  };
+
+  var toFiles = function(entries) {
+    var file_list = [];
+    for (var i = 0; i < entries.length; i++)
+      file_list.push(new File(entries[i].fullPath, this, entries[i]));
+    return file_list;
+  }.bind(this);
+
+  var jobId = postMessage({
+    cmd: 'FileFind',
+    fullPath: this.fullPath,
+    name: is_string(options.name) ? options.name : undefined,
+    regex: is_string(regex) ? regex : undefined,
+    ignoreCase: ignoreCase,
+    type: is_string(options.type) ? options.type : undefined,
+    minSize: toNumber(options.minSize),
+    maxSize: toNumber(options.maxSize),
+    modifiedAfter: toTime(options.modifiedAfter),
+    modifiedBefore: toTime(options.modifiedBefore),
+    maxDepth: toNumber(options.maxDepth),
+    limit: toNumber(options.limit),
+    chunkSize: onchunk ? (Number(options.chunkSize) || 500) : undefined
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+    } else if (onsuccess) {
+      onsuccess(toFiles(result.value), result.truncated);
     }
-  }.bind(this));
+  });
+  if (onchunk) {
+    _progress_callbacks[jobId] = function(chunk) {
+      onchunk(toFiles(chunk.value));
+    };
+  }
+  return new FileJob(jobId);
 };
 
-File.prototype.openStream = function(mode, onsuccess, onerror, encoding) {
+File.prototype.hash = function(algorithm, onsuccess, onerror, onprogress) {
+  // algorithm - 'crc32c' or 'sha256', the digest is passed as a hex string
+  // onprogress(processedBytes, totalBytes) - optional, throttled
+  if (algorithm !== 'crc32c' && algorithm !== 'sha256')
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (!(onsuccess instanceof Function))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (onerror !== null && !(onerror instanceof Function) &&
       arguments.length > 2)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onprogress !== null && !(onprogress instanceof Function) &&
+      arguments.length > 3)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (this.isDirectory)
+    throw new tizen.WebAPIException(tizen.WebAPIException.IO_ERR);
+
+  var jobId = postMessage({
+    cmd: 'FileHash',
+    fullPath: this.fullPath,
+    algorithm: algorithm
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+    } else {
+      onsuccess(result.value);
+    }
+  });
+  if (onprogress) {
+    _progress_callbacks[jobId] = function(progress) {
+      onprogress(progress.processed, progress.total);
+    };
+  }
+
+  return new FileJob(jobId);
+};
+
+// options.atomic - optional, for the 'w', 'a' and 'rw' modes: the writes go
+//   to a temporary copy of the file, which replaces it durably on close(),
+//   so the file holds either the old or the new content after a crash
+// options.commitInterval - optional, ms the replacement may be delayed by,
+//   for the commits of several streams to be synced together. Opening the
+//   file again commits it first.
+// options.sequential - optional, the file is read from start to end, so the
+//   system reads further ahead
+// options.noCache - optional, what the stream reads or writes is not kept in
+//   memory after it, for large media that would evict other files
+File.prototype.openStream = function(mode, onsuccess, onerror, encoding,
+    options) {
+  if (!(onsuccess instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      arguments.length > 2)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (options !== null && typeof(options) !== 'object' &&
+      arguments.length > 4)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
   mode = get_valid_mode(mode);
 
@@ -498,11 +933,21 @@ File.prototype.openStream = function(mode, onsuccess, onerror, encoding) {
       (encoding != 'UTF-8' && encoding != 'ISO-8859-1'))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
+  options = options || {};
+  if (options.commitInterval !== undefined &&
+      !is_integer(options.commitInterval))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
   postMessage({
     cmd: 'FileOpenStream',
     fullPath: this.fullPath,
     mode: mode,
-    encoding: encoding
+    encoding: encoding,
+    atomic: !!options.atomic,
+    sequential: !!options.sequential,
+    noCache: !!options.noCache,
+    commitInterval: options.commitInterval !== undefined ?
+        Number(options.commitInterval) : undefined
   }, function(result) {
     if (result.isError) {
       if (onerror)
@@ -542,14 +987,18 @@ File.prototype.readAsText = function(onsuccess, onerror, encoding) {
 };
 
 File.prototype.copyTo = function(originFilePath, destinationFilePath,
-    overwrite, onsuccess, onerror) {
+    overwrite, onsuccess, onerror, onprogress) {
   // originFilePath, destinationFilePath - full virtual file path
+  // onprogress(processedBytes, totalBytes) - optional, throttled
   if (onsuccess !== null && !(onsuccess instanceof Function) &&
       arguments.length > 3)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (onerror !== null && !(onerror instanceof Function) &&
       arguments.length > 4)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onprogress !== null && !(onprogress instanceof Function) &&
+      arguments.length > 5)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
   if (!is_string(originFilePath) || !is_string(destinationFilePath)) {
     onerror(new tizen.WebAPIException(tizen.WebAPIException.NOT_FOUND_ERR));
@@ -566,7 +1015,7 @@ File.prototype.copyTo = function(originFilePath, destinationFilePath,
     return;
   }
 
-  postMessage({
+  var jobId = postMessage({
     cmd: 'FileCopyTo',
     originFilePath: originFilePath,
     destinationFilePath: destinationFilePath,
@@ -580,6 +1029,13 @@ File.prototype.copyTo = function(originFilePath, destinationFilePath,
       onsuccess();
     }
   });
+  if (onprogress) {
+    _progress_callbacks[jobId] = function(progress) {
+      onprogress(progress.processed, progress.total);
+    };
+  }
+
+  return new FileJob(jobId);
 };
 
 File.prototype.moveTo = function(originFilePath, destinationFilePath,
@@ -638,13 +1094,26 @@ File.prototype.createDirectory = function(relativeDirPath) {
     return new File(status.value, getFileParent(status.value));
 };
 
-File.prototype.createFile = function(relativeFilePath) {
+// options.size - optional, bytes the file is expected to grow to: the space
+//   is reserved up front, the file staying empty, so that writing it
+//   sequentially doesn't fragment it. What is not written stays reserved
+//   until the file is truncated.
+File.prototype.createFile = function(relativeFilePath, options) {
   if (relativeFilePath.indexOf('./') >= 0)
     throw new tizen.WebAPIException(tizen.WebAPIException.INVALID_VALUES_ERR);
+  if (options !== null && typeof(options) !== 'object' &&
+      arguments.length > 1)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  options = options || {};
+  if (options.size !== undefined &&
+      (!is_integer(options.size) || options.size < 0))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
   var status = sendSyncMessage('FileCreateFile', {
     fullPath: this.fullPath,
-    relativeFilePath: relativeFilePath
+    relativeFilePath: relativeFilePath,
+    size: options.size !== undefined ? Number(options.size) : undefined
   });
 
   if (status.isError)
@@ -665,21 +1134,26 @@ File.prototype.resolve = function(relativeFilePath) {
   return new File(status.value, getFileParent(status.value));
 };
 
-File.prototype.deleteDirectory = function(directoryPath, recursive, onsuccess, onerror) {
+File.prototype.deleteDirectory = function(directoryPath, recursive, onsuccess,
+    onerror, onprogress) {
   // directoryPath - full virtual directory path
+  // onprogress(removedEntries) - optional, throttled, for recursive deletes
   if (onsuccess !== null && !(onsuccess instanceof Function) &&
       arguments.length > 2)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (onerror !== null && !(onerror instanceof Function) &&
       arguments.length > 3)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onprogress !== null && !(onprogress instanceof Function) &&
+      arguments.length > 4)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
   if (directoryPath.indexOf(this.fullPath) < 0 && onerror) {
     onerror(new tizen.WebAPIError(tizen.WebAPIException.NOT_FOUND_ERR));
     return;
   }
 
-  postMessage({
+  var jobId = postMessage({
     cmd: 'FileDeleteDirectory',
     directoryPath: directoryPath,
     recursive: !!recursive
@@ -691,6 +1165,13 @@ File.prototype.deleteDirectory = function(directoryPath, recursive, onsuccess, o
       onsuccess();
     }
   });
+  if (onprogress) {
+    _progress_callbacks[jobId] = function(progress) {
+      onprogress(progress.processed);
+    };
+  }
+
+  return new FileJob(jobId);
 };
 
 File.prototype.deleteFile = function(filePath, onsuccess, onerror) {
@@ -0,0 +1,1184 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_archive_job.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#include "filesystem/filesystem_tree_walker.h"
+
+namespace {
+
+const size_t kBufferSize = 256 * 1024;
+
+const uint32_t kZipLocalHeader = 0x04034b50;
+const uint32_t kZipCentralHeader = 0x02014b50;
+const uint32_t kZipEnd = 0x06054b50;
+const uint32_t kZip64End = 0x06064b50;
+const uint32_t kZip64EndLocator = 0x07064b50;
+const uint16_t kZip64ExtraField = 0x0001;
+const size_t kZipLocalHeaderSize = 30;
+const size_t kZipCentralHeaderSize = 46;
+const size_t kZipEndSize = 22;
+const size_t kZipMaxComment = 0xffff;
+// The central directory is read at once. It takes about 100 bytes per
+// entry, so this is a lot of entries.
+const uint64_t kZipMaxDirectorySize = 64 * 1024 * 1024;
+const uint16_t kZipStored = 0;
+const uint16_t kZipDeflated = 8;
+const uint16_t kZipFlagEncrypted = 1 << 0;
+const uint16_t kZipFlagUTF8 = 1 << 11;
+// Made by and needed: 2.0, deflate and directories, by a Unix host.
+const uint16_t kZipVersion = 20;
+const uint16_t kZipHostUnix = 3;
+
+const size_t kTarBlockSize = 512;
+// For the names and attributes given by GNU and pax extension entries.
+const uint64_t kTarMaxExtensionSize = 1024 * 1024;
+
+uint16_t Get16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+uint32_t Get32(const uint8_t* p) {
+  return Get16(p) | (static_cast<uint32_t>(Get16(p + 2)) << 16);
+}
+
+uint64_t Get64(const uint8_t* p) {
+  return Get32(p) | (static_cast<uint64_t>(Get32(p + 4)) << 32);
+}
+
+void Put16(uint16_t value, std::string* out) {
+  out->push_back(value & 0xff);
+  out->push_back(value >> 8);
+}
+
+void Put32(uint32_t value, std::string* out) {
+  Put16(value & 0xffff, out);
+  Put16(value >> 16, out);
+}
+
+bool ReadAt(int fd, void* buffer, size_t count, uint64_t offset) {
+  char* p = static_cast<char*>(buffer);
+  while (count > 0) {
+    ssize_t read_bytes = pread(fd, p, count, offset);
+    if (read_bytes < 0 && errno == EINTR)
+      continue;
+    if (read_bytes <= 0)
+      return false;
+    p += read_bytes;
+    offset += read_bytes;
+    count -= read_bytes;
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const void* buffer, size_t count) {
+  const char* p = static_cast<const char*>(buffer);
+  while (count > 0) {
+    ssize_t written_bytes = write(fd, p, count);
+    if (written_bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += written_bytes;
+    count -= written_bytes;
+  }
+  return true;
+}
+
+// Reads exactly |count| bytes, false at the end of the stream or on error.
+bool ReadGz(gzFile gz, void* buffer, size_t count) {
+  char* p = static_cast<char*>(buffer);
+  while (count > 0) {
+    int read_bytes = gzread(gz, p, std::min<size_t>(count, kBufferSize));
+    if (read_bytes <= 0)
+      return false;
+    p += read_bytes;
+    count -= read_bytes;
+  }
+  return true;
+}
+
+bool SkipGz(gzFile gz, uint64_t count) {
+  std::vector<char> buffer(std::min<uint64_t>(count, kBufferSize));
+  while (count > 0) {
+    size_t chunk = std::min<uint64_t>(count, buffer.size());
+    if (!ReadGz(gz, &buffer[0], chunk))
+      return false;
+    count -= chunk;
+  }
+  return true;
+}
+
+// The components of an entry name, false if it is absolute, goes up with
+// "..", or names nothing.
+bool SplitEntryName(const std::string& name,
+                    std::vector<std::string>* components) {
+  if (name.empty() || name[0] == '/' || name.find('\0') != std::string::npos)
+    return false;
+
+  size_t start = 0;
+  while (start < name.size()) {
+    size_t end = name.find('/', start);
+    if (end == std::string::npos)
+      end = name.size();
+    std::string component = name.substr(start, end - start);
+    if (component == "..")
+      return false;
+    if (!component.empty() && component != ".")
+      components->push_back(component);
+    start = end + 1;
+  }
+  return !components->empty();
+}
+
+time_t FromDosTime(uint16_t time, uint16_t date) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_sec = (time & 0x1f) * 2;
+  tm.tm_min = (time >> 5) & 0x3f;
+  tm.tm_hour = time >> 11;
+  tm.tm_mday = date & 0x1f;
+  tm.tm_mon = ((date >> 5) & 0xf) - 1;
+  tm.tm_year = (date >> 9) + 80;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+void ToDosTime(time_t mtime, uint16_t* time, uint16_t* date) {
+  struct tm tm;
+  localtime_r(&mtime, &tm);
+  if (tm.tm_year < 80) {
+    *time = 0;
+    *date = (1 << 5) | 1;
+    return;
+  }
+  *time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+  *date = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+}
+
+// Octal, or base-256 when the first byte has its high bit set.
+uint64_t ParseTarNumber(const char* field, size_t length) {
+  uint64_t value = 0;
+  if (static_cast<uint8_t>(field[0]) & 0x80) {
+    value = field[0] & 0x7f;
+    for (size_t i = 1; i < length; ++i)
+      value = (value << 8) | static_cast<uint8_t>(field[i]);
+    return value;
+  }
+
+  size_t i = 0;
+  while (i < length && field[i] == ' ')
+    ++i;
+  for (; i < length && field[i] >= '0' && field[i] <= '7'; ++i)
+    value = value * 8 + (field[i] - '0');
+  return value;
+}
+
+void FormatTarNumber(uint64_t value, char* field, size_t length) {
+  // length - 1 octal digits and a NUL, or base-256 past them.
+  if (value >> (3 * (length - 1))) {
+    memset(field, 0, length);
+    field[0] = static_cast<char>(0x80);
+    for (size_t i = length - 1; i > 0 && value; --i, value >>= 8)
+      field[i] = value & 0xff;
+    return;
+  }
+  snprintf(field, length, "%0*llo", static_cast<int>(length - 1),
+           static_cast<unsigned long long>(value));  // NOLINT
+}
+
+bool IsTarHeaderValid(const char* header) {
+  uint64_t expected = ParseTarNumber(header + 148, 8);
+  uint64_t sum = 0;
+  for (size_t i = 0; i < kTarBlockSize; ++i) {
+    bool in_checksum = i >= 148 && i < 156;
+    sum += in_checksum ? ' ' : static_cast<uint8_t>(header[i]);
+  }
+  return sum == expected;
+}
+
+std::string TarString(const char* field, size_t length) {
+  return std::string(field, strnlen(field, length));
+}
+
+// Applies the "path" and "size" records of a pax extended header.
+void ParsePaxRecords(const std::string& records, std::string* path,
+                     uint64_t* size) {
+  size_t start = 0;
+  while (start < records.size()) {
+    size_t length = strtoul(records.c_str() + start, NULL, 10);
+    size_t space = records.find(' ', start);
+    if (!length || space == std::string::npos ||
+        start + length > records.size())
+      return;
+
+    // "<length> <key>=<value>\n"
+    std::string record = records.substr(space + 1,
+                                        start + length - space - 2);
+    size_t equals = record.find('=');
+    if (equals != std::string::npos) {
+      std::string key = record.substr(0, equals);
+      if (key == "path")
+        *path = record.substr(equals + 1);
+      else if (key == "size")
+        *size = strtoull(record.c_str() + equals + 1, NULL, 10);
+    }
+    start += length;
+  }
+}
+
+// Buffers the writes to a new file, and patches what was already written.
+class ArchiveWriter {
+ public:
+  explicit ArchiveWriter(int fd) : fd_(fd), offset_(0) {}
+
+  uint64_t offset() const { return offset_; }
+
+  bool Write(const void* data, size_t length) {
+    const char* p = static_cast<const char*>(data);
+    offset_ += length;
+    if (buffer_.size() + length > kBufferSize && !Flush())
+      return false;
+    if (length >= kBufferSize)
+      return WriteAll(fd_, p, length);
+    buffer_.append(p, length);
+    return true;
+  }
+
+  bool Write(const std::string& data) {
+    return Write(data.data(), data.size());
+  }
+
+  bool Flush() {
+    bool written = WriteAll(fd_, buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return written;
+  }
+
+  bool PatchAt(uint64_t offset, const std::string& data) {
+    if (!Flush())
+      return false;
+    size_t done = 0;
+    while (done < data.size()) {
+      ssize_t written_bytes = pwrite(fd_, data.data() + done,
+                                     data.size() - done, offset + done);
+      if (written_bytes < 0 && errno == EINTR)
+        continue;
+      if (written_bytes < 0)
+        return false;
+      done += written_bytes;
+    }
+    return true;
+  }
+
+ private:
+  int fd_;
+  uint64_t offset_;
+  std::string buffer_;
+};
+
+}  // namespace
+
+struct ExtractArchiveJob::ZipEntry {
+  std::string name;
+  uint16_t method;
+  uint16_t flags;
+  uint16_t time;
+  uint16_t date;
+  uint32_t crc;
+  uint64_t compressed_size;
+  uint64_t size;
+  uint64_t offset;
+  mode_t mode;
+};
+
+ExtractArchiveJob::ExtractArchiveJob(const picojson::value& msg,
+                                     const std::string& archive,
+                                     const std::string& destination,
+                                     bool overwrite)
+    : FilesystemJob(msg),
+      archive_(archive),
+      destination_(destination),
+      overwrite_(overwrite),
+      destination_fd_(-1) {}
+
+void ExtractArchiveJob::Execute() {
+  int fd = open(archive_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    Fail(errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+    return;
+  }
+
+  destination_fd_ = open(destination_.c_str(),
+                         O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (destination_fd_ < 0) {
+    close(fd);
+    Fail(errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+    return;
+  }
+
+  uint8_t magic[4] = { 0 };
+  ReadAt(fd, magic, sizeof(magic), 0);
+  uint32_t signature = Get32(magic);
+  if (signature == kZipLocalHeader || signature == kZipEnd)
+    ExtractZip(fd);
+  else
+    ExtractTar(fd);
+
+  close(destination_fd_);
+  close(fd);
+}
+
+bool ExtractArchiveJob::ExtractZip(int fd) {
+  std::vector<ZipEntry> entries;
+  if (!ReadZipDirectory(fd, &entries))
+    return false;
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < entries.size(); ++i)
+    total += entries[i].size;
+  SetTotal(total);
+
+  for (size_t i = 0; i < entries.size() && !IsCancelled(); ++i) {
+    const ZipEntry& entry = entries[i];
+    if (S_ISDIR(entry.mode) ||
+        (!entry.name.empty() && *entry.name.rbegin() == '/')) {
+      if (!MakeDirectory(entry.name, entry.mode))
+        return false;
+      continue;
+    }
+    if (S_ISLNK(entry.mode))
+      continue;
+    if (!ExtractZipEntry(fd, entry))
+      return false;
+  }
+  return !IsCancelled();
+}
+
+bool ExtractArchiveJob::ReadZipDirectory(int fd,
+                                         std::vector<ZipEntry>* entries) {
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(kZipEndSize)) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  // The end record is followed by a comment of up to 64 KB.
+  uint64_t size = st.st_size;
+  size_t tail_size = std::min<uint64_t>(size, kZipEndSize + kZipMaxComment);
+  std::vector<uint8_t> tail(tail_size);
+  if (!ReadAt(fd, &tail[0], tail_size, size - tail_size)) {
+    Fail(IO_ERR);
+    return false;
+  }
+  ssize_t end = tail_size - kZipEndSize;
+  while (end >= 0 && Get32(&tail[end]) != kZipEnd)
+    --end;
+  if (end < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  uint64_t count = Get16(&tail[end + 10]);
+  uint64_t directory_size = Get32(&tail[end + 12]);
+  uint64_t directory_offset = Get32(&tail[end + 16]);
+
+  uint64_t end_offset = size - tail_size + end;
+  uint8_t locator[20];
+  if (end_offset >= sizeof(locator) &&
+      ReadAt(fd, locator, sizeof(locator), end_offset - sizeof(locator)) &&
+      Get32(locator) == kZip64EndLocator) {
+    uint8_t end64[56];
+    if (!ReadAt(fd, end64, sizeof(end64), Get64(locator + 8)) ||
+        Get32(end64) != kZip64End) {
+      Fail(IO_ERR);
+      return false;
+    }
+    count = Get64(end64 + 32);
+    directory_size = Get64(end64 + 40);
+    directory_offset = Get64(end64 + 48);
+  }
+
+  if (directory_size > kZipMaxDirectorySize ||
+      directory_offset + directory_size > size) {
+    Fail(IO_ERR);
+    return false;
+  }
+  std::vector<uint8_t> directory(directory_size + 1);
+  if (!ReadAt(fd, &directory[0], directory_size, directory_offset)) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  const uint8_t* p = &directory[0];
+  const uint8_t* directory_end = p + directory_size;
+  for (uint64_t i = 0; i < count; ++i) {
+    if (directory_end - p < static_cast<ssize_t>(kZipCentralHeaderSize) ||
+        Get32(p) != kZipCentralHeader) {
+      Fail(IO_ERR);
+      return false;
+    }
+    size_t name_length = Get16(p + 28);
+    size_t extra_length = Get16(p + 30);
+    size_t comment_length = Get16(p + 32);
+    const uint8_t* name = p + kZipCentralHeaderSize;
+    const uint8_t* extra = name + name_length;
+    const uint8_t* next = extra + extra_length + comment_length;
+    if (next > directory_end) {
+      Fail(IO_ERR);
+      return false;
+    }
+
+    ZipEntry entry;
+    entry.name.assign(reinterpret_cast<const char*>(name), name_length);
+    entry.flags = Get16(p + 8);
+    entry.method = Get16(p + 10);
+    entry.time = Get16(p + 12);
+    entry.date = Get16(p + 14);
+    entry.crc = Get32(p + 16);
+    entry.compressed_size = Get32(p + 20);
+    entry.size = Get32(p + 24);
+    entry.offset = Get32(p + 42);
+    entry.mode = 0;
+    if ((Get16(p + 4) >> 8) == kZipHostUnix)
+      entry.mode = Get32(p + 38) >> 16;
+
+    // The Zip64 field holds the 64-bit values of the saturated fields only,
+    // in that order.
+    for (const uint8_t* field = extra; field + 4 <= extra + extra_length;) {
+      uint16_t id = Get16(field);
+      uint16_t length = Get16(field + 2);
+      const uint8_t* value = field + 4;
+      const uint8_t* value_end = std::min(value + length,
+                                          extra + extra_length);
+      if (id == kZip64ExtraField) {
+        uint64_t* fields[] = {
+          &entry.size, &entry.compressed_size, &entry.offset,
+        };
+        for (size_t f = 0; f < 3; ++f) {
+          if (*fields[f] != 0xffffffff || value + 8 > value_end)
+            continue;
+          *fields[f] = Get64(value);
+          value += 8;
+        }
+      }
+      field += 4 + length;
+    }
+
+    entries->push_back(entry);
+    p = next;
+  }
+  return true;
+}
+
+bool ExtractArchiveJob::ExtractZipEntry(int fd, const ZipEntry& entry) {
+  if ((entry.flags & kZipFlagEncrypted) ||
+      (entry.method != kZipStored && entry.method != kZipDeflated)) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  uint8_t header[kZipLocalHeaderSize];
+  if (!ReadAt(fd, header, sizeof(header), entry.offset) ||
+      Get32(header) != kZipLocalHeader) {
+    Fail(IO_ERR);
+    return false;
+  }
+  uint64_t offset = entry.offset + kZipLocalHeaderSize + Get16(header + 26) +
+                    Get16(header + 28);
+
+  mode_t mode = entry.mode & 0777 ? entry.mode & 0777 : 0644;
+  int out = CreateFile(entry.name, mode);
+  if (out < 0)
+    return false;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  bool deflated = entry.method == kZipDeflated;
+  if (deflated && inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+    close(out);
+    RemoveFile(entry.name);
+    Fail(IO_ERR);
+    return false;
+  }
+
+  std::vector<uint8_t> input(kBufferSize);
+  std::vector<uint8_t> output(deflated ? kBufferSize : 0);
+  uint64_t remaining = entry.compressed_size;
+  uint64_t written = 0;
+  uLong crc = crc32(0, Z_NULL, 0);
+  bool ok = true;
+  bool done = false;
+
+  while (ok && !done && !IsCancelled()) {
+    if (stream.avail_in == 0 && remaining > 0) {
+      size_t chunk = std::min<uint64_t>(remaining, input.size());
+      if (!ReadAt(fd, &input[0], chunk, offset)) {
+        ok = false;
+        break;
+      }
+      offset += chunk;
+      remaining -= chunk;
+      stream.next_in = &input[0];
+      stream.avail_in = chunk;
+    }
+
+    const uint8_t* data;
+    size_t length;
+    if (deflated) {
+      stream.next_out = &output[0];
+      stream.avail_out = output.size();
+      int result = inflate(&stream, Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+        done = true;
+      } else if (result != Z_OK) {
+        ok = false;
+        break;
+      }
+      data = &output[0];
+      length = output.size() - stream.avail_out;
+      // Out of input before the end of the stream.
+      if (!done && !length && !stream.avail_in && !remaining) {
+        ok = false;
+        break;
+      }
+    } else {
+      data = stream.next_in;
+      length = stream.avail_in;
+      stream.avail_in = 0;
+      done = remaining == 0;
+    }
+
+    // An entry larger than its header says is not written out at all.
+    if (length > entry.size - written) {
+      ok = false;
+      break;
+    }
+
+    crc = crc32(crc, data, length);
+    written += length;
+    if (!WriteAll(out, data, length))
+      ok = false;
+    AddProgress(length);
+  }
+
+  if (deflated)
+    inflateEnd(&stream);
+  ok = ok && !IsCancelled() && written == entry.size && crc == entry.crc;
+  FinishFile(out, FromDosTime(entry.time, entry.date));
+  if (!ok) {
+    RemoveFile(entry.name);
+    Fail(IO_ERR);
+    return false;
+  }
+  return true;
+}
+
+bool ExtractArchiveJob::ExtractTar(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+    SetTotal(st.st_size);
+
+  // Reads gzipped and plain tar alike.
+  int gz_fd = dup(fd);
+  gzFile gz = gz_fd < 0 ? NULL : gzdopen(gz_fd, "rb");
+  if (!gz) {
+    if (gz_fd >= 0)
+      close(gz_fd);
+    Fail(IO_ERR);
+    return false;
+  }
+  gzbuffer(gz, kBufferSize);
+
+  std::vector<char> buffer(kBufferSize);
+  char header[kTarBlockSize];
+  std::string long_name;
+  std::string pax_path;
+  uint64_t pax_size = static_cast<uint64_t>(-1);
+  int64_t reported = 0;
+  bool ok = true;
+
+  while (ok && !IsCancelled()) {
+    // Archives that end without the zero blocks are accepted.
+    if (!ReadGz(gz, header, sizeof(header)))
+      break;
+    if (header[0] == '\0' &&
+        std::count(header, header + sizeof(header), '\0') ==
+            static_cast<int>(sizeof(header)))
+      break;
+    if (!IsTarHeaderValid(header)) {
+      ok = false;
+      break;
+    }
+
+    char type = header[156];
+    uint64_t size = ParseTarNumber(header + 124, 12);
+    if (pax_size != static_cast<uint64_t>(-1) && type != 'x' && type != 'L')
+      size = pax_size;
+    uint64_t padding = (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize;
+
+    if (type == 'L' || type == 'x') {
+      if (size > kTarMaxExtensionSize) {
+        ok = false;
+        break;
+      }
+      std::string data(size, '\0');
+      if (size && !ReadGz(gz, &data[0], size)) {
+        ok = false;
+        break;
+      }
+      if (type == 'L')
+        long_name = TarString(data.data(), data.size());
+      else
+        ParsePaxRecords(data, &pax_path, &pax_size);
+      ok = SkipGz(gz, padding);
+      continue;
+    }
+
+    std::string name;
+    if (!pax_path.empty()) {
+      name = pax_path;
+    } else if (!long_name.empty()) {
+      name = long_name;
+    } else {
+      name = TarString(header, 100);
+      std::string prefix = TarString(header + 345, 155);
+      if (memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty())
+        name = prefix + "/" + name;
+    }
+    long_name.clear();
+    pax_path.clear();
+    pax_size = static_cast<uint64_t>(-1);
+
+    mode_t mode = ParseTarNumber(header + 100, 8) & 0777;
+    time_t mtime = ParseTarNumber(header + 136, 12);
+
+    if (type == '5') {
+      ok = MakeDirectory(name, mode) && SkipGz(gz, size + padding);
+    } else if (type == '0' || type == '\0' || type == '7') {
+      int out = CreateFile(name, mode);
+      if (out < 0) {
+        gzclose(gz);
+        return false;
+      }
+      uint64_t left = size;
+      while (ok && left > 0 && !IsCancelled()) {
+        size_t chunk = std::min<uint64_t>(left, buffer.size());
+        ok = ReadGz(gz, &buffer[0], chunk) &&
+             WriteAll(out, &buffer[0], chunk);
+        left -= chunk;
+      }
+      FinishFile(out, mtime);
+      // Failed or cancelled part way.
+      if (!ok || left > 0)
+        RemoveFile(name);
+      else
+        ok = SkipGz(gz, padding);
+    } else {
+      // Links, devices, FIFOs and unknown entries.
+      ok = SkipGz(gz, size + padding);
+    }
+
+    int64_t offset = gzoffset(gz);
+    if (offset > reported) {
+      AddProgress(offset - reported);
+      reported = offset;
+    }
+  }
+
+  gzclose(gz);
+  if (!ok) {
+    Fail(IO_ERR);
+    return false;
+  }
+  return !IsCancelled();
+}
+
+int ExtractArchiveJob::OpenDirectory(
+    const std::vector<std::string>& components, size_t count) {
+  int fd = dup(destination_fd_);
+  for (size_t i = 0; i < count && fd >= 0; ++i) {
+    const char* name = components[i].c_str();
+    if (mkdirat(fd, name, 0755) < 0 && errno != EEXIST) {
+      close(fd);
+      return -1;
+    }
+    int next = openat(fd, name,
+                      O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    close(fd);
+    fd = next;
+  }
+  return fd;
+}
+
+bool ExtractArchiveJob::MakeDirectory(const std::string& name, mode_t mode) {
+  std::vector<std::string> components;
+  if (!SplitEntryName(name, &components)) {
+    Fail(INVALID_VALUES_ERR);
+    return false;
+  }
+
+  int fd = OpenDirectory(components, components.size());
+  if (fd < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+  // Still writable by the owner, for the entries to come.
+  if (mode & 0777)
+    fchmod(fd, (mode & 0777) | S_IRWXU);
+  close(fd);
+  return true;
+}
+
+int ExtractArchiveJob::CreateFile(const std::string& name, mode_t mode) {
+  std::vector<std::string> components;
+  if (!SplitEntryName(name, &components)) {
+    Fail(INVALID_VALUES_ERR);
+    return -1;
+  }
+
+  int dir_fd = OpenDirectory(components, components.size() - 1);
+  if (dir_fd < 0) {
+    Fail(IO_ERR);
+    return -1;
+  }
+  int fd = openat(dir_fd, components.back().c_str(),
+                  O_WRONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC |
+                  (overwrite_ ? O_TRUNC : O_EXCL), mode);
+  close(dir_fd);
+  if (fd < 0)
+    Fail(IO_ERR);
+  return fd;
+}
+
+void ExtractArchiveJob::FinishFile(int fd, time_t mtime) {
+  struct timespec times[2];
+  times[0].tv_sec = 0;
+  times[0].tv_nsec = UTIME_OMIT;
+  times[1].tv_sec = mtime;
+  times[1].tv_nsec = 0;
+  futimens(fd, times);
+  close(fd);
+}
+
+void ExtractArchiveJob::RemoveFile(const std::string& name) {
+  std::vector<std::string> components;
+  if (!SplitEntryName(name, &components))
+    return;
+
+  int dir_fd = OpenDirectory(components, components.size() - 1);
+  if (dir_fd < 0)
+    return;
+  unlinkat(dir_fd, components.back().c_str(), 0);
+  close(dir_fd);
+}
+
+CreateArchiveJob::CreateArchiveJob(const picojson::value& msg,
+                                   const std::vector<std::string>& sources,
+                                   const std::string& destination,
+                                   Format format, int level, bool overwrite)
+    : FilesystemJob(msg),
+      sources_(sources),
+      destination_(destination),
+      format_(format),
+      level_(level),
+      overwrite_(overwrite) {}
+
+// static
+bool CreateArchiveJob::GetFormat(const std::string& name,
+                                 const std::string& path, Format* format) {
+  std::string format_name = name;
+  if (format_name.empty()) {
+    size_t slash = path.find_last_of('/');
+    std::string file = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    for (size_t i = 0; i < file.size(); ++i)
+      file[i] = tolower(file[i]);
+
+    size_t dot = file.find('.');
+    format_name = dot == std::string::npos ? "" : file.substr(dot + 1);
+    if (format_name.size() >= 3 &&
+        format_name.compare(format_name.size() - 3, 3, "zip") == 0)
+      format_name = "zip";
+    else if (format_name == "tgz")
+      format_name = "tar.gz";
+  }
+
+  if (format_name == "zip")
+    *format = FORMAT_ZIP;
+  else if (format_name == "tar")
+    *format = FORMAT_TAR;
+  else if (format_name == "tar.gz")
+    *format = FORMAT_TAR_GZ;
+  else
+    return false;
+  return true;
+}
+
+void CreateArchiveJob::Execute() {
+  int fd = open(destination_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC |
+                (overwrite_ ? O_TRUNC : O_EXCL), 0666);
+  if (fd < 0) {
+    Fail(IO_ERR);
+    return;
+  }
+
+  // The archive is left out if it is created below one of the sources.
+  struct stat output;
+  bool ok = fstat(fd, &output) == 0;
+  for (size_t i = 0; ok && i < sources_.size(); ++i) {
+    std::string source = sources_[i];
+    while (source.size() > 1 && *source.rbegin() == '/')
+      source.erase(source.size() - 1);
+    size_t slash = source.find_last_of('/');
+    ok = Collect(source, source.substr(slash + 1), output);
+  }
+
+  if (ok) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (S_ISREG(entries_[i].st.st_mode))
+        total += entries_[i].st.st_size;
+    }
+    SetTotal(total);
+
+    if (format_ == FORMAT_ZIP)
+      ok = WriteZip(fd);
+    else
+      ok = WriteTar(fd);
+  }
+
+  if (close(fd) < 0 && ok) {
+    Fail(IO_ERR);
+    ok = false;
+  }
+  if (!ok || IsCancelled())
+    unlink(destination_.c_str());
+}
+
+bool CreateArchiveJob::Collect(const std::string& path,
+                               const std::string& name,
+                               const struct stat& output) {
+  Entry entry;
+  entry.path = path;
+  entry.name = name;
+  if (lstat(path.c_str(), &entry.st) < 0) {
+    Fail(errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+    return false;
+  }
+  if (entry.st.st_dev == output.st_dev && entry.st.st_ino == output.st_ino)
+    return true;
+  // Only files and directories are archived.
+  if (!S_ISREG(entry.st.st_mode) && !S_ISDIR(entry.st.st_mode))
+    return true;
+
+  entries_.push_back(entry);
+  if (!S_ISDIR(entry.st.st_mode))
+    return true;
+
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+  // Sorted, for the same tree to give the same archive.
+  std::vector<std::string> names;
+  DirectoryReader reader(fd);
+  const char* child;
+  unsigned char type;
+  while (reader.Next(&child, &type))
+    names.push_back(child);
+  bool read = errno == 0;
+  close(fd);
+  if (!read) {
+    Fail(IO_ERR);
+    return false;
+  }
+  std::sort(names.begin(), names.end());
+
+  for (size_t i = 0; i < names.size() && !IsCancelled(); ++i) {
+    if (!Collect(path + "/" + names[i], name + "/" + names[i], output))
+      return false;
+  }
+  return !IsCancelled();
+}
+
+bool CreateArchiveJob::WriteZip(int fd) {
+  ArchiveWriter writer(fd);
+  std::string directory;
+  std::vector<char> input(kBufferSize);
+  std::vector<uint8_t> output(kBufferSize);
+
+  for (size_t i = 0; i < entries_.size() && !IsCancelled(); ++i) {
+    const Entry& entry = entries_[i];
+    bool is_directory = S_ISDIR(entry.st.st_mode);
+    std::string name = is_directory ? entry.name + "/" : entry.name;
+    uint16_t method = is_directory || level_ == 0 ? kZipStored : kZipDeflated;
+    uint16_t time, date;
+    ToDosTime(entry.st.st_mtime, &time, &date);
+    uint64_t header_offset = writer.offset();
+    if (header_offset >= 0xffffffff || name.size() > 0xffff) {
+      Fail(IO_ERR);
+      return false;
+    }
+
+    // The CRC and sizes are patched in once the data is written.
+    std::string header;
+    Put32(kZipLocalHeader, &header);
+    Put16(kZipVersion, &header);
+    Put16(kZipFlagUTF8, &header);
+    Put16(method, &header);
+    Put16(time, &header);
+    Put16(date, &header);
+    Put32(0, &header);
+    Put32(0, &header);
+    Put32(0, &header);
+    Put16(name.size(), &header);
+    Put16(0, &header);
+    header.append(name);
+    if (!writer.Write(header)) {
+      Fail(IO_ERR);
+      return false;
+    }
+
+    uLong crc = crc32(0, Z_NULL, 0);
+    uint64_t size = 0;
+    uint64_t data_start = writer.offset();
+    if (!is_directory) {
+      int in = open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (in < 0) {
+        Fail(errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+        return false;
+      }
+      posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+      z_stream stream;
+      memset(&stream, 0, sizeof(stream));
+      bool ok = method == kZipStored ||
+                deflateInit2(&stream, level_, Z_DEFLATED, -MAX_WBITS, 8,
+                             Z_DEFAULT_STRATEGY) == Z_OK;
+      bool end = false;
+      while (ok && !end && !IsCancelled()) {
+        ssize_t read_bytes = read(in, &input[0], input.size());
+        if (read_bytes < 0 && errno == EINTR)
+          continue;
+        if (read_bytes < 0) {
+          ok = false;
+          break;
+        }
+        end = read_bytes == 0;
+        crc = crc32(crc, reinterpret_cast<Bytef*>(&input[0]), read_bytes);
+        size += read_bytes;
+        AddProgress(read_bytes);
+
+        if (method == kZipStored) {
+          ok = writer.Write(&input[0], read_bytes);
+          continue;
+        }
+        stream.next_in = reinterpret_cast<Bytef*>(&input[0]);
+        stream.avail_in = read_bytes;
+        do {
+          stream.next_out = &output[0];
+          stream.avail_out = output.size();
+          deflate(&stream, end ? Z_FINISH : Z_NO_FLUSH);
+          ok = writer.Write(&output[0], output.size() - stream.avail_out);
+        } while (ok && stream.avail_out == 0);
+      }
+      if (method == kZipDeflated)
+        deflateEnd(&stream);
+      close(in);
+      if (!ok) {
+        Fail(IO_ERR);
+        return false;
+      }
+      if (IsCancelled())
+        return false;
+    }
+
+    uint64_t compressed_size = writer.offset() - data_start;
+    if (size >= 0xffffffff || compressed_size >= 0xffffffff) {
+      Fail(IO_ERR);
+      return false;
+    }
+    std::string sizes;
+    Put32(crc, &sizes);
+    Put32(compressed_size, &sizes);
+    Put32(size, &sizes);
+    if (!is_directory && !writer.PatchAt(header_offset + 14, sizes)) {
+      Fail(IO_ERR);
+      return false;
+    }
+
+    uint32_t attributes = (entry.st.st_mode & 0xffff) << 16;
+    if (is_directory)
+      attributes |= 0x10;
+    Put32(kZipCentralHeader, &directory);
+    Put16((kZipHostUnix << 8) | kZipVersion, &directory);
+    Put16(kZipVersion, &directory);
+    Put16(kZipFlagUTF8, &directory);
+    Put16(method, &directory);
+    Put16(time, &directory);
+    Put16(date, &directory);
+    directory.append(sizes);
+    Put16(name.size(), &directory);
+    Put16(0, &directory);
+    Put16(0, &directory);
+    Put16(0, &directory);
+    Put16(0, &directory);
+    Put32(attributes, &directory);
+    Put32(header_offset, &directory);
+    directory.append(name);
+  }
+  if (IsCancelled())
+    return false;
+
+  uint64_t directory_offset = writer.offset();
+  if (entries_.size() > 0xffff || directory_offset >= 0xffffffff ||
+      directory.size() >= 0xffffffff) {
+    Fail(IO_ERR);
+    return false;
+  }
+  std::string end;
+  Put32(kZipEnd, &end);
+  Put16(0, &end);
+  Put16(0, &end);
+  Put16(entries_.size(), &end);
+  Put16(entries_.size(), &end);
+  Put32(directory.size(), &end);
+  Put32(directory_offset, &end);
+  Put16(0, &end);
+  if (!writer.Write(directory) || !writer.Write(end) || !writer.Flush()) {
+    Fail(IO_ERR);
+    return false;
+  }
+  return true;
+}
+
+bool CreateArchiveJob::WriteTar(int fd) {
+  // Compressed or written as is, through the same interface.
+  char mode[8] = "wbT";
+  if (format_ == FORMAT_TAR_GZ && level_ == kDefaultLevel)
+    snprintf(mode, sizeof(mode), "wb");
+  else if (format_ == FORMAT_TAR_GZ)
+    snprintf(mode, sizeof(mode), "wb%d", level_);
+  int gz_fd = dup(fd);
+  gzFile gz = gz_fd < 0 ? NULL : gzdopen(gz_fd, mode);
+  if (!gz) {
+    if (gz_fd >= 0)
+      close(gz_fd);
+    Fail(IO_ERR);
+    return false;
+  }
+  gzbuffer(gz, kBufferSize);
+
+  std::vector<char> buffer(kBufferSize);
+  const char kZeros[kTarBlockSize] = { 0 };
+  bool ok = true;
+
+  for (size_t i = 0; ok && i < entries_.size() && !IsCancelled(); ++i) {
+    const Entry& entry = entries_[i];
+    bool is_directory = S_ISDIR(entry.st.st_mode);
+    std::string name = is_directory ? entry.name + "/" : entry.name;
+    uint64_t size = is_directory ? 0 : entry.st.st_size;
+
+    // Up to 100 bytes in the name field, 255 split with the prefix field,
+    // and a preceding GNU long name entry past that.
+    std::string prefix;
+    if (name.size() > 100) {
+      size_t slash = name.find('/', name.size() - 101);
+      if (slash != std::string::npos && slash <= 155 && slash > 0) {
+        prefix = name.substr(0, slash);
+        name = name.substr(slash + 1);
+      }
+    }
+    if (name.size() > 100) {
+      char long_header[kTarBlockSize] = { 0 };
+      strcpy(long_header, "././@LongLink");  // NOLINT
+      FormatTarNumber(0644, long_header + 100, 8);
+      FormatTarNumber(0, long_header + 108, 8);
+      FormatTarNumber(0, long_header + 116, 8);
+      FormatTarNumber(name.size() + 1, long_header + 124, 12);
+      FormatTarNumber(0, long_header + 136, 12);
+      long_header[156] = 'L';
+      memcpy(long_header + 257, "ustar\0" "00", 8);
+      memset(long_header + 148, ' ', 8);
+      unsigned checksum = 0;
+      for (size_t b = 0; b < kTarBlockSize; ++b)
+        checksum += static_cast<uint8_t>(long_header[b]);
+      snprintf(long_header + 148, 8, "%06o", checksum);
+
+      size_t padded = (name.size() + 1 + kTarBlockSize - 1) /
+                      kTarBlockSize * kTarBlockSize;
+      std::string data(name);
+      data.resize(padded, '\0');
+      ok = gzwrite(gz, long_header, kTarBlockSize) > 0 &&
+           gzwrite(gz, data.data(), data.size()) > 0;
+      name.resize(100);
+    }
+
+    char header[kTarBlockSize] = { 0 };
+    memcpy(header, name.data(), name.size());
+    FormatTarNumber(entry.st.st_mode & 07777, header + 100, 8);
+    FormatTarNumber(entry.st.st_uid, header + 108, 8);
+    FormatTarNumber(entry.st.st_gid, header + 116, 8);
+    FormatTarNumber(size, header + 124, 12);
+    FormatTarNumber(entry.st.st_mtime, header + 136, 12);
+    header[156] = is_directory ? '5' : '0';
+    memcpy(header + 257, "ustar\0" "00", 8);
+    memcpy(header + 345, prefix.data(), prefix.size());
+    memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (size_t b = 0; b < kTarBlockSize; ++b)
+      checksum += static_cast<uint8_t>(header[b]);
+    snprintf(header + 148, 8, "%06o", checksum);
+    ok = ok && gzwrite(gz, header, kTarBlockSize) > 0;
+    if (!ok || is_directory)
+      continue;
+
+    int in = open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+      ok = false;
+      break;
+    }
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    // Exactly the size in the header, even if the file changed meanwhile.
+    for (uint64_t left = size; ok && left > 0 && !IsCancelled();) {
+      ssize_t read_bytes = read(in, &buffer[0],
+                                std::min<uint64_t>(left, buffer.size()));
+      if (read_bytes < 0 && errno == EINTR)
+        continue;
+      if (read_bytes <= 0) {
+        ok = false;
+        break;
+      }
+      ok = gzwrite(gz, &buffer[0], read_bytes) > 0;
+      left -= read_bytes;
+      AddProgress(read_bytes);
+    }
+    close(in);
+
+    size_t padding = (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize;
+    if (ok && padding)
+      ok = gzwrite(gz, kZeros, padding) > 0;
+  }
+
+  ok = ok && !IsCancelled() && gzwrite(gz, kZeros, kTarBlockSize) > 0 &&
+       gzwrite(gz, kZeros, kTarBlockSize) > 0;
+  ok = gzclose(gz) == Z_OK && ok;
+  if (!ok && !IsCancelled()) {
+    Fail(IO_ERR);
+    return false;
+  }
+  return ok;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_ARCHIVE_JOB_H_
+#define FILESYSTEM_FILESYSTEM_ARCHIVE_JOB_H_
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "filesystem/filesystem_job.h"
+
+// Extracts a zip (stored or deflated entries, Zip64 included), tar or
+// gzipped tar archive below a directory, streaming each entry through
+// fixed-size buffers. Entry names that are absolute or go up with ".." fail
+// the job, and the destination is walked without following symlinks, so
+// nothing can be written outside of it. Symlinks, hard links and devices in
+// the archive are skipped. Progress is in uncompressed bytes for zip, and in
+// archive bytes for tar.
+class ExtractArchiveJob : public FilesystemJob {
+ public:
+  ExtractArchiveJob(const picojson::value& msg, const std::string& archive,
+                    const std::string& destination, bool overwrite);
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+ private:
+  struct ZipEntry;
+
+  bool ExtractZip(int fd);
+  bool ReadZipDirectory(int fd, std::vector<ZipEntry>* entries);
+  bool ExtractZipEntry(int fd, const ZipEntry& entry);
+  bool ExtractTar(int fd);
+
+  // Opens the directory |components| name below the destination, creating
+  // it and its parents as needed.
+  int OpenDirectory(const std::vector<std::string>& components, size_t count);
+  bool MakeDirectory(const std::string& name, mode_t mode);
+  // Returns the fd of the new file, or -1 once the job has failed.
+  int CreateFile(const std::string& name, mode_t mode);
+  void FinishFile(int fd, time_t mtime);
+  // Removes a file left incomplete, so no truncated entry is mistaken for
+  // an extracted one.
+  void RemoveFile(const std::string& name);
+
+  std::string archive_;
+  std::string destination_;
+  bool overwrite_;
+  int destination_fd_;
+};
+
+// Writes the given files and directories, recursively, to a new zip, tar
+// or gzipped tar archive, each entry named after its source and the path
+// below it. Zip entries are deflated at |level|, or stored at level 0, and
+// the archive written without Zip64, so it fails past 4 GB. Progress is in
+// source bytes.
+class CreateArchiveJob : public FilesystemJob {
+ public:
+  enum Format {
+    FORMAT_ZIP,
+    FORMAT_TAR,
+    FORMAT_TAR_GZ,
+  };
+
+  // The compression level zlib defaults to.
+  static const int kDefaultLevel = -1;
+
+  CreateArchiveJob(const picojson::value& msg,
+                   const std::vector<std::string>& sources,
+                   const std::string& destination, Format format, int level,
+                   bool overwrite);
+
+  // From a format name, "zip", "tar" or "tar.gz", or else from the
+  // extension of |path|.
+  static bool GetFormat(const std::string& name, const std::string& path,
+                        Format* format);
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+ private:
+  struct Entry {
+    std::string path;
+    std::string name;
+    struct stat st;
+  };
+
+  bool Collect(const std::string& path, const std::string& name,
+               const struct stat& output);
+  bool WriteZip(int fd);
+  bool WriteTar(int fd);
+
+  std::vector<std::string> sources_;
+  std::string destination_;
+  Format format_;
+  int level_;
+  bool overwrite_;
+
+  std::vector<Entry> entries_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_ARCHIVE_JOB_H_
@@ -0,0 +1,141 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_batch_job.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "filesystem/filesystem_copy_job.h"
+#include "filesystem/filesystem_delete_job.h"
+
+namespace {
+
+// For the child jobs, which share the id of the batch.
+picojson::value ChildMessage(double id) {
+  picojson::object msg;
+  msg["reply_id"] = picojson::value(id);
+  return picojson::value(msg);
+}
+
+WebApiAPIErrors ErrorFromErrno(int error) {
+  return error == ENOENT ? NOT_FOUND_ERR : IO_ERR;
+}
+
+}  // namespace
+
+class BatchJob::RunnerTask : public WorkerPool::Task {
+ public:
+  explicit RunnerTask(BatchJob* job) : job_(job) {}
+
+  virtual void Run() {
+    job_->RunOperations();
+  }
+
+ private:
+  BatchJob* job_;
+};
+
+BatchJob::BatchJob(const picojson::value& msg,
+                   const std::vector<BatchOperation>& operations,
+                   bool stop_on_error, int parallelism)
+    : FilesystemJob(msg),
+      operations_(operations),
+      errors_(operations.size(), ABORT_ERR),
+      stop_on_error_(stop_on_error),
+      parallelism_(parallelism),
+      next_(0),
+      stopped_(0) {}
+
+void BatchJob::Execute() {
+  SetTotal(operations_.size());
+
+  // The calling thread is one of the runners.
+  int runners = std::min<int>(std::max(parallelism_, 1), operations_.size());
+  WorkerPool::TaskGroup group;
+  for (int i = 1; i < runners; ++i)
+    pool()->Post(new RunnerTask(this), &group);
+  RunOperations();
+  pool()->Wait(&group);
+  if (IsCancelled())
+    return;
+
+  picojson::array results;
+  for (size_t i = 0; i < errors_.size(); ++i) {
+    picojson::object result;
+    result["isError"] = picojson::value(errors_[i] != NO_ERROR);
+    if (errors_[i] != NO_ERROR)
+      result["errorCode"] = picojson::value(static_cast<double>(errors_[i]));
+    results.push_back(picojson::value(result));
+  }
+  result()["value"] = picojson::value(results);
+}
+
+void BatchJob::RunOperations() {
+  while (!stopped_ && !IsCancelled()) {
+    int index = __sync_fetch_and_add(&next_, 1);
+    if (index >= static_cast<int>(operations_.size()))
+      return;
+
+    WebApiAPIErrors error = RunOperation(operations_[index]);
+    errors_[index] = error;
+    if (error != NO_ERROR && stop_on_error_)
+      __sync_lock_test_and_set(&stopped_, 1);
+    AddProgress(1);
+  }
+}
+
+WebApiAPIErrors BatchJob::RunOperation(const BatchOperation& operation) {
+  if (operation.error != NO_ERROR)
+    return operation.error;
+
+  switch (operation.type) {
+  case BatchOperation::COPY: {
+    CopyJob copy(ChildMessage(id()), operation.from, operation.to,
+                 operation.overwrite);
+    return RunChild(&copy);
+  }
+  case BatchOperation::MOVE:
+    return Move(operation);
+  case BatchOperation::DELETE:
+    return Delete(operation);
+  }
+  return INVALID_VALUES_ERR;
+}
+
+WebApiAPIErrors BatchJob::Move(const BatchOperation& operation) {
+  struct stat st;
+  if (lstat(operation.from.c_str(), &st) < 0)
+    return ErrorFromErrno(errno);
+  if (!operation.overwrite && lstat(operation.to.c_str(), &st) == 0)
+    return IO_ERR;
+
+  if (rename(operation.from.c_str(), operation.to.c_str()) < 0)
+    return ErrorFromErrno(errno);
+  return NO_ERROR;
+}
+
+WebApiAPIErrors BatchJob::Delete(const BatchOperation& operation) {
+  struct stat st;
+  if (lstat(operation.from.c_str(), &st) < 0)
+    return ErrorFromErrno(errno);
+
+  if (!S_ISDIR(st.st_mode)) {
+    if (unlink(operation.from.c_str()) < 0)
+      return ErrorFromErrno(errno);
+    return NO_ERROR;
+  }
+
+  if (operation.recursive) {
+    DeleteDirectoryJob remove(ChildMessage(id()), operation.from);
+    return RunChild(&remove);
+  }
+  if (rmdir(operation.from.c_str()) < 0)
+    return ErrorFromErrno(errno);
+  return NO_ERROR;
+}
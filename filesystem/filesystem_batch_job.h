@@ -0,0 +1,72 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_BATCH_JOB_H_
+#define FILESYSTEM_FILESYSTEM_BATCH_JOB_H_
+
+#include <string>
+#include <vector>
+
+#include "filesystem/filesystem_job.h"
+
+// One item of a batch, with real paths.
+struct BatchOperation {
+  enum Type {
+    COPY,
+    MOVE,
+    DELETE,
+  };
+
+  BatchOperation()
+      : type(DELETE),
+        overwrite(false),
+        recursive(false),
+        error(NO_ERROR) {}
+
+  Type type;
+  // The only path of a DELETE.
+  std::string from;
+  std::string to;
+  bool overwrite;
+  // For a DELETE of a directory.
+  bool recursive;
+  // Set when the operation is known to fail before it runs.
+  WebApiAPIErrors error;
+};
+
+// Runs a list of copies, moves and deletions, up to |parallelism| at a
+// time, and replies once for all of them with a result per operation, in
+// order: {isError} or {isError, errorCode}. Copies and recursive deletions
+// run as child CopyJob and DeleteDirectoryJob. With |stop_on_error|, the
+// operations not started when one fails are reported as ABORT_ERR.
+// Progress counts the finished operations.
+class BatchJob : public FilesystemJob {
+ public:
+  BatchJob(const picojson::value& msg,
+           const std::vector<BatchOperation>& operations, bool stop_on_error,
+           int parallelism);
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+ private:
+  class RunnerTask;
+
+  // Runs operations until there are none left or the batch stops.
+  void RunOperations();
+  WebApiAPIErrors RunOperation(const BatchOperation& operation);
+  WebApiAPIErrors Move(const BatchOperation& operation);
+  WebApiAPIErrors Delete(const BatchOperation& operation);
+
+  std::vector<BatchOperation> operations_;
+  // Indexed like |operations_|, each written by the thread that ran it.
+  std::vector<int> errors_;
+  bool stop_on_error_;
+  int parallelism_;
+  volatile int next_;
+  volatile int stopped_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_BATCH_JOB_H_
@@ -0,0 +1,478 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Drives the filesystem extension, loaded as Crosswalk would load it, with
+// its internal storages moved to a sandbox directory, on tmpfs when
+// /dev/shm is available. Measures listFiles() over a large directory,
+// stream reads and writes for each data type and encoding across chunk
+// sizes, copyTo() of a large file and the recursive deletion of a deep
+// tree. Results are printed as tab-separated lines, see
+// benchmark::Measurement, and the progress on stderr.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/extension_benchmark.h"
+#include "common/picojson.h"
+
+namespace {
+
+const size_t kChunkSizes[] = { 1024, 64 * 1024, 1024 * 1024 };
+
+struct StreamType {
+  const char* type;
+  const char* encoding;
+};
+
+// How FileStream.write()/read(), writeBytes()/readBytes() and
+// writeBase64()/readBase64() reach the extension.
+const StreamType kStreamTypes[] = {
+  { "Default", "UTF-8" },
+  { "Default", "ISO-8859-1" },
+  { "Base64", "UTF-8" },
+  { "Bytes", "UTF-8" },
+};
+
+struct Options {
+  Options()
+      : module("libtizen_filesystem.so"),
+        entries(10000),
+        stream_mb(16),
+        copy_mb(1024),
+        depth(256),
+        iterations(5) {}
+
+  std::string module;
+  std::string sandbox;
+  int entries;
+  int stream_mb;
+  int copy_mb;
+  int depth;
+  int iterations;
+};
+
+void PrintUsage(const char* program) {
+  std::cerr << "Usage: " << program << " [options]\n"
+      << "  --module PATH        filesystem extension module\n"
+      << "  --sandbox DIR        directory of the storages, which must not\n"
+      << "                       exist, created and removed, by default in\n"
+      << "                       /dev/shm or /tmp\n"
+      << "  --entries N          files in the listed directory\n"
+      << "  --stream-mb N        MB read and written per stream case\n"
+      << "  --copy-mb N          size of the copied file\n"
+      << "  --depth N            depth of the deleted tree\n"
+      << "  --iterations N       runs of the listing, copy and delete cases\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      return false;
+
+    if (arg == "--module")
+      options.module = argv[++i];
+    else if (arg == "--sandbox")
+      options.sandbox = argv[++i];
+    else if (arg == "--entries")
+      options.entries = atoi(argv[++i]);
+    else if (arg == "--stream-mb")
+      options.stream_mb = atoi(argv[++i]);
+    else if (arg == "--copy-mb")
+      options.copy_mb = atoi(argv[++i]);
+    else if (arg == "--depth")
+      options.depth = atoi(argv[++i]);
+    else if (arg == "--iterations")
+      options.iterations = atoi(argv[++i]);
+    else
+      return false;
+  }
+
+  return options.entries > 0 && options.stream_mb > 0 &&
+         options.copy_mb > 0 && options.depth > 0 && options.iterations > 0;
+}
+
+// Replies to asynchronous messages come from the worker threads of the
+// jobs. One message is in flight at a time.
+class ReplyWaiter {
+ public:
+  ReplyWaiter() : received_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+  }
+
+  ~ReplyWaiter() {
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  static void OnMessage(XW_Instance instance, const char* message,
+                        void* user_data) {
+    // Progress and chunk events have a "cmd", replies don't.
+    if (strstr(message, "\"cmd\""))
+      return;
+
+    ReplyWaiter* waiter = static_cast<ReplyWaiter*>(user_data);
+    pthread_mutex_lock(&waiter->mutex_);
+    waiter->reply_ = message;
+    waiter->received_ = true;
+    pthread_cond_signal(&waiter->cond_);
+    pthread_mutex_unlock(&waiter->mutex_);
+  }
+
+  std::string Wait() {
+    pthread_mutex_lock(&mutex_);
+    while (!received_)
+      pthread_cond_wait(&cond_, &mutex_);
+    received_ = false;
+    std::string reply;
+    reply.swap(reply_);
+    pthread_mutex_unlock(&mutex_);
+    return reply;
+  }
+
+ private:
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  bool received_;
+  std::string reply_;
+};
+
+ReplyWaiter g_waiter;
+XW_Instance g_instance;
+int g_reply_id = 0;
+
+std::string Call(picojson::object message) {
+  message["reply_id"] = picojson::value(static_cast<double>(g_reply_id++));
+  benchmark::ExtensionHost::GetInstance().PostMessage(
+      g_instance, picojson::value(message).serialize());
+  return g_waiter.Wait();
+}
+
+std::string SyncCall(const picojson::object& message) {
+  return benchmark::ExtensionHost::GetInstance().SendSyncMessage(
+      g_instance, picojson::value(message).serialize());
+}
+
+bool IsError(const std::string& reply) {
+  picojson::value value;
+  std::string error;
+  picojson::parse(value, reply.begin(), reply.end(), &error);
+  return !error.empty() || value.get("isError").evaluate_as_boolean();
+}
+
+std::string CaseName(const char* operation, size_t size) {
+  std::ostringstream name;
+  name << operation << "." << size;
+  return name.str();
+}
+
+bool MakeDirectory(const std::string& path) {
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool WriteFile(const std::string& path, const char* data, size_t size,
+               size_t times) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+  if (fd < 0)
+    return false;
+  bool written = true;
+  for (size_t i = 0; written && i < times; ++i) {
+    written = write(fd, data, size) == static_cast<ssize_t>(size);
+  }
+  return close(fd) == 0 && written;
+}
+
+int RemoveEntry(const char* path, const struct stat*, int, struct FTW*) {
+  return remove(path);
+}
+
+bool RemoveTree(const std::string& path) {
+  return nftw(path.c_str(), RemoveEntry, 64, FTW_DEPTH | FTW_PHYS) == 0 ||
+         errno == ENOENT;
+}
+
+void BenchmarkListFiles(const std::string& real_root, const Options& options) {
+  std::string directory = real_root + "/list";
+  if (!MakeDirectory(directory))
+    return;
+  for (int i = 0; i < options.entries; ++i) {
+    std::ostringstream name;
+    name << directory << "/file-" << i << ".txt";
+    if (!WriteFile(name.str(), "x", 1, 1))
+      return;
+  }
+
+  picojson::object message;
+  message["cmd"] = picojson::value("FileListFiles");
+  message["fullPath"] = picojson::value("documents/list");
+  message["filter"] = picojson::value("");
+  message["withStat"] = picojson::value(true);
+
+  benchmark::Measurement measurement(CaseName("listFiles",
+                                              options.entries));
+  for (int i = 0; i < options.iterations; ++i) {
+    measurement.Start();
+    std::string reply = Call(message);
+    measurement.Stop();
+    if (IsError(reply)) {
+      std::cerr << "listFiles failed: " << reply << "\n";
+      return;
+    }
+  }
+  measurement.Print();
+}
+
+double OpenStream(const char* mode) {
+  picojson::object message;
+  message["cmd"] = picojson::value("FileOpenStream");
+  message["fullPath"] = picojson::value("documents/stream.bin");
+  message["mode"] = picojson::value(mode);
+  message["encoding"] = picojson::value("UTF-8");
+
+  picojson::value reply;
+  std::string reply_json = Call(message);
+  std::string error;
+  picojson::parse(reply, reply_json.begin(), reply_json.end(), &error);
+  if (!error.empty() || reply.get("isError").evaluate_as_boolean())
+    return -1;
+  return reply.get("streamID").get<double>();
+}
+
+void CloseStream(double stream) {
+  picojson::object message;
+  message["cmd"] = picojson::value("FileStreamClose");
+  message["streamID"] = picojson::value(stream);
+  SyncCall(message);
+}
+
+// The data of a write of |size| bytes, ASCII so it is valid in every
+// encoding.
+picojson::value ChunkData(const StreamType& type, size_t size) {
+  if (!strcmp(type.type, "Bytes")) {
+    picojson::array bytes(size, picojson::value(120.0));
+    return picojson::value(bytes);
+  }
+  if (!strcmp(type.type, "Base64")) {
+    // Decodes to |size| bytes.
+    std::string base64((size + 2) / 3 * 4, 'e');
+    return picojson::value(base64);
+  }
+  return picojson::value(std::string(size, 'x'));
+}
+
+void BenchmarkStreams(const std::string& real_root, const Options& options) {
+  uint64_t total = static_cast<uint64_t>(options.stream_mb) * 1024 * 1024;
+  if (!WriteFile(real_root + "/stream.bin", "", 0, 0))
+    return;
+
+  for (size_t t = 0; t < sizeof(kStreamTypes) / sizeof(kStreamTypes[0]);
+       ++t) {
+    const StreamType& type = kStreamTypes[t];
+    std::string prefix = std::string(type.type) + "." + type.encoding;
+
+    for (size_t c = 0; c < sizeof(kChunkSizes) / sizeof(kChunkSizes[0]);
+         ++c) {
+      size_t size = kChunkSizes[c];
+      size_t calls = std::max<uint64_t>(total / size, 1);
+
+      double stream = OpenStream("w");
+      if (stream < 0) {
+        std::cerr << "openStream failed\n";
+        return;
+      }
+      picojson::object write;
+      write["cmd"] = picojson::value("FileStreamWrite");
+      write["streamID"] = picojson::value(stream);
+      write["type"] = picojson::value(type.type);
+      write["encoding"] = picojson::value(type.encoding);
+      write["data"] = ChunkData(type, size);
+      std::string write_json = picojson::value(write).serialize();
+
+      benchmark::ExtensionHost& host = benchmark::ExtensionHost::GetInstance();
+      benchmark::Measurement writes(CaseName((prefix + ".write").c_str(),
+                                             size));
+      for (size_t i = 0; i < calls; ++i) {
+        writes.Start();
+        std::string reply = host.SendSyncMessage(g_instance, write_json);
+        writes.Stop(size);
+        if (i == 0 && IsError(reply)) {
+          std::cerr << prefix << " write failed: " << reply << "\n";
+          break;
+        }
+      }
+      CloseStream(stream);
+      writes.Print();
+
+      stream = OpenStream("r");
+      if (stream < 0) {
+        std::cerr << "openStream failed\n";
+        return;
+      }
+      picojson::object read;
+      read["cmd"] = picojson::value("FileStreamRead");
+      read["streamID"] = picojson::value(stream);
+      read["type"] = picojson::value(type.type);
+      read["encoding"] = picojson::value(type.encoding);
+      read["count"] = picojson::value(static_cast<double>(size));
+      std::string read_json = picojson::value(read).serialize();
+
+      benchmark::Measurement reads(CaseName((prefix + ".read").c_str(),
+                                            size));
+      for (size_t i = 0; i < calls; ++i) {
+        reads.Start();
+        std::string reply = host.SendSyncMessage(g_instance, read_json);
+        reads.Stop(size);
+        if (i == 0 && IsError(reply)) {
+          std::cerr << prefix << " read failed: " << reply << "\n";
+          break;
+        }
+      }
+      CloseStream(stream);
+      reads.Print();
+    }
+  }
+}
+
+void BenchmarkCopy(const std::string& real_root, const Options& options) {
+  std::vector<char> block(1024 * 1024);
+  for (size_t i = 0; i < block.size(); ++i)
+    block[i] = static_cast<char>(i * 2654435761u >> 24);
+  if (!WriteFile(real_root + "/copy-source.bin", &block[0], block.size(),
+                 options.copy_mb)) {
+    std::cerr << "Can't write the " << options.copy_mb << " MB copy source\n";
+    return;
+  }
+
+  picojson::object message;
+  message["cmd"] = picojson::value("FileCopyTo");
+  message["originFilePath"] = picojson::value("documents/copy-source.bin");
+  message["destinationFilePath"] =
+      picojson::value("documents/copy-destination.bin");
+  message["overwrite"] = picojson::value(true);
+
+  uint64_t size = static_cast<uint64_t>(options.copy_mb) * 1024 * 1024;
+  benchmark::Measurement measurement(CaseName("copyTo", size));
+  for (int i = 0; i < options.iterations; ++i) {
+    measurement.Start();
+    std::string reply = Call(message);
+    measurement.Stop(size);
+    if (IsError(reply)) {
+      std::cerr << "copyTo failed: " << reply << "\n";
+      break;
+    }
+  }
+  measurement.Print();
+
+  unlink((real_root + "/copy-source.bin").c_str());
+  unlink((real_root + "/copy-destination.bin").c_str());
+}
+
+// A chain of |depth| directories with a few files at each level.
+bool MakeDeepTree(const std::string& root, int depth) {
+  std::string path = root;
+  if (!MakeDirectory(path))
+    return false;
+  for (int level = 0; level < depth; ++level) {
+    for (int i = 0; i < 4; ++i) {
+      std::ostringstream name;
+      name << path << "/f" << i;
+      if (!WriteFile(name.str(), "data", 4, 1))
+        return false;
+    }
+    path += "/d";
+    if (!MakeDirectory(path))
+      return false;
+  }
+  return true;
+}
+
+void BenchmarkDelete(const std::string& real_root, const Options& options) {
+  picojson::object message;
+  message["cmd"] = picojson::value("FileDeleteDirectory");
+  message["directoryPath"] = picojson::value("documents/tree");
+  message["recursive"] = picojson::value(true);
+
+  benchmark::Measurement measurement(CaseName("deleteDirectory",
+                                              options.depth));
+  for (int i = 0; i < options.iterations; ++i) {
+    if (!MakeDeepTree(real_root + "/tree", options.depth)) {
+      std::cerr << "Can't create the tree to delete\n";
+      return;
+    }
+    measurement.Start();
+    std::string reply = Call(message);
+    measurement.Stop();
+    if (IsError(reply)) {
+      std::cerr << "deleteDirectory failed: " << reply << "\n";
+      break;
+    }
+  }
+  measurement.Print();
+  RemoveTree(real_root + "/tree");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::string sandbox = options.sandbox;
+  if (sandbox.empty()) {
+    std::string sandbox_template =
+        access("/dev/shm", W_OK) == 0 ? "/dev/shm/fsbench-XXXXXX" :
+                                        "/tmp/fsbench-XXXXXX";
+    if (!mkdtemp(&sandbox_template[0])) {
+      std::cerr << "Can't create the sandbox\n";
+      return 1;
+    }
+    sandbox = sandbox_template;
+  } else if (mkdir(sandbox.c_str(), 0755) < 0) {
+    // Removed with all its content at the end, so it must be new.
+    std::cerr << "Can't create " << sandbox << ": " << strerror(errno)
+              << "\n";
+    return 1;
+  }
+  std::cerr << "Sandbox: " << sandbox << "\n";
+
+  // Read when the instance is created.
+  setenv("FILESYSTEM_MEDIA_ROOT", sandbox.c_str(), 1);
+
+  benchmark::ExtensionHost& host = benchmark::ExtensionHost::GetInstance();
+  if (!host.Load(options.module))
+    return 1;
+  host.SetMessageCallback(ReplyWaiter::OnMessage, &g_waiter);
+  g_instance = host.CreateInstance();
+
+  // The "documents" storage.
+  std::string real_root = sandbox + "/Documents";
+
+  benchmark::Measurement::PrintHeader();
+  BenchmarkListFiles(real_root, options);
+  BenchmarkStreams(real_root, options);
+  BenchmarkCopy(real_root, options);
+  BenchmarkDelete(real_root, options);
+
+  host.DestroyInstance(g_instance);
+  RemoveTree(sandbox);
+  return 0;
+}
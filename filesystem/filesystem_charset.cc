@@ -0,0 +1,191 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_charset.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+namespace {
+
+// Shorter runs of ASCII between other characters are left to iconv.
+const size_t kMinASCIIRun = 16;
+
+// Character sets in which the bytes below 0x80 are ASCII, and only ASCII.
+bool IsASCIICompatible(const std::string& charset) {
+  const char* kPrefixes[] = {
+    "UTF-8", "UTF8", "ISO-8859-", "ISO_8859-", "ISO8859-", "LATIN",
+    "ASCII", "US-ASCII", "WINDOWS-125", "CP125",
+  };
+  for (size_t i = 0; i < sizeof(kPrefixes) / sizeof(kPrefixes[0]); ++i) {
+    if (!strncasecmp(charset.c_str(), kPrefixes[i], strlen(kPrefixes[i])))
+      return true;
+  }
+  return false;
+}
+
+// Length of the run of ASCII at the start of |data|, 8 bytes at a time.
+size_t ASCIIPrefixLength(const char* data, size_t length) {
+  const uint64_t kHighBits = 0x8080808080808080ULL;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    if (word & kHighBits)
+      break;
+  }
+  while (i < length && !(data[i] & 0x80))
+    ++i;
+  return i;
+}
+
+}  // namespace
+
+CharsetConverter::CharsetConverter(const std::string& from,
+                                   const std::string& to)
+    : cd_(iconv_open(to.c_str(), from.c_str())),
+      ascii_compatible_(IsASCIICompatible(from) && IsASCIICompatible(to)) {}
+
+CharsetConverter::~CharsetConverter() {
+  if (IsValid())
+    iconv_close(cd_);
+}
+
+bool CharsetConverter::Convert(const char* data, size_t length,
+                               std::string* out) {
+  if (!pending_.empty()) {
+    // Completes the sequence cut at the end of the last chunk.
+    size_t end = length;
+    if (ascii_compatible_) {
+      end = 0;
+      while (end < length && (data[end] & 0x80))
+        ++end;
+    }
+
+    std::string chunk;
+    chunk.swap(pending_);
+    chunk.append(data, end);
+    if (!ConvertWithIconv(chunk.data(), chunk.size(), out) ||
+        !IsComplete(end, length))
+      return false;
+    data += end;
+    length -= end;
+  }
+
+  while (length > 0) {
+    if (ascii_compatible_) {
+      size_t ascii_length = ASCIIPrefixLength(data, length);
+      out->append(data, ascii_length);
+      data += ascii_length;
+      length -= ascii_length;
+      if (!length)
+        break;
+    }
+
+    // Up to the next run of ASCII long enough to be worth switching back
+    // for. Cutting before an ASCII byte never splits a sequence.
+    size_t end = length;
+    if (ascii_compatible_) {
+      end = 0;
+      while (end < length) {
+        while (end < length && (data[end] & 0x80))
+          ++end;
+        size_t run = ASCIIPrefixLength(data + end, length - end);
+        if (run >= kMinASCIIRun || end + run == length)
+          break;
+        end += run;
+      }
+    }
+
+    if (!ConvertWithIconv(data, end, out) || !IsComplete(end, length))
+      return false;
+    data += end;
+    length -= end;
+  }
+
+  return true;
+}
+
+void CharsetConverter::Reset() {
+  pending_.clear();
+  if (IsValid())
+    iconv(cd_, NULL, NULL, NULL, NULL);
+}
+
+bool CharsetConverter::IsComplete(size_t end, size_t length) {
+  // Only the end of the whole chunk can cut a sequence.
+  if (pending_.empty() || end == length)
+    return true;
+  pending_.clear();
+  return false;
+}
+
+bool CharsetConverter::ConvertWithIconv(const char* data, size_t length,
+                                        std::string* out) {
+  if (!IsValid())
+    return false;
+
+  char* in = const_cast<char*>(data);
+  size_t in_left = length;
+  size_t out_size = out->size();
+  // Enough for Latin-1 to UTF-8 at once, grown for wider conversions.
+  out->resize(out_size + length * 2 + 16);
+
+  while (in_left > 0) {
+    char* out_start = &(*out)[out_size];
+    char* out_ptr = out_start;
+    size_t out_left = out->size() - out_size;
+
+    size_t result = iconv(cd_, &in, &in_left, &out_ptr, &out_left);
+    out_size += out_ptr - out_start;
+    if (result != static_cast<size_t>(-1))
+      break;
+
+    if (errno == E2BIG) {
+      out->resize(out->size() * 2);
+    } else if (errno == EINVAL) {
+      // Cut at the end of the chunk, completed by the next one.
+      pending_.assign(in, in_left);
+      break;
+    } else {
+      out->resize(out_size);
+      return false;
+    }
+  }
+
+  out->resize(out_size);
+  return true;
+}
+
+CharsetConverterCache::~CharsetConverterCache() {
+  ConverterMap::iterator it;
+  for (it = converters_.begin(); it != converters_.end(); ++it)
+    delete it->second;
+}
+
+CharsetConverter* CharsetConverterCache::Get(const std::string& from,
+                                             const std::string& to) {
+  std::pair<std::string, std::string> key(from, to);
+  ConverterMap::iterator it = converters_.find(key);
+  if (it != converters_.end())
+    return it->second;
+
+  CharsetConverter* converter = new CharsetConverter(from, to);
+  if (!converter->IsValid()) {
+    delete converter;
+    converter = NULL;
+  }
+  converters_[key] = converter;
+  return converter;
+}
+
+void CharsetConverterCache::Reset() {
+  ConverterMap::iterator it;
+  for (it = converters_.begin(); it != converters_.end(); ++it) {
+    if (it->second)
+      it->second->Reset();
+  }
+}
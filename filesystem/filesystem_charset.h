@@ -0,0 +1,69 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_CHARSET_H_
+#define FILESYSTEM_FILESYSTEM_CHARSET_H_
+
+#include <iconv.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "common/utils.h"
+
+// Converts text from one character set to another with a single iconv
+// descriptor, opened once. Input can be split anywhere: a multibyte
+// sequence cut at the end of a chunk is kept and completed by the next
+// one. Runs of ASCII are copied as is when both character sets encode
+// ASCII as itself.
+class CharsetConverter {
+ public:
+  CharsetConverter(const std::string& from, const std::string& to);
+  ~CharsetConverter();
+
+  // False if iconv doesn't support the conversion.
+  bool IsValid() const { return cd_ != reinterpret_cast<iconv_t>(-1); }
+
+  // Appends the conversion of |data| to |out|. Returns false on a sequence
+  // invalid in the source character set.
+  bool Convert(const char* data, size_t length, std::string* out);
+
+  // Drops the incomplete sequence kept from the last chunk, if any.
+  void Reset();
+
+ private:
+  bool ConvertWithIconv(const char* data, size_t length, std::string* out);
+  // After converting |data| up to |end| out of |length|, false if a
+  // sequence was left incomplete before the end.
+  bool IsComplete(size_t end, size_t length);
+
+  iconv_t cd_;
+  bool ascii_compatible_;
+  std::string pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(CharsetConverter);
+};
+
+// The converters used by one stream, by (from, to) character sets.
+class CharsetConverterCache {
+ public:
+  CharsetConverterCache() {}
+  ~CharsetConverterCache();
+
+  // NULL if the conversion is not supported. Owned by the cache.
+  CharsetConverter* Get(const std::string& from, const std::string& to);
+
+  // Resets all the converters, when the stream position jumps.
+  void Reset();
+
+ private:
+  typedef std::map<std::pair<std::string, std::string>, CharsetConverter*>
+      ConverterMap;
+  ConverterMap converters_;
+
+  DISALLOW_COPY_AND_ASSIGN(CharsetConverterCache);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_CHARSET_H_
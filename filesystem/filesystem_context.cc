@@ -4,57 +4,53 @@
 
 #include "filesystem/filesystem_context.h"
 
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <iconv.h>
 
+#include <algorithm>
+#include <sstream>
 #include <utility>
 
+#include "common/base64.h"
+#include "filesystem/filesystem_archive_job.h"
+#include "filesystem/filesystem_batch_job.h"
+#include "filesystem/filesystem_copy_job.h"
+#include "filesystem/filesystem_delete_job.h"
+#include "filesystem/filesystem_find_job.h"
+#include "filesystem/filesystem_hash_job.h"
+#include "filesystem/filesystem_list_job.h"
+#include "filesystem/filesystem_utils.h"
+
 DEFINE_XWALK_EXTENSION(FilesystemContext)
 
 namespace {
 const unsigned kDefaultFileMode = 0755;
 const char kDefaultPath[] = "/opt/usr/media";
-const char kPathCamera[] = "/opt/usr/media/Camera";
-const char kPathSounds[] = "/opt/usr/media/Sounds";
-const char kPathImages[] = "/opt/usr/media/Images";
-const char kPathVideos[] = "/opt/usr/media/Videos";
-const char kPathDownloads[] = "/opt/usr/media/Downloads";
-const char kPathDocuments[] = "/opt/usr/media/Documents";
-
-const char kInternalStorage[] = "internal";
-const char kRemovableStorage[] = "removable";
-
-const char kStorageTypeInternal[] = "INTERNAL";
-const char kStorageTypeExternal[] = "EXTERNAL";
-const char kStorageStateMounted[] = "MOUNTED";
-const char kStorageStateRemoved[] = "REMOVED";
-const char kStorageStateUnmountable[] = "UNMOUNTABLE";
-
-unsigned int lastStreamId = 0;
-// FIXME(ricardotk): This needs another approach, kMaxSize is a palliative
-// solution.
-const unsigned kMaxSize = 64 * 1024;
-
-bool IsWritable(const struct stat& st) {
-  if (st.st_mode & S_IWOTH)
-    return true;
-  if ((st.st_mode & S_IWUSR) && geteuid() == st.st_uid)
-    return true;
-  if ((st.st_mode & S_IWGRP) && getegid() == st.st_gid)
-    return true;
-  return false;
-}
+const char kPathCamera[] = "Camera";
+const char kPathSounds[] = "Sounds";
+const char kPathImages[] = "Images";
+const char kPathVideos[] = "Videos";
+const char kPathDownloads[] = "Downloads";
+const char kPathDocuments[] = "Documents";
 
 
 std::string JoinPath(const std::string& one, const std::string& another) {
   return one + "/" + another;
 }
 
+// kDefaultPath, or the FILESYSTEM_MEDIA_ROOT environment variable for
+// filesystem_benchmark to run in a sandbox.
+std::string MediaRoot() {
+  const char* root = getenv("FILESYSTEM_MEDIA_ROOT");
+  return root ? root : kDefaultPath;
+}
+
 bool makePath(const std::string& path) {
   struct stat st;
   if (stat(path.c_str(), &st) != 0)
@@ -62,31 +58,44 @@ bool makePath(const std::string& path) {
   return true;
 }
 
+// A count of entries, 0 when missing, negative or NaN. Clamped as a double
+// before being converted, past INT_MAX entries being as good as any more.
+size_t GetCount(const picojson::value& value) {
+  if (!value.is<double>())
+    return 0;
+  double count = value.get<double>();
+  if (!(count > 0))
+    return 0;
+  if (count < INT_MAX)
+    return count;
+  return INT_MAX;
+}
+
 };  // namespace
 
 FilesystemContext::FilesystemContext(ContextAPI* api)
-    : api_(api) {
+    : api_(api),
+      jobs_(api),
+      streams_(FileStreamTable::DefaultMaxOpen()),
+      directory_watcher_(api),
+      storages_(api),
+      roots_generation_(0),
+      media_root_(MediaRoot()) {
   initialize();
 }
 
 void FilesystemContext::initialize() {
-  AddInternalStorage("camera", kPathCamera);
-  AddInternalStorage("music", kPathSounds);
-  AddInternalStorage("images", kPathImages);
-  AddInternalStorage("videos", kPathVideos);
-  AddInternalStorage("downloads", kPathDownloads);
-  AddInternalStorage("documents", kPathDocuments);
+  AddInternalStorage("camera", JoinPath(media_root_, kPathCamera));
+  AddInternalStorage("music", JoinPath(media_root_, kPathSounds));
+  AddInternalStorage("images", JoinPath(media_root_, kPathImages));
+  AddInternalStorage("videos", JoinPath(media_root_, kPathVideos));
+  AddInternalStorage("downloads", JoinPath(media_root_, kPathDownloads));
+  AddInternalStorage("documents", JoinPath(media_root_, kPathDocuments));
+  storages_.Start();
 }
 
-FilesystemContext::~FilesystemContext() {
-  FStreamMap::iterator it;
-
-  for (it = fstream_map_.begin(); it != fstream_map_.end(); it++) {
-    std::fstream* fs = it->second.second;
-    fs->close();
-    delete(fs);
-  }
-}
+// The stream watcher goes first, then the streams are closed by the table.
+FilesystemContext::~FilesystemContext() {}
 
 const char FilesystemContext::name[] = "tizen.filesystem";
 
@@ -123,10 +132,24 @@ void FilesystemContext::HandleMessage(const char* message) {
     HandleFileDeleteFile(v);
   else if (cmd == "FileListFiles")
     HandleFileListFiles(v);
+  else if (cmd == "FileFind")
+    HandleFileFind(v);
+  else if (cmd == "FileHash")
+    HandleFileHash(v);
+  else if (cmd == "FileGetDirectoryUsage")
+    HandleFileGetDirectoryUsage(v);
   else if (cmd == "FileCopyTo")
     HandleFileCopyTo(v);
   else if (cmd == "FileMoveTo")
     HandleFileMoveTo(v);
+  else if (cmd == "FileBatch")
+    HandleFileBatch(v);
+  else if (cmd == "FileExtractArchive")
+    HandleFileExtractArchive(v);
+  else if (cmd == "FileCreateArchive")
+    HandleFileCreateArchive(v);
+  else if (cmd == "FileCancelJob")
+    HandleFileCancelJob(v);
   else
     std::cout << "Ignoring unknown command: " << cmd;
 }
@@ -207,9 +230,16 @@ void FilesystemContext::HandleFileSystemManagerResolve(
   std::string real_path_ack = std::string(real_path_cstr);
   free(real_path_cstr);
 
-  if (check_if_inside_default && real_path_ack.find(kDefaultPath) != 0) {
-    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
-    return;
+  if (check_if_inside_default) {
+    // Compared as canonical paths, as the resolved one is.
+    char* media_root = realpath(media_root_.c_str(), NULL);
+    bool inside = media_root &&
+                  filesystem::IsPathInside(real_path_ack, media_root);
+    free(media_root);
+    if (!inside) {
+      PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+      return;
+    }
   }
 
   struct stat st;
@@ -221,7 +251,7 @@ void FilesystemContext::HandleFileSystemManagerResolve(
     return;
   }
 
-  if (!IsWritable(st) && (mode == "w" || mode == "rw")) {
+  if (!filesystem::IsWritable(st) && (mode == "w" || mode == "rw")) {
     PostAsyncErrorReply(msg, IO_ERR);
     return;
   }
@@ -233,30 +263,19 @@ void FilesystemContext::HandleFileSystemManagerResolve(
 
 void FilesystemContext::HandleFileSystemManagerGetStorage(
       const picojson::value& msg) {
-  storage_foreach_device_supported(OnStorageDeviceSupported, this);
-  Storages::const_iterator it = storages_.find(msg.get("label").to_str());
-
-  if (it == storages_.end()) {
+  picojson::value storage;
+  if (!storages_.Get(msg.get("label").to_str(), &storage)) {
     PostAsyncErrorReply(msg, NOT_FOUND_ERR);
     return;
   }
 
-  picojson::object storage_object = it->second.toJSON(it->first);
+  picojson::object storage_object = storage.get<picojson::object>();
   PostAsyncSuccessReply(msg, storage_object);
 }
 
 void FilesystemContext::HandleFileSystemManagerListStorages(
       const picojson::value& msg) {
-  storage_foreach_device_supported(OnStorageDeviceSupported, this);
-  picojson::array storage_objects;
-  Storages::const_iterator it = storages_.begin();
-  while (it != storages_.end()) {
-    picojson::object storage_object = it->second.toJSON(it->first);
-    storage_objects.push_back(picojson::value(storage_object));
-    ++it;
-  }
-
-  picojson::value value(storage_objects);
+  picojson::value value = storages_.List();
   PostAsyncSuccessReply(msg, value);
 }
 
@@ -267,15 +286,15 @@ void FilesystemContext::HandleFileOpenStream(const picojson::value& msg) {
   }
 
   std::string mode = msg.get("mode").to_str();
-  std::ios_base::openmode open_mode = std::ios_base::binary;
+  int open_flags;
   if (mode == "a") {
-    open_mode |= (std::ios_base::app | std::ios_base::out);
+    open_flags = O_WRONLY | O_APPEND;
   } else if (mode == "w") {
-    open_mode |= std::ios_base::out;
+    open_flags = O_WRONLY | O_TRUNC;
   } else if (mode == "rw") {
-    open_mode |= (std::ios_base::in | std::ios_base::out);
+    open_flags = O_RDWR;
   } else if (mode == "r") {
-    open_mode |= std::ios_base::in;
+    open_flags = O_RDONLY;
   } else {
     PostAsyncErrorReply(msg, TYPE_MISMATCH_ERR);
     return;
@@ -294,6 +313,14 @@ void FilesystemContext::HandleFileOpenStream(const picojson::value& msg) {
     return;
   }
 
+  // Atomic streams replace the file when closed, so there is nothing to
+  // make atomic when reading.
+  bool atomic = msg.get("atomic").evaluate_as_boolean();
+  if (atomic && open_flags == O_RDONLY) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
   std::string real_path = GetRealPath(msg.get("fullPath").to_str());
   char* real_path_cstr = realpath(real_path.c_str(), NULL);
   if (!real_path_cstr) {
@@ -315,60 +342,51 @@ void FilesystemContext::HandleFileOpenStream(const picojson::value& msg) {
     return;
   }
 
-  std::fstream* fs = new std::fstream(real_path_cstr, open_mode);
-  if (!(*fs) || !fs->is_open()) {
+  // Truncating an empty file would only release the space createFile()
+  // reserved for it.
+  if ((open_flags & O_TRUNC) && st.st_size == 0)
+    open_flags &= ~O_TRUNC;
+
+  stream_committer_.CommitPath(real_path_cstr);
+  FileStream* stream = streams_.Open(real_path_cstr, open_flags, atomic);
+  if (!stream) {
     free(real_path_cstr);
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
-  free(real_path_cstr);
 
-  fstream_map_[lastStreamId] = FStream(open_mode, fs);
+  unsigned int key = streams_.Add(stream);
+  if (key == FileStreamTable::kInvalidHandle) {
+    free(real_path_cstr);
+    delete stream;
+    PostAsyncErrorReply(msg, IO_ERR);
+    return;
+  }
+  int advice = 0;
+  if (msg.get("sequential").evaluate_as_boolean())
+    advice |= FileStream::ADVICE_SEQUENTIAL;
+  if (msg.get("noCache").evaluate_as_boolean())
+    advice |= FileStream::ADVICE_DONTNEED;
+  if (advice)
+    stream->SetAdvice(advice);
+
+  // Nobody else writes to the temporary file of an atomic stream.
+  if (atomic) {
+    if (msg.get("commitInterval").is<double>() &&
+        msg.get("commitInterval").get<double>() > 0)
+      stream->set_commit_interval(msg.get("commitInterval").get<double>());
+  } else {
+    stream_watcher_.Watch(stream, real_path_cstr);
+  }
+  free(real_path_cstr);
 
   picojson::value::object o;
-  o["streamID"] = picojson::value(static_cast<double>(lastStreamId));
+  o["streamID"] = picojson::value(static_cast<double>(key));
   o["encoding"] = picojson::value(encoding);
-  lastStreamId++;
 
   PostAsyncSuccessReply(msg, o);
 }
 
-static bool RecursiveDeleteDirectory(const std::string& path) {
-  DIR* dir = opendir(path.c_str());
-  if (!dir)
-    return false;
-  struct dirent entry, *buffer;
-  int fd = dirfd(dir);
-  if (fd < 0)
-    goto error;
-
-  while (!readdir_r(dir, &entry, &buffer)) {
-    struct stat st;
-
-    if (!buffer)
-      break;
-    if (!strcmp(entry.d_name, ".") || !strcmp(entry.d_name, ".."))
-      continue;
-    if (fstatat(fd, entry.d_name, &st, 0) < 0)
-      continue;
-
-    if (S_ISDIR(st.st_mode)) {
-      const std::string next_path = path + "/" + entry.d_name;
-      if (!RecursiveDeleteDirectory(next_path))
-        goto error;
-    } else if (unlinkat(fd, entry.d_name, 0) < 0) {
-      goto error;
-    }
-  }
-
-  closedir(dir);
-  return rmdir(path.c_str()) >= 0;
-
- error:
-  closedir(dir);
-  return false;
-}
-
 void FilesystemContext::HandleFileDeleteDirectory(const picojson::value& msg) {
   if (!msg.contains("directoryPath")) {
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
@@ -383,11 +401,11 @@ void FilesystemContext::HandleFileDeleteDirectory(const picojson::value& msg) {
   }
 
   if (recursive) {
-    if (!RecursiveDeleteDirectory(real_path)) {
-      PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
-      return;
-    }
-  } else if (rmdir(real_path.c_str()) < 0) {
+    jobs_.Start(new DeleteDirectoryJob(msg, real_path));
+    return;
+  }
+
+  if (rmdir(real_path.c_str()) < 0) {
     PostAsyncErrorReply(msg, IO_ERR);
     return;
   }
@@ -438,31 +456,55 @@ void FilesystemContext::HandleFileListFiles(const picojson::value& msg) {
     return;
   }
 
-  DIR* directory = opendir(real_path.c_str());
-  if (!directory) {
-    PostAsyncErrorReply(msg, IO_ERR);
+  jobs_.Start(new ListFilesJob(msg, real_path, msg.get("fullPath").to_str(),
+                               msg.get("withStat").evaluate_as_boolean(),
+                               GetCount(msg.get("offset")),
+                               GetCount(msg.get("limit")),
+                               GetCount(msg.get("chunkSize"))));
+}
+
+void FilesystemContext::HandleFileFind(const picojson::value& msg) {
+  if (!msg.contains("fullPath")) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  picojson::value::array a;
+  std::string real_path = GetRealPath(msg.get("fullPath").to_str());
+  if (real_path.empty()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
-  struct dirent entry, *buffer;
-  while (!readdir_r(directory, &entry, &buffer)) {
-    if (!buffer)
-      break;
-    if (!strcmp(entry.d_name, ".") || !strcmp(entry.d_name, ".."))
-      continue;
+  FindJob* job = new FindJob(msg, real_path, msg.get("fullPath").to_str());
+  if (!job->ParseFilters(msg)) {
+    delete job;
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
-    a.push_back(picojson::value(JoinPath(msg.get("fullPath").to_str(),
-                                         entry.d_name)));
+  jobs_.Start(job);
+}
+
+void FilesystemContext::HandleFileHash(const picojson::value& msg) {
+  if (!msg.contains("fullPath")) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
   }
 
-  closedir(directory);
+  std::string real_path = GetRealPath(msg.get("fullPath").to_str());
+  if (real_path.empty()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
-  picojson::value v(a);
-  PostAsyncSuccessReply(msg, v);
-}
+  Hasher* hasher = Hasher::Create(msg.get("algorithm").to_str());
+  if (!hasher) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
+  jobs_.Start(new HashJob(msg, real_path, hasher));
+}
 
 bool FilesystemContext::CopyAndRenameSanityChecks(const picojson::value& msg,
       const std::string& from, const std::string& to, bool overwrite) {
@@ -483,7 +525,7 @@ bool FilesystemContext::CopyAndRenameSanityChecks(const picojson::value& msg,
     return false;
   }
 
-  if (overwrite && !IsWritable(destination_parent_st)) {
+  if (overwrite && !filesystem::IsWritable(destination_parent_st)) {
     PostAsyncErrorReply(msg, IO_ERR);
     return false;
   }
@@ -500,71 +542,6 @@ bool FilesystemContext::CopyAndRenameSanityChecks(const picojson::value& msg,
   return true;
 }
 
-namespace {
-
-class PosixFile {
- private:
-  int fd_;
-  int mode_;
-  std::string path_;
-  bool unlink_when_done_;
- public:
-  PosixFile(const std::string& path, int mode)
-      : fd_(open(path.c_str(), mode, kDefaultFileMode))
-      , mode_(mode)
-      , path_(path)
-      , unlink_when_done_(mode & O_CREAT) {}
-  ~PosixFile();
-
-  bool is_valid() { return fd_ >= 0; }
-
-  void UnlinkWhenDone(bool setting) { unlink_when_done_ = setting; }
-
-  ssize_t Read(char* buffer, size_t count);
-  ssize_t Write(char* buffer, size_t count);
-};
-
-PosixFile::~PosixFile() {
-  if (fd_ < 0)
-    return;
-
-  close(fd_);
-  if (unlink_when_done_)
-    unlink(path_.c_str());
-}
-
-ssize_t PosixFile::Read(char* buffer, size_t count) {
-  if (fd_ < 0)
-    return -1;
-
-  while (true) {
-    ssize_t read_bytes = read(fd_, buffer, count);
-    if (read_bytes < 0) {
-      if (errno == EINTR)
-        continue;
-      return -1;
-    }
-    return read_bytes;
-  }
-}
-
-ssize_t PosixFile::Write(char* buffer, size_t count) {
-  if (fd_ < 0)
-    return -1;
-
-  while (true) {
-    ssize_t written_bytes = write(fd_, buffer, count);
-    if (written_bytes < 0) {
-      if (errno == EINTR)
-        continue;
-      return -1;
-    }
-    return written_bytes;
-  }
-}
-
-}  // namespace
-
 void FilesystemContext::HandleFileCopyTo(const picojson::value& msg) {
   if (!msg.contains("originFilePath")) {
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
@@ -580,6 +557,10 @@ void FilesystemContext::HandleFileCopyTo(const picojson::value& msg) {
      GetRealPath(msg.get("originFilePath").to_str());
   std::string real_destination_path =
      GetRealPath(msg.get("destinationFilePath").to_str());
+  if (real_origin_path.empty() || real_destination_path.empty()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
   if (*real_destination_path.rbegin() == '/' ||
       *real_destination_path.rbegin() == '\\') {
@@ -591,37 +572,163 @@ void FilesystemContext::HandleFileCopyTo(const picojson::value& msg) {
                                  overwrite))
     return;
 
-  PosixFile origin(real_origin_path, O_RDONLY);
-  if (!origin.is_valid()) {
-    PostAsyncErrorReply(msg, IO_ERR);
+  jobs_.Start(new CopyJob(msg, real_origin_path, real_destination_path,
+                          overwrite));
+}
+
+void FilesystemContext::HandleFileGetDirectoryUsage(
+      const picojson::value& msg) {
+  if (!msg.contains("fullPath")) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  PosixFile destination(real_destination_path, O_WRONLY | O_CREAT |
-                                               (overwrite ? O_TRUNC : O_EXCL));
-  if (!destination.is_valid()) {
-    PostAsyncErrorReply(msg, IO_ERR);
+  std::string real_path = GetRealPath(msg.get("fullPath").to_str());
+  if (real_path.empty()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
+  // One cache entry per directory, however it is spelled.
+  while (real_path.size() > 1 && *real_path.rbegin() == '/')
+    real_path.erase(real_path.size() - 1);
 
-  while (true) {
-    char buffer[512];
-    ssize_t read_bytes = origin.Read(buffer, 512);
-    if (!read_bytes)
-      break;
-    if (read_bytes < 0) {
-      PostAsyncErrorReply(msg, IO_ERR);
+  picojson::object usage;
+  if (usage_cache_.Lookup(real_path, &usage)) {
+    picojson::value value(usage);
+    PostAsyncSuccessReply(msg, value);
+    return;
+  }
+
+  jobs_.Start(new UsageJob(msg, real_path, &usage_cache_));
+}
+
+void FilesystemContext::HandleFileBatch(const picojson::value& msg) {
+  if (!msg.get("operations").is<picojson::array>()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  // Paths are resolved here, the storages are not shared with the workers.
+  // An operation that can't be resolved fails on its own.
+  const picojson::array& items = msg.get("operations").get<picojson::array>();
+  std::vector<BatchOperation> operations(items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    const picojson::value& item = items[i];
+    BatchOperation& operation = operations[i];
+    if (!item.is<picojson::object>()) {
+      operation.error = INVALID_VALUES_ERR;
+      continue;
+    }
+
+    std::string type = item.get("type").to_str();
+    if (type == "copy") {
+      operation.type = BatchOperation::COPY;
+    } else if (type == "move") {
+      operation.type = BatchOperation::MOVE;
+    } else if (type == "delete") {
+      operation.type = BatchOperation::DELETE;
+    } else {
+      operation.error = INVALID_VALUES_ERR;
+      continue;
+    }
+    operation.overwrite = item.get("overwrite").evaluate_as_boolean();
+    operation.recursive = item.get("recursive").evaluate_as_boolean();
+
+    if (operation.type == BatchOperation::DELETE) {
+      operation.from = GetRealPath(item.get("path").to_str());
+      if (operation.from.empty())
+        operation.error = INVALID_VALUES_ERR;
+      continue;
+    }
+
+    operation.from = GetRealPath(item.get("originFilePath").to_str());
+    operation.to = GetRealPath(item.get("destinationFilePath").to_str());
+    if (operation.from.empty() || operation.to.empty()) {
+      operation.error = INVALID_VALUES_ERR;
+      continue;
+    }
+    if (*operation.to.rbegin() == '/') {
+      unsigned found = operation.from.find_last_of('/');
+      operation.to.append(operation.from.substr(found + 1));
+    }
+  }
+
+  // Within [1, DefaultThreadCount()], clamped as a double before being
+  // converted, NaN keeping the default.
+  int parallelism = WorkerPool::DefaultThreadCount();
+  if (msg.get("parallelism").is<double>()) {
+    double requested = msg.get("parallelism").get<double>();
+    if (requested < 1)
+      parallelism = 1;
+    else if (requested < parallelism)
+      parallelism = requested;
+  }
+
+  jobs_.Start(new BatchJob(msg, operations,
+                           msg.get("stopOnError").evaluate_as_boolean(),
+                           parallelism));
+}
+
+void FilesystemContext::HandleFileExtractArchive(
+      const picojson::value& msg) {
+  std::string archive = GetRealPath(msg.get("archivePath").to_str());
+  std::string destination = GetRealPath(msg.get("destinationPath").to_str());
+  if (archive.empty() || destination.empty()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  bool overwrite = msg.get("overwrite").evaluate_as_boolean();
+  jobs_.Start(new ExtractArchiveJob(msg, archive, destination, overwrite));
+}
+
+void FilesystemContext::HandleFileCreateArchive(const picojson::value& msg) {
+  if (!msg.get("sources").is<picojson::array>()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  const picojson::array& items = msg.get("sources").get<picojson::array>();
+  std::vector<std::string> sources;
+  for (size_t i = 0; i < items.size(); ++i) {
+    std::string source = GetRealPath(items[i].to_str());
+    if (source.empty()) {
+      PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
       return;
     }
+    sources.push_back(source);
+  }
 
-    if (destination.Write(buffer, read_bytes) < 0) {
-      PostAsyncErrorReply(msg, IO_ERR);
+  std::string destination = GetRealPath(msg.get("destinationPath").to_str());
+  CreateArchiveJob::Format format;
+  if (sources.empty() || destination.empty() ||
+      !CreateArchiveJob::GetFormat(msg.get("format").is<std::string>() ?
+                                   msg.get("format").to_str() : "",
+                                   destination, &format)) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  int level = CreateArchiveJob::kDefaultLevel;
+  if (msg.get("level").is<double>()) {
+    level = msg.get("level").get<double>();
+    if (level < 0 || level > 9) {
+      PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
       return;
     }
   }
 
-  destination.UnlinkWhenDone(false);
-  PostAsyncSuccessReply(msg);
+  bool overwrite = msg.get("overwrite").evaluate_as_boolean();
+  jobs_.Start(new CreateArchiveJob(msg, sources, destination, format, level,
+                                   overwrite));
+}
+
+void FilesystemContext::HandleFileCancelJob(const picojson::value& msg) {
+  // Nothing is replied, a malformed cancellation is ignored.
+  if (!msg.get("jobId").is<double>())
+    return;
+
+  jobs_.Cancel(msg.get("jobId").get<double>());
 }
 
 void FilesystemContext::HandleFileMoveTo(const picojson::value& msg) {
@@ -639,6 +746,10 @@ void FilesystemContext::HandleFileMoveTo(const picojson::value& msg) {
      GetRealPath(msg.get("originFilePath").to_str());
   std::string real_destination_path =
      GetRealPath(msg.get("destinationFilePath").to_str());
+  if (real_origin_path.empty() || real_destination_path.empty()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
   if (!CopyAndRenameSanityChecks(msg, real_origin_path, real_destination_path,
                                  overwrite))
@@ -672,6 +783,8 @@ void FilesystemContext::HandleSyncMessage(const char* message) {
     HandleFileStreamRead(v, reply);
   else if (cmd == "FileStreamWrite")
     HandleFileStreamWrite(v, reply);
+  else if (cmd == "FileStreamFlush")
+    HandleFileStreamFlush(v, reply);
   else if (cmd == "FileCreateDirectory")
     HandleFileCreateDirectory(v, reply);
   else if (cmd == "FileCreateFile")
@@ -686,6 +799,12 @@ void FilesystemContext::HandleSyncMessage(const char* message) {
     HandleFileStreamStat(v, reply);
   else if (cmd == "FileStreamSetPosition")
     HandleFileStreamSetPosition(v, reply);
+  else if (cmd == "FileAddDirectoryWatch")
+    HandleFileAddDirectoryWatch(v, reply);
+  else if (cmd == "FileRemoveWatch")
+    HandleFileRemoveWatch(v, reply);
+  else if (cmd == "FileExportURI")
+    HandleFileExportURI(v, reply);
   else
     std::cout << "Ignoring unknown command: " << cmd;
 
@@ -708,34 +827,18 @@ bool FilesystemContext::IsKnownFileStream(const picojson::value& msg) {
     return false;
   unsigned int key = msg.get("streamID").get<double>();
 
-  return fstream_map_.find(key) != fstream_map_.end();
+  return streams_.Contains(key);
 }
 
-std::fstream* FilesystemContext::GetFileStream(unsigned int key) {
-  FStreamMap::iterator it = fstream_map_.find(key);
-  if (it == fstream_map_.end())
-    return NULL;
-  std::fstream* fs = it->second.second;
-
-  if (fs->is_open())
-    return fs;
-  return NULL;
+FileStream* FilesystemContext::GetFileStream(unsigned int key) {
+  return streams_.Get(key);
 }
 
-std::fstream* FilesystemContext::GetFileStream(unsigned int key,
-    std::ios_base::openmode mode) {
-  FStreamMap::iterator it = fstream_map_.find(key);
-  if (it == fstream_map_.end())
-    return NULL;
-
-  if ((it->second.first & mode) != mode)
+FileStream* FilesystemContext::GetFileStream(unsigned int key, int access) {
+  FileStream* stream = GetFileStream(key);
+  if (!stream || !stream->CanAccess(access))
     return NULL;
-
-  std::fstream* fs = it->second.second;
-
-  if (fs->is_open())
-    return fs;
-  return NULL;
+  return stream;
 }
 
 void FilesystemContext::SetSyncError(std::string& output,
@@ -787,141 +890,28 @@ void FilesystemContext::HandleFileStreamClose(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  FStreamMap::iterator it = fstream_map_.find(key);
-  if (it != fstream_map_.end()) {
-    std::fstream* fs = it->second.second;
-    if (fs->is_open())
-      fs->close();
-    delete fs;
-    fstream_map_.erase(it);
-  }
-
-  SetSyncSuccess(reply);
-}
-
-namespace {
-namespace base64 {
-
-static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmn" \
-      "opqrstuvwxyz0123456789+/";
-
-std::string ConvertTo(std::string input) {
-  std::string encoded;
-  size_t input_len = input.length();
-
-  for (size_t i = 0; i < input_len;) {
-    unsigned triple = input[i];
-    i++;
-
-    triple <<= 8;
-    if (i < input_len)
-      triple |= input[i];
-    i++;
-
-    triple <<= 8;
-    if (i < input_len)
-      triple |= input[i];
-    i++;
-
-    encoded.push_back(chars[(triple & 0xfc0000) >> 18]);
-    encoded.push_back(chars[(triple & 0x3f000) >> 12]);
-    encoded.push_back((i > input_len + 1) ? '=' : chars[(triple & 0xfc0) >> 6]);
-    encoded.push_back((i > input_len) ? '=' : chars[triple & 0x3f]);
+  FileStream* stream = streams_.Remove(key);
+  if (!stream) {
+    SetSyncSuccess(reply);
+    return;
   }
 
-  return encoded;
-}
-
-int DecodeOne(char c) {
-  if (c < '0') {
-    if (c == '+')
-      return 62;
-    if (c == '/')
-      return 63;
-    return -1;
-  }
-  if (c <= '9')
-    return c - '0' + 52;
-  if (c >= 'A' && c <= 'Z')
-    return c - 'A';
-  if (c >= 'a' && c <= 'z')
-    return c - 'a' + 26;
-  return -1;
-}
-
-std::string ConvertFrom(std::string input) {
-  std::string decoded;
-  int input_len = input.length(), decoded_bits = 0, c, i;
-
-  if (input_len % 4)
-    return input;
-
-  for (i = 0; i < input_len;) {
-    c = input[i++];
-    if (c == '=')
-      break;
-    if (c > 255)
-      continue;
-    int decoded_byte = DecodeOne(c);
-    if (decoded_byte < 0)
-      continue;
-
-    decoded_bits |= decoded_byte;
-
-    if (i % 4 == 0) {
-      decoded.push_back(static_cast<char>(decoded_bits >> 16));
-      decoded.push_back(static_cast<char>(decoded_bits >> 8));
-      decoded.push_back(static_cast<char>(decoded_bits));
-      decoded_bits = 0;
-    } else {
-      decoded_bits <<= 6;
-    }
+  stream_watcher_.Unwatch(stream);
+  bool flushed;
+  if (stream->IsAtomic()) {
+    flushed = stream_committer_.Commit(stream);
+  } else {
+    flushed = stream->Flush();
+    delete stream;
   }
 
-  if (c == '=') {
-    switch (input_len - i) {
-    case 0:
-      return input;
-    case 1:
-      decoded.push_back(static_cast<char>(decoded_bits >> 10));
-      break;
-    case 2:
-      decoded.push_back(static_cast<char>(decoded_bits >> 16));
-      decoded.push_back(static_cast<char>(decoded_bits >> 8));
-      break;
-    }
+  if (!flushed) {
+    SetSyncError(reply, IO_ERR);
+    return;
   }
-
-  return decoded;
-}
-
-}  // namespace base64
-
-std::string ConvertCharacterEncoding(const char* from_encoding,
-                                     const char* to_encoding, char* buffer,
-                                     size_t buffer_len) {
-  iconv_t cd = iconv_open(from_encoding, to_encoding);
-
-  char converted[kMaxSize];
-  char *converted_buffer = converted;
-  size_t converted_len = sizeof(converted) - 1;
-
-  do {
-    if (iconv(cd, &buffer, &buffer_len, &converted_buffer, &converted_len)
-        == (size_t) -1) {
-      iconv_close(cd);
-      return "";
-    }
-  } while (buffer_len > 0 && converted_len > 0);
-  *converted_buffer = 0;
-
-  iconv_close(cd);
-
-  return std::string(converted, converted_len);
+  SetSyncSuccess(reply);
 }
 
-}  // namespace
-
 void FilesystemContext::HandleFileStreamRead(const picojson::value& msg,
       std::string& reply) {
   if (!IsKnownFileStream(msg)) {
@@ -930,57 +920,69 @@ void FilesystemContext::HandleFileStreamRead(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::streamsize count;
-  if (msg.contains("count"))
-    count = msg.get("count").get<double>();
-  else
-    count = kMaxSize;
+  // Without a count, the rest of the file is read, up to
+  // FileStream::kMaxRead.
+  size_t count = FileStream::kToEnd;
+  if (msg.get("count").is<double>()) {
+    double requested = msg.get("count").get<double>();
+    if (!(requested >= 0)) {
+      SetSyncError(reply, INVALID_VALUES_ERR);
+      return;
+    }
+    count = requested < FileStream::kMaxRead ? requested :
+                                               FileStream::kMaxRead;
+  }
 
-  std::fstream* fs = GetFileStream(key, std::ios_base::in);
-  if (!fs) {
+  FileStream* stream = GetFileStream(key, FileStream::READ);
+  if (!stream) {
     SetSyncError(reply, IO_ERR);
     return;
   }
+  stream_watcher_.Poll();
 
-  std::streampos initial_pos = fs->tellg();
-  char buffer[kMaxSize] = { 0 };
-  fs->read(buffer, count);
-  fs->clear();
-  std::streampos bytes_read = fs->tellg() - initial_pos;
-
-  if (fs->bad() || (strlen(buffer) == 0 && bytes_read <= 0)) {
-    fs->clear();
+  std::string buffer;
+  if (!stream->Read(count, &buffer) ||
+      (buffer.empty() && count > 0 && count != FileStream::kToEnd)) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
   if (msg.get("type").to_str() == "Bytes") {
     picojson::value::array a;
+    a.reserve(buffer.size());
 
-    for (int i = 0; i < bytes_read; i++) {
-      if (+buffer[i] != 0)
-        a.push_back(picojson::value(static_cast<double>(buffer[i])));
-    }
+    for (size_t i = 0; i < buffer.size(); i++)
+      a.push_back(picojson::value(static_cast<double>(
+          static_cast<unsigned char>(buffer[i]))));
 
     picojson::value v(a);
     SetSyncSuccess(reply, v);
     return;
   }
 
-  std::string buffer_as_string;
-  if (msg.get("encoding").to_str() == "ISO-8859-1")
-    buffer_as_string = ConvertCharacterEncoding("ISO_8859-1", "UTF-8", buffer,
-                                                bytes_read);
-  else
-    buffer_as_string = std::string(buffer, bytes_read);
-
   if (msg.get("type").to_str() == "Base64") {
-    std::string base64_buffer = base64::ConvertTo(buffer_as_string);
+    std::string base64_buffer;
+    base64::Encode(buffer.data(), buffer.size(), &base64_buffer);
     SetSyncSuccess(reply, base64_buffer);
     return;
   }
 
-  SetSyncSuccess(reply, buffer_as_string);
+  std::string encoding = msg.get("encoding").to_str();
+  if (encoding.empty() || encoding == "UTF-8") {
+    SetSyncSuccess(reply, buffer);
+    return;
+  }
+
+  // The converter keeps a sequence cut by |count| for the next read.
+  CharsetConverter* converter =
+      stream->converters()->Get(encoding, "UTF-8");
+  std::string text;
+  if (!converter || !converter->Convert(buffer.data(), buffer.size(), &text)) {
+    SetSyncError(reply, IO_ERR);
+    return;
+  }
+
+  SetSyncSuccess(reply, text);
 }
 
 void FilesystemContext::HandleFileStreamWrite(const picojson::value& msg,
@@ -996,34 +998,70 @@ void FilesystemContext::HandleFileStreamWrite(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::fstream* fs = GetFileStream(key, std::ios_base::out);
-  if (!fs) {
+  FileStream* stream = GetFileStream(key, FileStream::WRITE);
+  if (!stream) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
   std::string buffer;
   if (msg.get("type").to_str() == "Bytes") {
-    picojson::array a = msg.get("data").get<picojson::array>();
-    for (picojson::array::iterator iter = a.begin(); iter != a.end(); ++iter)
-      buffer.append<int>(1, (*iter).get<double>());
+    const picojson::array& a = msg.get("data").get<picojson::array>();
+    buffer.reserve(a.size());
+    for (picojson::array::const_iterator iter = a.begin(); iter != a.end();
+         ++iter)
+      buffer.push_back(static_cast<char>(static_cast<int>(
+          (*iter).get<double>())));
   } else if (msg.get("type").to_str() == "Base64") {
-    buffer = base64::ConvertFrom(msg.get("data").to_str());
+    std::string data = msg.get("data").to_str();
+    if (!base64::Decode(data.data(), data.size(), &buffer)) {
+      SetSyncError(reply, INVALID_VALUES_ERR);
+      return;
+    }
   } else {
-    buffer = msg.get("data").to_str();
+    // FIXME(ricardotk): get default platform encoding mode and compare.
+    std::string encoding = msg.get("encoding").to_str();
+    if (encoding.empty() || encoding == "UTF-8") {
+      buffer = msg.get("data").to_str();
+    } else {
+      std::string data = msg.get("data").to_str();
+      CharsetConverter* converter =
+          stream->converters()->Get("UTF-8", encoding);
+      if (!converter || !converter->Convert(data.data(), data.size(),
+                                            &buffer)) {
+        SetSyncError(reply, INVALID_VALUES_ERR);
+        return;
+      }
+    }
+  }
+
+  if (!stream->Write(buffer.data(), buffer.size())) {
+    SetSyncError(reply, IO_ERR);
+    return;
   }
 
-  // FIXME(ricardotk): get default platform encoding mode and compare.
-  if (msg.get("encoding").to_str() == "ISO-8859-1")
-    buffer = ConvertCharacterEncoding("ISO_8859-1", "UTF-8",
-                                                &buffer[0], buffer.length());
+  SetSyncSuccess(reply);
+}
+
+void FilesystemContext::HandleFileStreamFlush(const picojson::value& msg,
+      std::string& reply) {
+  if (!IsKnownFileStream(msg)) {
+    SetSyncError(reply, IO_ERR);
+    return;
+  }
+  unsigned int key = msg.get("streamID").get<double>();
+
+  FileStream* stream = GetFileStream(key, FileStream::WRITE);
+  if (!stream) {
+    SetSyncError(reply, IO_ERR);
+    return;
+  }
 
-  if (!((*fs) << buffer)) {
-    fs->clear();
+  bool sync = msg.get("sync").evaluate_as_boolean();
+  if (!(sync ? stream->Sync() : stream->Flush())) {
     SetSyncError(reply, IO_ERR);
     return;
   }
-  fs->flush();
 
   SetSyncSuccess(reply);
 }
@@ -1084,6 +1122,16 @@ void FilesystemContext::HandleFileCreateFile(const picojson::value& msg,
     return;
   }
 
+  // The size the file is expected to grow to.
+  double size = 0;
+  if (msg.contains("size")) {
+    if (!msg.get("size").is<double>() || msg.get("size").get<double>() < 0) {
+      SetSyncError(reply, INVALID_VALUES_ERR);
+      return;
+    }
+    size = msg.get("size").get<double>();
+  }
+
   int result = open(real_path.c_str(), O_CREAT | O_WRONLY | O_EXCL,
         kDefaultFileMode);
   if (result < 0) {
@@ -1091,6 +1139,19 @@ void FilesystemContext::HandleFileCreateFile(const picojson::value& msg,
     return;
   }
 
+  // Reserved past the end of the empty file, so that appending to it fills
+  // contiguous blocks instead of allocating them a write at a time. Only
+  // running out of space fails, the filesystems without fallocate() just
+  // don't get the hint.
+  if (size > 0 &&
+      fallocate(result, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) < 0 &&
+      errno == ENOSPC) {
+    close(result);
+    unlink(real_path.c_str());
+    SetSyncError(reply, IO_ERR);
+    return;
+  }
+
   close(result);
   SetSyncSuccess(reply, full_path);
 }
@@ -1121,6 +1182,109 @@ void FilesystemContext::HandleFileGetURI(const picojson::value& msg,
   SetSyncSuccess(reply, uri_path);
 }
 
+void FilesystemContext::HandleFileExportURI(const picojson::value& msg,
+      std::string& reply) {
+  std::string full_path = msg.get("fullPath").to_str();
+  std::string real_path = GetRealPath(full_path);
+  std::string root_path = GetRealPath(full_path.substr(0,
+                                                       full_path.find('/')));
+  if (real_path.empty() || root_path.empty()) {
+    SetSyncError(reply, INVALID_VALUES_ERR);
+    return;
+  }
+
+  // The URI names the file itself, not a symlink that could be redirected
+  // once it is handed out, and the file must be in the storage: a symlink
+  // in it could otherwise export any file the process can read.
+  char* canonical_path = realpath(real_path.c_str(), NULL);
+  if (!canonical_path) {
+    SetSyncError(reply, NOT_FOUND_ERR);
+    return;
+  }
+  real_path = canonical_path;
+  free(canonical_path);
+  char* canonical_root = realpath(root_path.c_str(), NULL);
+  bool inside = canonical_root &&
+                filesystem::IsPathInside(real_path, canonical_root);
+  free(canonical_root);
+  if (!inside) {
+    SetSyncError(reply, SECURITY_ERR);
+    return;
+  }
+
+  // Opening checks the read permission once, for the renderer reading the
+  // URI directly afterwards.
+  int fd = open(real_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    SetSyncError(reply, errno == EACCES ? SECURITY_ERR : IO_ERR);
+    return;
+  }
+  struct stat st;
+  int stat_result = fstat(fd, &st);
+  close(fd);
+  if (stat_result < 0 || !S_ISREG(st.st_mode)) {
+    SetSyncError(reply, stat_result < 0 ? IO_ERR : INVALID_VALUES_ERR);
+    return;
+  }
+
+  // Checked as doubles, NaN failing, before being converted.
+  int64_t size = st.st_size;
+  double requested_offset = 0;
+  double requested_length = size;
+  if (msg.get("offset").is<double>())
+    requested_offset = msg.get("offset").get<double>();
+  if (msg.get("length").is<double>())
+    requested_length = msg.get("length").get<double>();
+  if (!(requested_offset >= 0) || requested_offset > size ||
+      !(requested_length >= 0)) {
+    SetSyncError(reply, INVALID_VALUES_ERR);
+    return;
+  }
+  int64_t offset = requested_offset;
+  int64_t length = size - offset;
+  if (requested_length < length)
+    length = requested_length;
+
+  // Changes with any write or replacement of the file.
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%llx-%llx-%lx.%lx\"",
+           static_cast<unsigned long long>(st.st_ino),  // NOLINT
+           static_cast<unsigned long long>(size),  // NOLINT
+           static_cast<long>(st.st_mtim.tv_sec),  // NOLINT
+           static_cast<long>(st.st_mtim.tv_nsec));  // NOLINT
+  std::string last_modified = filesystem::FormatHTTPDate(st.st_mtime);
+
+  picojson::object headers;
+  headers["Last-Modified"] = picojson::value(last_modified);
+  headers["ETag"] = picojson::value(etag);
+  // Cacheable, but revalidated against the two above on each use.
+  headers["Cache-Control"] = picojson::value("private, no-cache");
+  // The range is only described, for the app to serve or cache it: the
+  // URI gives access to the whole file.
+  std::ostringstream content_length;
+  content_length << length;
+  headers["Content-Length"] = picojson::value(content_length.str());
+  // An empty range has no last byte to name.
+  if (length > 0 && (offset > 0 || length < size)) {
+    std::ostringstream content_range;
+    content_range << "bytes " << offset << "-" << offset + length - 1 << "/"
+                  << size;
+    headers["Content-Range"] = picojson::value(content_range.str());
+  }
+
+  picojson::object o;
+  o["uri"] = picojson::value(filesystem::FileURIFromPath(real_path));
+  o["size"] = picojson::value(static_cast<double>(size));
+  o["offset"] = picojson::value(static_cast<double>(offset));
+  o["length"] = picojson::value(static_cast<double>(length));
+  o["modified"] = picojson::value(static_cast<double>(st.st_mtime));
+  o["etag"] = picojson::value(etag);
+  o["headers"] = picojson::value(headers);
+
+  picojson::value value(o);
+  SetSyncSuccess(reply, value);
+}
+
 void FilesystemContext::HandleFileResolve(const picojson::value& msg,
       std::string& reply) {
   if (!msg.contains("fullPath")) {
@@ -1174,18 +1338,55 @@ void FilesystemContext::HandleFileStat(const picojson::value& msg,
     return;
   }
 
-  picojson::value::object o;
-  o["size"] = picojson::value(static_cast<double>(st.st_size));
-  o["modified"] = picojson::value(static_cast<double>(st.st_mtime));
-  o["created"] = picojson::value(static_cast<double>(st.st_ctime));  // ?
-  o["readOnly"] = picojson::value(!IsWritable(st));
-  o["isFile"] = picojson::value(!!S_ISREG(st.st_mode));
-  o["isDirectory"] = picojson::value(!!S_ISDIR(st.st_mode));
+  picojson::value v(filesystem::StatToJSON(st));
+  SetSyncSuccess(reply, v);
+}
 
-  picojson::value v(o);
+void FilesystemContext::HandleFileAddDirectoryWatch(
+      const picojson::value& msg, std::string& reply) {
+  if (!msg.contains("fullPath")) {
+    SetSyncError(reply, INVALID_VALUES_ERR);
+    return;
+  }
+
+  std::string full_path = msg.get("fullPath").to_str();
+  std::string real_path = GetRealPath(full_path);
+  if (real_path.empty()) {
+    SetSyncError(reply, NOT_FOUND_ERR);
+    return;
+  }
+
+  int id = directory_watcher_.AddWatch(real_path, full_path,
+      msg.get("recursive").evaluate_as_boolean());
+  if (id < 0) {
+    if (errno == ENOENT)
+      SetSyncError(reply, NOT_FOUND_ERR);
+    else if (errno == ENOTDIR)
+      SetSyncError(reply, TYPE_MISMATCH_ERR);
+    else
+      SetSyncError(reply, IO_ERR);
+    return;
+  }
+
+  picojson::value v(static_cast<double>(id));
   SetSyncSuccess(reply, v);
 }
 
+void FilesystemContext::HandleFileRemoveWatch(const picojson::value& msg,
+      std::string& reply) {
+  if (!msg.get("watchId").is<double>()) {
+    SetSyncError(reply, TYPE_MISMATCH_ERR);
+    return;
+  }
+
+  if (!directory_watcher_.RemoveWatch(msg.get("watchId").get<double>())) {
+    SetSyncError(reply, NOT_FOUND_ERR);
+    return;
+  }
+
+  SetSyncSuccess(reply);
+}
+
 void FilesystemContext::HandleFileStreamStat(const picojson::value& msg,
       std::string& reply) {
   if (!IsKnownFileStream(msg)) {
@@ -1194,37 +1395,20 @@ void FilesystemContext::HandleFileStreamStat(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::fstream* fs = GetFileStream(key);
-  if (!fs) {
+  FileStream* stream = GetFileStream(key);
+  if (!stream) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  std::streampos bytes_read = -1;
-  if (!fs->eof()) {
-    std::streampos initial_pos = fs->tellg();
-    char buffer[kMaxSize] = { 0 };
-    fs->read(buffer, kMaxSize);
-    bytes_read = fs->tellg() - initial_pos;
-    if (fs->bad()) {
-      fs->clear();
-      SetSyncError(reply, IO_ERR);
-      return;
-    }
-    // Recover the position.
-    fs->clear();
-    fs->seekg(initial_pos);
-    if (fs->bad()) {
-      fs->clear();
-      SetSyncError(reply, IO_ERR);
-      return;
-    }
-  }
+  // Only takes an fstat() when the file was modified behind the stream.
+  stream_watcher_.Poll();
 
   picojson::value::object o;
-  o["position"] = picojson::value(static_cast<double>(fs->tellg()));
-  o["eof"] = picojson::value(fs->eof());
-  o["bytesAvailable"] = picojson::value(static_cast<double>(bytes_read));
+  o["position"] = picojson::value(static_cast<double>(stream->position()));
+  o["eof"] = picojson::value(stream->IsEof());
+  o["bytesAvailable"] =
+      picojson::value(static_cast<double>(stream->BytesAvailable()));
 
   picojson::value v(o);
   SetSyncSuccess(reply, v);
@@ -1242,16 +1426,13 @@ void FilesystemContext::HandleFileStreamSetPosition(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::fstream* fs = GetFileStream(key);
-  if (!fs) {
+  FileStream* stream = GetFileStream(key);
+  if (!stream) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  int position = msg.get("position").get<double>();
-  fs->seekg(position);
-  if (fs->bad()) {
-    fs->clear();
+  if (!stream->Seek(msg.get("position").get<double>())) {
     SetSyncError(reply, IO_ERR);
     return;
   }
@@ -1260,117 +1441,14 @@ void FilesystemContext::HandleFileStreamSetPosition(const picojson::value& msg,
 }
 
 std::string FilesystemContext::GetRealPath(const std::string& fullPath) {
-  std::size_t pos = fullPath.find_first_of('/');
-  std::string virtual_root = fullPath;
-
-  if (pos != std::string::npos) {
-    virtual_root = fullPath.substr(0, pos);
-  }
-
-  Storages::const_iterator it = storages_.find(virtual_root);
-
-  if (it == storages_.end())
-    return std::string();
-
-  if (pos != std::string::npos)
-    return it->second.GetFullPath() + fullPath.substr(pos);
-
-  return it->second.GetFullPath();
+  storages_.UpdateRoots(&roots_, &roots_generation_);
+  return roots_.Resolve(fullPath);
 }
 
 void FilesystemContext::AddInternalStorage(
     const std::string& label, const std::string& path) {
-  if (makePath(path))
-    storages_.insert(SorageLabelPair(label,
-                                     Storage(-1,
-                                             Storage::STORAGE_TYPE_INTERNAL,
-                                             Storage::STORAGE_STATE_MOUNTED,
-                                             path)));
-}
-
-void FilesystemContext::AddStorage(int id,
-                                   storage_type_e type,
-                                   storage_state_e state,
-                                   const std::string& path) {
-  std::string label;
-  if (type == STORAGE_TYPE_INTERNAL)
-    label = kInternalStorage + std::to_string(id);
-  else if (type == STORAGE_TYPE_EXTERNAL)
-    label = kRemovableStorage + std::to_string(id);
-
-  storages_.insert(SorageLabelPair(label,
-                                   Storage(id,
-                                           type,
-                                           state,
-                                           path)));
-  if (std::find(watched_storages_.begin(),
-                watched_storages_.end(), id) != watched_storages_.end()) {
-    watched_storages_.push_back(id);
-    storage_set_state_changed_cb(id, OnStorageStateChanged, this);
-  }
-}
-
-void FilesystemContext::NotifyStorageStateChanged(int id,
-                                                  storage_state_e state) {
-  for (Storages::iterator it = storages_.begin(); it != storages_.end(); ++it) {
-    if (it->second.GetId() == id) {
-      it->second.SetState(state);
-      picojson::object reply;
-      reply["storage"] = picojson::value(it->second.toJSON(it->first));
-      reply["cmd"] = picojson::value("storageChanged");
-      picojson::value value(reply);
-      api_->PostMessage(value.serialize().c_str());
-      break;
-    }
-  }
-}
-
-bool FilesystemContext::OnStorageDeviceSupported(
-    int id, storage_type_e type, storage_state_e state,
-    const char *path, void* user_data) {
-  reinterpret_cast<FilesystemContext*>(user_data)->AddStorage(
-      id, type, state, path);
-  return true;
-}
-
-void FilesystemContext::OnStorageStateChanged(
-    int id, storage_state_e state, void* user_data) {
-  reinterpret_cast<FilesystemContext*>(user_data)->NotifyStorageStateChanged(
-      id, state);
-}
-
-FilesystemContext::Storage::Storage(
-    int id, int type, int state, const std::string& fullpath)
-  : id_(id),
-    type_(type),
-    state_(state),
-    fullpath_(fullpath) { }
-
-picojson::object FilesystemContext::Storage::toJSON(
-    const std::string& label) const {
-  picojson::object storage_object;
-  storage_object["label"] = picojson::value(label);
-  storage_object["type"] = picojson::value(type());
-  storage_object["state"] = picojson::value(state());
-  return storage_object;
-}
-
-std::string FilesystemContext::Storage::type() const {
-  return (type_ == Storage::STORAGE_TYPE_INTERNAL) ? kStorageTypeInternal :
-      kStorageTypeExternal;
-}
+  if (!makePath(path))
+    return;
 
-std::string FilesystemContext::Storage::state() const {
-  switch (state_) {
-  case Storage::STORAGE_STATE_MOUNTED:
-  case Storage::STORAGE_STATE_MOUNTED_READONLY:
-    return kStorageStateMounted;
-  case Storage::STORAGE_STATE_REMOVED:
-    return kStorageStateRemoved;
-  case Storage::STORAGE_STATE_UNMOUNTABLE:
-    return kStorageStateUnmountable;
-  default:
-    assert(!"Not reached");
-  }
-  return std::string();
+  storages_.AddInternal(label, path);
 }
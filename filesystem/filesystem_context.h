@@ -5,18 +5,21 @@
 #ifndef FILESYSTEM_FILESYSTEM_CONTEXT_H_
 #define FILESYSTEM_FILESYSTEM_CONTEXT_H_
 
-#include <app_storage.h>
-
 #include <set>
 #include <string>
 #include <map>
-#include <fstream>
 #include <iostream>
 #include <utility>
 #include <vector>
 
 #include "common/extension_adapter.h"
 #include "common/picojson.h"
+#include "filesystem/filesystem_job.h"
+#include "filesystem/filesystem_root_table.h"
+#include "filesystem/filesystem_storage.h"
+#include "filesystem/filesystem_stream.h"
+#include "filesystem/filesystem_usage_job.h"
+#include "filesystem/filesystem_watcher.h"
 #include "tizen/tizen.h"
 
 class FilesystemContext {
@@ -32,39 +35,6 @@ class FilesystemContext {
   void HandleSyncMessage(const char* message);
 
  private:
-  class Storage {
-   public:
-    /* Mapped to storage_type_e */
-    enum StorageType {
-      STORAGE_TYPE_INTERNAL,
-      STORAGE_TYPE_EXTERNAL,
-    };
-
-    /* Mapped to storage_state_e */
-    enum StorageState {
-      STORAGE_STATE_UNMOUNTABLE = -2,
-      STORAGE_STATE_REMOVED = -1,
-      STORAGE_STATE_MOUNTED = 0,
-      STORAGE_STATE_MOUNTED_READONLY = 1,
-    };
-
-    Storage(int id, int type, int state, const std::string& fullpath);
-
-    picojson::object toJSON(const std::string& label) const;
-
-    std::string type() const;
-    std::string state() const;
-    int GetId() const { return id_; }
-    const std::string& GetFullPath() const { return fullpath_; }
-    void SetState(int state) { state_ = state; }
-
-   private:
-    int id_;
-    int type_;
-    int state_;
-    std::string fullpath_;
-  };
-
   void initialize();
 
   /* Asynchronous messages */
@@ -75,8 +45,15 @@ class FilesystemContext {
   void HandleFileDeleteDirectory(const picojson::value& msg);
   void HandleFileDeleteFile(const picojson::value& msg);
   void HandleFileListFiles(const picojson::value& msg);
+  void HandleFileFind(const picojson::value& msg);
+  void HandleFileHash(const picojson::value& msg);
+  void HandleFileGetDirectoryUsage(const picojson::value& msg);
   void HandleFileCopyTo(const picojson::value& msg);
   void HandleFileMoveTo(const picojson::value& msg);
+  void HandleFileBatch(const picojson::value& msg);
+  void HandleFileExtractArchive(const picojson::value& msg);
+  void HandleFileCreateArchive(const picojson::value& msg);
+  void HandleFileCancelJob(const picojson::value& msg);
 
   /* Asynchronous message helpers */
   void PostAsyncErrorReply(const picojson::value&, WebApiAPIErrors);
@@ -91,20 +68,25 @@ class FilesystemContext {
   void HandleFileStreamClose(const picojson::value& msg, std::string& reply);
   void HandleFileStreamRead(const picojson::value& msg, std::string& reply);
   void HandleFileStreamWrite(const picojson::value& msg, std::string& reply);
+  void HandleFileStreamFlush(const picojson::value& msg, std::string& reply);
   void HandleFileCreateDirectory(const picojson::value& msg,
         std::string& reply);
   void HandleFileCreateFile(const picojson::value& msg, std::string& reply);
   void HandleFileGetURI(const picojson::value& msg, std::string& reply);
+  void HandleFileExportURI(const picojson::value& msg, std::string& reply);
   void HandleFileResolve(const picojson::value& msg, std::string& reply);
   void HandleFileStat(const picojson::value& msg, std::string& reply);
   void HandleFileStreamStat(const picojson::value& msg, std::string& reply);
   void HandleFileStreamSetPosition(const picojson::value& msg,
                                    std::string& reply);
+  void HandleFileAddDirectoryWatch(const picojson::value& msg,
+                                   std::string& reply);
+  void HandleFileRemoveWatch(const picojson::value& msg, std::string& reply);
 
   /* Sync message helpers */
   bool IsKnownFileStream(const picojson::value& msg);
-  std::fstream* GetFileStream(unsigned int key);
-  std::fstream* GetFileStream(unsigned int key, std::ios_base::openmode mode);
+  FileStream* GetFileStream(unsigned int key);
+  FileStream* GetFileStream(unsigned int key, int access);
   bool CopyAndRenameSanityChecks(const picojson::value& msg,
         const std::string& from, const std::string& to, bool overwrite);
   void SetSyncError(std::string& output, WebApiAPIErrors error_type);
@@ -112,24 +94,23 @@ class FilesystemContext {
   void SetSyncSuccess(std::string& reply, std::string& output);
   void SetSyncSuccess(std::string& reply, picojson::value& output);
 
+  // Empty for unknown roots and paths going up with "..".
   std::string GetRealPath(const std::string& fullPath);
   void AddInternalStorage(const std::string& label, const std::string& path);
-  void AddStorage(int storage, storage_type_e type, storage_state_e state,
-      const std::string& path);
-  void NotifyStorageStateChanged(int id, storage_state_e state);
-  static bool OnStorageDeviceSupported(int id, storage_type_e type,
-      storage_state_e state, const char *path, void *user_data);
-  static void OnStorageStateChanged(int id, storage_state_e state,
-      void *user_data);
 
   ContextAPI* api_;
-  typedef std::pair<std::ios_base::openmode, std::fstream*> FStream;
-  typedef std::map<unsigned int, FStream> FStreamMap;
-  FStreamMap fstream_map_;
-  typedef std::map<std::string, Storage> Storages;
-  typedef std::pair<std::string, Storage> SorageLabelPair;
-  Storages storages_;
-  std::vector<int> watched_storages_;
+  // Used by the jobs, so destroyed after them.
+  DirectoryUsageCache usage_cache_;
+  FilesystemJobs jobs_;
+  FileStreamTable streams_;
+  FileStreamCommitter stream_committer_;
+  FileStreamWatcher stream_watcher_;
+  DirectoryWatcher directory_watcher_;
+  StorageManager storages_;
+  VirtualRootTable roots_;
+  unsigned int roots_generation_;
+  // Of the internal storages.
+  std::string media_root_;
 };
 
 #endif  // FILESYSTEM_FILESYSTEM_CONTEXT_H_
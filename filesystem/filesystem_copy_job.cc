@@ -0,0 +1,393 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_copy_job.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+namespace {
+
+// Moved per kernel call, small enough for timely progress and cancellation.
+const size_t kKernelChunkSize = 8 * 1024 * 1024;
+const size_t kBufferSize = 1024 * 1024;
+
+// In order of preference.
+enum CopyMethod {
+  COPY_FILE_RANGE,
+  SENDFILE,
+  READ_WRITE,
+};
+
+bool WriteAll(int fd, const char* buffer, size_t count) {
+  while (count > 0) {
+    ssize_t written_bytes = write(fd, buffer, count);
+    if (written_bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    buffer += written_bytes;
+    count -= written_bytes;
+  }
+  return true;
+}
+
+// Copies up to |count| bytes at the offsets of the files.
+ssize_t CopyChunk(CopyMethod method, int in, int out, size_t count,
+                  std::vector<char>& buffer) {
+  switch (method) {
+  case COPY_FILE_RANGE:
+#if defined(__NR_copy_file_range)
+    return syscall(__NR_copy_file_range, in, NULL, out, NULL,
+                   std::min(count, kKernelChunkSize), 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+  case SENDFILE:
+    return sendfile(out, in, NULL, std::min(count, kKernelChunkSize));
+  case READ_WRITE: {
+    if (buffer.empty())
+      buffer.resize(kBufferSize);
+    ssize_t read_bytes = read(in, &buffer[0], std::min(count, buffer.size()));
+    if (read_bytes <= 0)
+      return read_bytes;
+    return WriteAll(out, &buffer[0], read_bytes) ? read_bytes : -1;
+  }
+  }
+  return -1;
+}
+
+// Errors for which the next method is worth trying on the same files.
+bool IsUnsupported(int error) {
+  switch (error) {
+  case ENOSYS:
+  case EXDEV:
+  case EINVAL:
+  case EBADF:
+  case EOPNOTSUPP:
+    return true;
+  default:
+    return false;
+  }
+}
+
+}  // namespace
+
+class CopyJob::CopyFileTask : public WorkerPool::Task {
+ public:
+  CopyFileTask(CopyJob* job, const PlannedFile& file)
+      : job_(job),
+        file_(file) {}
+
+  virtual void Run() {
+    job_->CopyFile(file_.from, file_.to, file_.mode);
+  }
+
+ private:
+  CopyJob* job_;
+  PlannedFile file_;
+};
+
+CopyJob::CopyJob(const picojson::value& msg, const std::string& from,
+                 const std::string& to, bool overwrite)
+    : FilesystemJob(msg),
+      from_(from),
+      to_(to),
+      overwrite_(overwrite),
+      planned_bytes_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+CopyJob::~CopyJob() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+void CopyJob::Execute() {
+  struct stat st;
+  if (stat(from_.c_str(), &st) < 0) {
+    Fail(NOT_FOUND_ERR);
+    return;
+  }
+
+  if (to_ == from_) {
+    Fail(INVALID_VALUES_ERR);
+    return;
+  }
+
+  if (!S_ISDIR(st.st_mode)) {
+    SetTotal(st.st_size);
+    CopyFile(from_, to_, st.st_mode & 07777);
+    return;
+  }
+
+  if (to_.compare(0, from_.size() + 1, from_ + "/") == 0) {
+    Fail(INVALID_VALUES_ERR);
+    return;
+  }
+
+  // The tree is created first, so the total is known before any file is
+  // copied, then the files are copied by the pool.
+  TreeWalker walker(pool(), this, WorkerPool::DefaultThreadCount() * 2);
+  walker.Walk(from_);
+  if (!IsCancelled()) {
+    SetTotal(planned_bytes_);
+
+    WorkerPool::TaskGroup group;
+    for (size_t i = 0; i < files_.size(); ++i)
+      pool()->Post(new CopyFileTask(this, files_[i]), &group);
+    pool()->Wait(&group);
+  }
+
+  RestoreDirectoryModes();
+}
+
+bool CopyJob::EnterDirectory(int fd, const std::string& path) {
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  // Writable by the owner until the files are copied into it, its mode is
+  // restored afterwards.
+  std::string to = DestinationFor(path);
+  mode_t mode = st.st_mode & 07777;
+  if (mkdir(to.c_str(), mode | S_IRWXU) < 0) {
+    if (errno == EEXIST && overwrite_)
+      return true;
+    Fail(IO_ERR);
+    return false;
+  }
+  if ((mode & S_IRWXU) != S_IRWXU) {
+    pthread_mutex_lock(&mutex_);
+    directory_modes_[to] = mode;
+    pthread_mutex_unlock(&mutex_);
+  }
+  return true;
+}
+
+void CopyJob::VisitEntry(int dir_fd, const char* name,
+                         const std::string& path, unsigned char type) {
+  if (type == DT_LNK) {
+    CopySymlink(path, DestinationFor(path));
+    return;
+  }
+  // Devices, FIFOs and sockets are not copied.
+  if (type != DT_REG)
+    return;
+
+  struct stat st;
+  if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+    Fail(IO_ERR);
+    return;
+  }
+
+  PlannedFile file;
+  file.from = path;
+  file.to = DestinationFor(path);
+  file.mode = st.st_mode & 07777;
+
+  pthread_mutex_lock(&mutex_);
+  files_.push_back(file);
+  planned_bytes_ += st.st_size;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void CopyJob::OnError(const std::string& path, int error) {
+  Fail(error == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+}
+
+bool CopyJob::ShouldStop() const {
+  return IsCancelled();
+}
+
+std::string CopyJob::DestinationFor(const std::string& path) const {
+  return to_ + path.substr(from_.size());
+}
+
+void CopyJob::RestoreDirectoryModes() {
+  // A path sorts after its parent, so the subdirectories go first, while
+  // their parent can still be searched.
+  for (std::map<std::string, mode_t>::reverse_iterator it =
+       directory_modes_.rbegin(); it != directory_modes_.rend(); ++it) {
+    if (chmod(it->first.c_str(), it->second) < 0)
+      Fail(IO_ERR);
+  }
+}
+
+bool CopyJob::CopySymlink(const std::string& from, const std::string& to) {
+  char target[PATH_MAX];
+  ssize_t length = readlink(from.c_str(), target, sizeof(target) - 1);
+  if (length < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+  target[length] = '\0';
+
+  if (overwrite_)
+    unlink(to.c_str());
+  if (symlink(target, to.c_str()) < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+  return true;
+}
+
+void CopyJob::CopyFile(const std::string& from, const std::string& to,
+                       mode_t mode) {
+  if (IsCancelled())
+    return;
+
+  int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    Fail(errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+    return;
+  }
+
+  int out = open(to.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC |
+                             (overwrite_ ? O_TRUNC : O_EXCL), mode);
+  if (out < 0) {
+    close(in);
+    Fail(IO_ERR);
+    return;
+  }
+
+  bool copied = CopyContents(in, out);
+  close(in);
+  if (close(out) < 0 && copied) {
+    Fail(IO_ERR);
+    copied = false;
+  }
+
+  if (!copied)
+    unlink(to.c_str());
+}
+
+bool CopyJob::CopyContents(int in, int out) {
+  struct stat st;
+  if (fstat(in, &st) < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  // Shares the extents on Btrfs and XFS, nothing is actually copied.
+  if (ioctl(out, FICLONE, in) == 0) {
+    AddProgress(st.st_size);
+    return true;
+  }
+
+  posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // Fewer blocks than the size takes: only the data is copied, and the
+  // holes are left unallocated in the copy too.
+  if (st.st_blocks * 512 < st.st_size) {
+    int method = COPY_FILE_RANGE;
+    int64_t end = CopySparse(in, out, st.st_size, &method);
+    if (end < 0 || IsCancelled())
+      return false;
+    // Else SEEK_DATA is not supported, and the file is copied whole.
+    if (end == st.st_size) {
+      // Up to a hole at the end.
+      if (ftruncate(out, st.st_size) < 0) {
+        Fail(IO_ERR);
+        return false;
+      }
+      return true;
+    }
+  }
+
+  // The blocks are reserved at once, contiguous if the filesystem can, and
+  // a full storage is found before anything is copied.
+  if (fallocate(out, FALLOC_FL_KEEP_SIZE, 0, st.st_size) < 0 &&
+      errno == ENOSPC) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  int method = COPY_FILE_RANGE;
+  return CopyRange(in, out, 0, -1, &method);
+}
+
+int64_t CopyJob::CopySparse(int in, int out, int64_t size, int* method) {
+  int64_t position = 0;
+  while (position < size && !IsCancelled()) {
+    off_t data = lseek(in, position, SEEK_DATA);
+    // Only holes up to the end.
+    if (data < 0 && errno == ENXIO)
+      data = size;
+    if (data < 0) {
+      if (position == 0 && IsUnsupported(errno))
+        return 0;
+      Fail(IO_ERR);
+      return -1;
+    }
+    off_t hole = data < size ? lseek(in, data, SEEK_HOLE) : size;
+    if (hole < 0) {
+      Fail(IO_ERR);
+      return -1;
+    }
+
+    AddProgress(data - position);
+    if (data < hole && !CopyRange(in, out, data, hole, method))
+      return -1;
+    position = hole;
+  }
+  return position;
+}
+
+bool CopyJob::CopyRange(int in, int out, int64_t start, int64_t end,
+                        int* method) {
+  if (lseek(in, start, SEEK_SET) < 0 || lseek(out, start, SEEK_SET) < 0) {
+    Fail(IO_ERR);
+    return false;
+  }
+
+  std::vector<char> buffer;
+  bool started = false;
+  int64_t position = start;
+  while (!IsCancelled()) {
+    if (end >= 0 && position >= end)
+      return true;
+
+    size_t count = end >= 0 ? std::min<int64_t>(end - position, SSIZE_MAX) :
+                              SSIZE_MAX;
+    ssize_t copied = CopyChunk(static_cast<CopyMethod>(*method), in, out,
+                               count, buffer);
+    if (copied < 0) {
+      if (errno == EINTR)
+        continue;
+      if (!started && *method != READ_WRITE && IsUnsupported(errno)) {
+        (*method)++;
+        continue;
+      }
+      Fail(IO_ERR);
+      return false;
+    }
+    // The file was truncated while copied, if a range was expected.
+    if (copied == 0)
+      return end < 0;
+
+    started = true;
+    position += copied;
+    AddProgress(copied);
+  }
+
+  return false;
+}
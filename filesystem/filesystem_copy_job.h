@@ -0,0 +1,76 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_COPY_JOB_H_
+#define FILESYSTEM_FILESYSTEM_COPY_JOB_H_
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "filesystem/filesystem_job.h"
+#include "filesystem/filesystem_tree_walker.h"
+
+// Copies a file, or a directory recursively: the tree is walked and
+// recreated in parallel, then its files are copied in parallel. File
+// contents are cloned when the filesystem supports reflinks, otherwise
+// copied in the kernel with copy_file_range() or sendfile(), and only as a
+// last resort through a large userspace buffer. Only the data of sparse
+// files is copied, so their holes stay holes, and the copy of other files
+// is preallocated.
+class CopyJob : public FilesystemJob, public TreeWalker::Visitor {
+ public:
+  CopyJob(const picojson::value& msg, const std::string& from,
+          const std::string& to, bool overwrite);
+  virtual ~CopyJob();
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+  /* TreeWalker::Visitor implementation */
+  virtual bool EnterDirectory(int fd, const std::string& path);
+  virtual void VisitEntry(int dir_fd, const char* name,
+                          const std::string& path, unsigned char type);
+  virtual void OnError(const std::string& path, int error);
+  virtual bool ShouldStop() const;
+
+ private:
+  class CopyFileTask;
+
+  struct PlannedFile {
+    std::string from;
+    std::string to;
+    mode_t mode;
+  };
+
+  std::string DestinationFor(const std::string& path) const;
+  bool CopySymlink(const std::string& from, const std::string& to);
+  void RestoreDirectoryModes();
+  void CopyFile(const std::string& from, const std::string& to, mode_t mode);
+  bool CopyContents(int in, int out);
+  // Copies the data segments of a sparse file. Returns the size if done,
+  // 0 if SEEK_DATA is not supported and -1 on failure.
+  int64_t CopySparse(int in, int out, int64_t size, int* method);
+  // Copies [start, end), or up to the end of |in| if |end| is -1, falling
+  // back from the |*method| that the files don't support.
+  bool CopyRange(int in, int out, int64_t start, int64_t end, int* method);
+
+  std::string from_;
+  std::string to_;
+  bool overwrite_;
+
+  // Filled by the tree walk.
+  pthread_mutex_t mutex_;
+  std::vector<PlannedFile> files_;
+  uint64_t planned_bytes_;
+  // The modes of the created directories that were not writable by their
+  // owner, by destination path.
+  std::map<std::string, mode_t> directory_modes_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_COPY_JOB_H_
@@ -0,0 +1,46 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_delete_job.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+DeleteDirectoryJob::DeleteDirectoryJob(const picojson::value& msg,
+                                       const std::string& path)
+    : FilesystemJob(msg),
+      path_(path) {}
+
+void DeleteDirectoryJob::Execute() {
+  TreeWalker walker(pool(), this, WorkerPool::DefaultThreadCount() * 2);
+  walker.Walk(path_);
+}
+
+void DeleteDirectoryJob::VisitEntry(int dir_fd, const char* name,
+                                    const std::string& path,
+                                    unsigned char type) {
+  if (unlinkat(dir_fd, name, 0) < 0) {
+    Fail(INVALID_VALUES_ERR);
+    return;
+  }
+  AddProgress(1);
+}
+
+// Called once the directory has been emptied.
+void DeleteDirectoryJob::LeaveDirectory(int parent_fd, const char* name,
+                                        const std::string& path) {
+  if (unlinkat(parent_fd, name, AT_REMOVEDIR) < 0) {
+    Fail(INVALID_VALUES_ERR);
+    return;
+  }
+  AddProgress(1);
+}
+
+void DeleteDirectoryJob::OnError(const std::string& path, int error) {
+  Fail(INVALID_VALUES_ERR);
+}
+
+bool DeleteDirectoryJob::ShouldStop() const {
+  return IsCancelled();
+}
@@ -0,0 +1,36 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_DELETE_JOB_H_
+#define FILESYSTEM_FILESYSTEM_DELETE_JOB_H_
+
+#include <string>
+
+#include "filesystem/filesystem_job.h"
+#include "filesystem/filesystem_tree_walker.h"
+
+// Deletes a directory and everything below it, subtrees in parallel.
+// Progress counts the removed entries, the total is not known up front and
+// reported as 0.
+class DeleteDirectoryJob : public FilesystemJob, public TreeWalker::Visitor {
+ public:
+  DeleteDirectoryJob(const picojson::value& msg, const std::string& path);
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+  /* TreeWalker::Visitor implementation */
+  virtual void VisitEntry(int dir_fd, const char* name,
+                          const std::string& path, unsigned char type);
+  virtual void LeaveDirectory(int parent_fd, const char* name,
+                              const std::string& path);
+  virtual void OnError(const std::string& path, int error);
+  virtual bool ShouldStop() const;
+
+ private:
+  std::string path_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_DELETE_JOB_H_
@@ -0,0 +1,231 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_find_job.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "filesystem/filesystem_utils.h"
+
+namespace {
+
+const char kCmdFindChunk[] = "FileFindChunk";
+
+// Sizes past 2^53 are beyond any file, and convert exactly.
+const double kMaxSize = 9007199254740992.0;
+
+double ModifiedMilliseconds(const struct stat& st) {
+  return st.st_mtim.tv_sec * 1000.0 + st.st_mtim.tv_nsec / 1000000;
+}
+
+// Converts a count of entries, 0 standing for none given. Counts past what
+// a size_t holds are as good as none, the negative, fractional and NaN
+// ones are rejected.
+bool ToCount(double value, size_t* count) {
+  if (!(value >= 0) || value != floor(value))
+    return false;
+  if (value < static_cast<double>(std::numeric_limits<size_t>::max()))
+    *count = value;
+  else
+    *count = 0;
+  return true;
+}
+
+}  // namespace
+
+FindJob::FindJob(const picojson::value& msg, const std::string& real_path,
+                 const std::string& virtual_path)
+    : FilesystemJob(msg),
+      real_path_(real_path),
+      virtual_path_(virtual_path),
+      has_regex_(false),
+      ignore_case_(false),
+      type_(TYPE_ANY),
+      min_size_(-1),
+      max_size_(-1),
+      modified_after_(-1),
+      modified_before_(-1),
+      max_depth_(-1),
+      limit_(0),
+      chunk_size_(0),
+      found_(0),
+      limit_reached_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+FindJob::~FindJob() {
+  if (has_regex_)
+    regfree(&regex_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool FindJob::ParseFilters(const picojson::value& msg) {
+  ignore_case_ = msg.get("ignoreCase").evaluate_as_boolean();
+
+  if (msg.get("name").is<std::string>())
+    glob_ = msg.get("name").get<std::string>();
+
+  if (msg.get("regex").is<std::string>()) {
+    int flags = REG_EXTENDED | REG_NOSUB | (ignore_case_ ? REG_ICASE : 0);
+    if (regcomp(&regex_, msg.get("regex").get<std::string>().c_str(), flags))
+      return false;
+    has_regex_ = true;
+  }
+
+  if (msg.get("type").is<std::string>()) {
+    std::string type = msg.get("type").get<std::string>();
+    if (type == "file")
+      type_ = TYPE_FILE;
+    else if (type == "directory")
+      type_ = TYPE_DIRECTORY;
+    else
+      return false;
+  }
+
+  // Checked as doubles, before being converted.
+  if (msg.get("minSize").is<double>()) {
+    double size = msg.get("minSize").get<double>();
+    if (!(size >= 0))
+      return false;
+    min_size_ = std::min(ceil(size), kMaxSize);
+  }
+  if (msg.get("maxSize").is<double>()) {
+    double size = msg.get("maxSize").get<double>();
+    if (!(size >= 0))
+      return false;
+    max_size_ = std::min(size, kMaxSize);
+  }
+  if (msg.get("modifiedAfter").is<double>())
+    modified_after_ = msg.get("modifiedAfter").get<double>();
+  if (msg.get("modifiedBefore").is<double>())
+    modified_before_ = msg.get("modifiedBefore").get<double>();
+
+  if (msg.get("maxDepth").is<double>()) {
+    double depth = msg.get("maxDepth").get<double>();
+    if (!(depth >= 1))
+      return false;
+    max_depth_ = depth < INT_MAX ? depth : INT_MAX;
+  }
+  if (msg.get("limit").is<double>() &&
+      !ToCount(msg.get("limit").get<double>(), &limit_))
+    return false;
+  if (msg.get("chunkSize").is<double>() &&
+      !ToCount(msg.get("chunkSize").get<double>(), &chunk_size_))
+    return false;
+
+  return true;
+}
+
+void FindJob::Execute() {
+  TreeWalker walker(pool(), this, WorkerPool::DefaultThreadCount() * 2);
+  walker.Walk(real_path_);
+
+  result()["value"] = picojson::value(picojson::array());
+  result()["value"].get<picojson::array>().swap(matches_);
+  result()["truncated"] = picojson::value(limit_reached_ != 0);
+}
+
+bool FindJob::EnterDirectory(int fd, const std::string& path) {
+  if (path.size() == real_path_.size())
+    return true;
+
+  // Directories are matched here, opened, rather than as entries.
+  int depth = Depth(path);
+  if (type_ != TYPE_FILE &&
+      MatchesName(path.c_str() + path.find_last_of('/') + 1)) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && MatchesStat(st))
+      AddMatch(path, st);
+  }
+
+  return max_depth_ < 0 || depth < max_depth_;
+}
+
+void FindJob::VisitEntry(int dir_fd, const char* name,
+                         const std::string& path, unsigned char type) {
+  if (type_ == TYPE_DIRECTORY && type != DT_LNK)
+    return;
+  if (!MatchesName(name))
+    return;
+
+  // Following symlinks, like FileStat. Entries removed meanwhile are
+  // skipped.
+  struct stat st;
+  if (fstatat(dir_fd, name, &st, 0) < 0)
+    return;
+  if (type_ == TYPE_FILE && S_ISDIR(st.st_mode))
+    return;
+  if (type_ == TYPE_DIRECTORY && !S_ISDIR(st.st_mode))
+    return;
+
+  if (MatchesStat(st))
+    AddMatch(path, st);
+}
+
+void FindJob::OnError(const std::string& path, int error) {
+  if (path.size() == real_path_.size())
+    Fail(error == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+}
+
+bool FindJob::ShouldStop() const {
+  return limit_reached_ || IsCancelled();
+}
+
+int FindJob::Depth(const std::string& path) const {
+  return std::count(path.begin() + real_path_.size(), path.end(), '/');
+}
+
+bool FindJob::MatchesName(const char* name) const {
+  if (!glob_.empty() &&
+      fnmatch(glob_.c_str(), name, ignore_case_ ? FNM_CASEFOLD : 0))
+    return false;
+  if (has_regex_ && regexec(&regex_, name, 0, NULL, 0))
+    return false;
+  return true;
+}
+
+bool FindJob::MatchesStat(const struct stat& st) const {
+  if (min_size_ >= 0 && st.st_size < min_size_)
+    return false;
+  if (max_size_ >= 0 && st.st_size > max_size_)
+    return false;
+  if (modified_after_ >= 0 && ModifiedMilliseconds(st) < modified_after_)
+    return false;
+  if (modified_before_ >= 0 && ModifiedMilliseconds(st) > modified_before_)
+    return false;
+  return true;
+}
+
+void FindJob::AddMatch(const std::string& path, const struct stat& st) {
+  picojson::object entry = filesystem::StatToJSON(st);
+  entry["fullPath"] =
+      picojson::value(virtual_path_ + path.substr(real_path_.size()));
+
+  picojson::array chunk;
+  pthread_mutex_lock(&mutex_);
+  if (limit_reached_) {
+    pthread_mutex_unlock(&mutex_);
+    return;
+  }
+  matches_.push_back(picojson::value(entry));
+  if (limit_ && ++found_ == limit_)
+    limit_reached_ = 1;
+  if (chunk_size_ && matches_.size() == chunk_size_)
+    chunk.swap(matches_);
+  pthread_mutex_unlock(&mutex_);
+
+  if (!chunk.empty()) {
+    picojson::object event;
+    event["value"] = picojson::value(picojson::array());
+    event["value"].get<picojson::array>().swap(chunk);
+    PostEvent(kCmdFindChunk, event);
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_FIND_JOB_H_
+#define FILESYSTEM_FILESYSTEM_FIND_JOB_H_
+
+#include <pthread.h>
+#include <regex.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "filesystem/filesystem_job.h"
+#include "filesystem/filesystem_tree_walker.h"
+
+// Searches the tree below a directory for the entries matching all of the
+// given filters, subtrees in parallel, so that a search is one message
+// instead of a listFiles() per directory. Matches are objects with the
+// fullPath and the FileStat attributes, in no particular order, posted in
+// FileFindChunk events of |chunkSize| if one is given, the reply holding the
+// rest. Directories that can't be read are skipped.
+//
+// Filters, all optional:
+//   name           glob matched against the entry name, with fnmatch()
+//   regex          POSIX extended regular expression, searched in the name
+//   ignoreCase     for both of the above
+//   type           "file" or "directory"
+//   minSize        in bytes, inclusive, and maxSize
+//   modifiedAfter  in ms since the epoch, inclusive, and modifiedBefore
+//   maxDepth       1 for the entries of the directory only
+//   limit          at most that many matches, the reply's truncated telling
+//                  whether the search stopped early because of it
+class FindJob : public FilesystemJob, public TreeWalker::Visitor {
+ public:
+  FindJob(const picojson::value& msg, const std::string& real_path,
+          const std::string& virtual_path);
+  virtual ~FindJob();
+
+  // Reads the filters out of |msg|. False if one is invalid.
+  bool ParseFilters(const picojson::value& msg);
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+  /* TreeWalker::Visitor implementation */
+  virtual bool EnterDirectory(int fd, const std::string& path);
+  virtual void VisitEntry(int dir_fd, const char* name,
+                          const std::string& path, unsigned char type);
+  virtual void OnError(const std::string& path, int error);
+  virtual bool ShouldStop() const;
+
+ private:
+  enum TypeFilter {
+    TYPE_ANY,
+    TYPE_FILE,
+    TYPE_DIRECTORY,
+  };
+
+  // Below the root, which is at depth 0.
+  int Depth(const std::string& path) const;
+  bool MatchesName(const char* name) const;
+  bool MatchesStat(const struct stat& st) const;
+  void AddMatch(const std::string& path, const struct stat& st);
+
+  std::string real_path_;
+  std::string virtual_path_;
+
+  std::string glob_;
+  bool has_regex_;
+  regex_t regex_;
+  bool ignore_case_;
+  TypeFilter type_;
+  int64_t min_size_;
+  int64_t max_size_;
+  double modified_after_;
+  double modified_before_;
+  int max_depth_;
+  size_t limit_;
+  size_t chunk_size_;
+
+  pthread_mutex_t mutex_;
+  picojson::array matches_;
+  size_t found_;
+  volatile int limit_reached_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_FIND_JOB_H_
@@ -0,0 +1,443 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_hash.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// The cores are built with target attributes, so the rest of the code
+// doesn't require the instructions they use.
+#define HASH_X86_CORES 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define HASH_ARM_CRC_CORE 1
+#include <arm_acle.h>
+#endif
+
+namespace {
+
+// CRC-32C (Castagnoli), reflected.
+const uint32_t kCrc32cPolynomial = 0x82f63b78;
+
+// The x86-64 core runs three independent crc32 chains over stripes of this
+// size, hiding the latency of the instruction, and merges them with
+// g_crc_shift.
+const size_t kCrcStripe = 4096;
+
+const uint32_t kSha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t kSha256Initial[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// Cores update the raw CRC register, with no inversion, and compress whole
+// 64-byte SHA-256 blocks.
+typedef uint32_t (*CrcCore)(uint32_t crc, const uint8_t* data, size_t length);
+typedef void (*ShaCore)(uint32_t state[8], const uint8_t* data,
+                        size_t blocks);
+
+pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+uint32_t g_crc_table[8][256];
+CrcCore g_crc_core = NULL;
+const char* g_crc_name = NULL;
+ShaCore g_sha_core = NULL;
+const char* g_sha_name = NULL;
+
+uint32_t LoadBigEndian32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) |
+         p[3];
+}
+
+void StoreBigEndian32(uint32_t value, uint8_t* p) {
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+// Slicing-by-8, eight bytes per step through eight tables.
+uint32_t Crc32cTable(uint32_t crc, const uint8_t* data, size_t length) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; length >= 8; data += 8, length -= 8) {
+    uint32_t lo, hi;
+    memcpy(&lo, data, 4);
+    memcpy(&hi, data + 4, 4);
+    lo ^= crc;
+    crc = g_crc_table[7][lo & 0xff] ^ g_crc_table[6][(lo >> 8) & 0xff] ^
+          g_crc_table[5][(lo >> 16) & 0xff] ^ g_crc_table[4][lo >> 24] ^
+          g_crc_table[3][hi & 0xff] ^ g_crc_table[2][(hi >> 8) & 0xff] ^
+          g_crc_table[1][(hi >> 16) & 0xff] ^ g_crc_table[0][hi >> 24];
+  }
+#endif
+  for (; length > 0; ++data, --length)
+    crc = g_crc_table[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+uint32_t RotateRight(uint32_t value, int bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+void Sha256Portable(uint32_t state[8], const uint8_t* data, size_t blocks) {
+  uint32_t w[64];
+  for (; blocks > 0; --blocks, data += 64) {
+    for (int i = 0; i < 16; ++i)
+      w[i] = LoadBigEndian32(data + 4 * i);
+    for (int i = 16; i < 64; ++i) {
+      uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^
+                    (w[i - 15] >> 3);
+      uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^
+                    (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+      uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^
+                    RotateRight(e, 25);
+      uint32_t t1 = h + s1 + ((e & f) ^ (~e & g)) + kSha256K[i] + w[i];
+      uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^
+                    RotateRight(a, 22);
+      uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#if defined(HASH_X86_CORES)
+
+#if defined(__x86_64__)
+// Maps the CRC register of a stripe to its value after kCrcStripe more zero
+// bytes, one table per byte of the register.
+uint32_t g_crc_shift[4][256];
+
+uint32_t ShiftStripe(uint32_t crc) {
+  return g_crc_shift[0][crc & 0xff] ^ g_crc_shift[1][(crc >> 8) & 0xff] ^
+         g_crc_shift[2][(crc >> 16) & 0xff] ^ g_crc_shift[3][crc >> 24];
+}
+
+void InitCrcShift() {
+  // The shift is linear: tabulate it from its value on each bit.
+  uint32_t basis[32];
+  uint8_t zeros[kCrcStripe] = { 0 };
+  for (int bit = 0; bit < 32; ++bit)
+    basis[bit] = Crc32cTable(1u << bit, zeros, kCrcStripe);
+
+  for (int byte = 0; byte < 4; ++byte) {
+    for (int value = 0; value < 256; ++value) {
+      uint32_t shifted = 0;
+      for (int bit = 0; bit < 8; ++bit) {
+        if (value & (1 << bit))
+          shifted ^= basis[byte * 8 + bit];
+      }
+      g_crc_shift[byte][value] = shifted;
+    }
+  }
+}
+#endif  // defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+uint32_t Crc32cSSE42(uint32_t crc, const uint8_t* data, size_t length) {
+#if defined(__x86_64__)
+  while (length >= 3 * kCrcStripe) {
+    uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+    for (size_t i = 0; i < kCrcStripe; i += 8) {
+      uint64_t word0, word1, word2;
+      memcpy(&word0, data + i, 8);
+      memcpy(&word1, data + kCrcStripe + i, 8);
+      memcpy(&word2, data + 2 * kCrcStripe + i, 8);
+      crc0 = _mm_crc32_u64(crc0, word0);
+      crc1 = _mm_crc32_u64(crc1, word1);
+      crc2 = _mm_crc32_u64(crc2, word2);
+    }
+    crc = ShiftStripe(ShiftStripe(crc0) ^ crc1) ^ crc2;
+    data += 3 * kCrcStripe;
+    length -= 3 * kCrcStripe;
+  }
+
+  uint64_t crc64 = crc;
+  for (; length >= 8; data += 8, length -= 8) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = crc64;
+#else
+  for (; length >= 4; data += 4, length -= 4) {
+    uint32_t word;
+    memcpy(&word, data, 4);
+    crc = _mm_crc32_u32(crc, word);
+  }
+#endif
+  for (; length > 0; ++data, --length)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+
+// Two rounds per sha256rnds2, with the state split as ABEF and CDGH, and the
+// message schedule four words at a time with sha256msg1/sha256msg2.
+__attribute__((target("sha,sse4.1")))
+void Sha256SHANI(uint32_t state[8], const uint8_t* data, size_t blocks) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+  __m128i hgfe =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+  __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+  __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+  __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+  __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+  for (; blocks > 0; --blocks, data += 64) {
+    __m128i abef_saved = abef;
+    __m128i cdgh_saved = cdgh;
+
+    __m128i w[4];
+    for (int i = 0; i < 4; ++i) {
+      w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)),
+          kByteSwap);
+    }
+
+    // w[i % 4] holds words 4i to 4i + 3 of the schedule.
+    for (int i = 0; i < 16; ++i) {
+      __m128i wk = _mm_add_epi32(
+          w[i & 3],
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(kSha256K + 4 * i)));
+      cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+      abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+
+      if (i < 12) {
+        __m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+        next = _mm_add_epi32(next,
+                             _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+        w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+      }
+    }
+
+    abef = _mm_add_epi32(abef, abef_saved);
+    cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+  }
+
+  __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+  __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+                   _mm_blend_epi16(feba, dchg, 0xf0));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4),
+                   _mm_alignr_epi8(dchg, feba, 8));
+}
+
+bool CPUHasSSE42() {
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  return ecx & bit_SSE4_2;
+}
+
+bool CPUHasSHA() {
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+    return false;
+  if (__get_cpuid_max(0, NULL) < 7)
+    return false;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return ebx & (1 << 29);
+}
+
+#endif  // defined(HASH_X86_CORES)
+
+#if defined(HASH_ARM_CRC_CORE)
+
+uint32_t Crc32cARMv8(uint32_t crc, const uint8_t* data, size_t length) {
+  for (; length >= 8; data += 8, length -= 8) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+    crc = __crc32cd(crc, word);
+  }
+  for (; length > 0; ++data, --length)
+    crc = __crc32cb(crc, *data);
+  return crc;
+}
+
+#endif  // defined(HASH_ARM_CRC_CORE)
+
+void Init() {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc >> 1) ^ (crc & 1 ? kCrc32cPolynomial : 0);
+    g_crc_table[0][i] = crc;
+  }
+  for (int k = 1; k < 8; ++k) {
+    for (int i = 0; i < 256; ++i) {
+      uint32_t crc = g_crc_table[k - 1][i];
+      g_crc_table[k][i] = (crc >> 8) ^ g_crc_table[0][crc & 0xff];
+    }
+  }
+
+  g_crc_core = Crc32cTable;
+  g_crc_name = "table";
+  g_sha_core = Sha256Portable;
+  g_sha_name = "portable";
+
+#if defined(HASH_X86_CORES)
+  if (CPUHasSSE42()) {
+#if defined(__x86_64__)
+    InitCrcShift();
+#endif
+    g_crc_core = Crc32cSSE42;
+    g_crc_name = "sse4.2";
+  }
+  if (CPUHasSHA()) {
+    g_sha_core = Sha256SHANI;
+    g_sha_name = "sha-ni";
+  }
+#endif
+#if defined(HASH_ARM_CRC_CORE)
+  g_crc_core = Crc32cARMv8;
+  g_crc_name = "armv8-crc";
+#endif
+}
+
+std::string ToHex(const uint8_t* digest, size_t length) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex(2 * length, '0');
+  for (size_t i = 0; i < length; ++i) {
+    hex[2 * i] = kDigits[digest[i] >> 4];
+    hex[2 * i + 1] = kDigits[digest[i] & 0xf];
+  }
+  return hex;
+}
+
+class Crc32cHasher : public Hasher {
+ public:
+  Crc32cHasher() : crc_(0xffffffff) {}
+
+  virtual void Update(const uint8_t* data, size_t length) {
+    crc_ = g_crc_core(crc_, data, length);
+  }
+
+  virtual std::string Finish() {
+    uint8_t digest[4];
+    StoreBigEndian32(~crc_, digest);
+    return ToHex(digest, sizeof(digest));
+  }
+
+  virtual const char* Implementation() const { return g_crc_name; }
+
+ private:
+  uint32_t crc_;
+};
+
+class Sha256Hasher : public Hasher {
+ public:
+  Sha256Hasher() : buffered_(0), length_(0) {
+    memcpy(state_, kSha256Initial, sizeof(state_));
+  }
+
+  virtual void Update(const uint8_t* data, size_t length) {
+    length_ += length;
+
+    if (buffered_) {
+      size_t count = std::min(length, sizeof(buffer_) - buffered_);
+      memcpy(buffer_ + buffered_, data, count);
+      buffered_ += count;
+      data += count;
+      length -= count;
+      if (buffered_ < sizeof(buffer_))
+        return;
+      g_sha_core(state_, buffer_, 1);
+      buffered_ = 0;
+    }
+
+    // Whole blocks straight from the input.
+    size_t blocks = length / 64;
+    if (blocks) {
+      g_sha_core(state_, data, blocks);
+      data += blocks * 64;
+      length -= blocks * 64;
+    }
+
+    memcpy(buffer_, data, length);
+    buffered_ = length;
+  }
+
+  virtual std::string Finish() {
+    uint64_t bits = length_ * 8;
+
+    // 0x80, zeros up to 56 mod 64, then the length in bits.
+    uint8_t padding[72] = { 0x80 };
+    size_t count = (buffered_ < 56 ? 56 : 120) - buffered_;
+    for (int i = 0; i < 8; ++i)
+      padding[count + i] = bits >> (56 - 8 * i);
+    Update(padding, count + 8);
+
+    uint8_t digest[32];
+    for (int i = 0; i < 8; ++i)
+      StoreBigEndian32(state_[i], digest + 4 * i);
+    return ToHex(digest, sizeof(digest));
+  }
+
+  virtual const char* Implementation() const { return g_sha_name; }
+
+ private:
+  uint32_t state_[8];
+  uint8_t buffer_[64];
+  size_t buffered_;
+  uint64_t length_;
+};
+
+}  // namespace
+
+Hasher* Hasher::Create(const std::string& algorithm) {
+  pthread_once(&g_init_once, Init);
+
+  if (algorithm == "crc32c")
+    return new Crc32cHasher;
+  if (algorithm == "sha256")
+    return new Sha256Hasher;
+  return NULL;
+}
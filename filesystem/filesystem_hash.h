@@ -0,0 +1,40 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_HASH_H_
+#define FILESYSTEM_FILESYSTEM_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "common/utils.h"
+
+// An incremental digest of a byte stream. The core of each algorithm is
+// picked at runtime for the CPU: the SSE 4.2 crc32 instruction and the SHA
+// extensions on x86, the ARMv8 CRC instructions on ARM builds that enable
+// them, and portable table-driven code otherwise.
+class Hasher {
+ public:
+  // "crc32c" or "sha256", NULL for other algorithms.
+  static Hasher* Create(const std::string& algorithm);
+  virtual ~Hasher() {}
+
+  virtual void Update(const uint8_t* data, size_t length) = 0;
+  // The digest in lowercase hex, the CRC as a big-endian 32-bit value. The
+  // hasher can't be updated afterwards.
+  virtual std::string Finish() = 0;
+
+  // The name of the core in use, for benchmarks and logs.
+  virtual const char* Implementation() const = 0;
+
+ protected:
+  Hasher() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Hasher);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_HASH_H_
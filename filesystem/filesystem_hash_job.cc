@@ -0,0 +1,65 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_hash_job.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace {
+
+// Large enough to amortize the system calls, small enough to stay in the
+// cache between the read and the hashing, and for timely cancellation.
+const size_t kReadSize = 256 * 1024;
+
+}  // namespace
+
+HashJob::HashJob(const picojson::value& msg, const std::string& path,
+                 Hasher* hasher)
+    : FilesystemJob(msg),
+      path_(path),
+      hasher_(hasher) {}
+
+HashJob::~HashJob() {
+  delete hasher_;
+}
+
+void HashJob::Execute() {
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    Fail(errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    Fail(IO_ERR);
+    return;
+  }
+  SetTotal(st.st_size);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  std::vector<uint8_t> buffer(kReadSize);
+  while (!IsCancelled()) {
+    ssize_t read_bytes = read(fd, &buffer[0], buffer.size());
+    if (read_bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      Fail(IO_ERR);
+      break;
+    }
+    if (read_bytes == 0) {
+      result()["value"] = picojson::value(hasher_->Finish());
+      break;
+    }
+    hasher_->Update(&buffer[0], read_bytes);
+    AddProgress(read_bytes);
+  }
+  close(fd);
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_HASH_JOB_H_
+#define FILESYSTEM_FILESYSTEM_HASH_JOB_H_
+
+#include <string>
+
+#include "filesystem/filesystem_hash.h"
+#include "filesystem/filesystem_job.h"
+
+// Hashes a file natively, streaming it through |hasher| in large reads, and
+// replies with the hex digest. Progress is in bytes.
+class HashJob : public FilesystemJob {
+ public:
+  // Takes ownership of |hasher|.
+  HashJob(const picojson::value& msg, const std::string& path,
+          Hasher* hasher);
+  virtual ~HashJob();
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+ private:
+  std::string path_;
+  Hasher* hasher_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_HASH_JOB_H_
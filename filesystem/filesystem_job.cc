@@ -0,0 +1,158 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_job.h"
+
+#include <time.h>
+
+namespace {
+
+const char kCmdJobProgress[] = "FileJobProgress";
+const int64_t kProgressInterval = 100;  // ms
+
+int64_t NowMilliseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+}  // namespace
+
+FilesystemJob::FilesystemJob(const picojson::value& msg)
+    : jobs_(NULL),
+      parent_(NULL),
+      id_(msg.get("reply_id").get<double>()),
+      cancelled_(0),
+      error_(NO_ERROR),
+      total_(0),
+      processed_(0),
+      last_progress_time_(0) {}
+
+void FilesystemJob::Cancel() {
+  __sync_lock_test_and_set(&cancelled_, 1);
+}
+
+bool FilesystemJob::IsCancelled() const {
+  return cancelled_ || (parent_ && parent_->IsCancelled());
+}
+
+void FilesystemJob::Run() {
+  Execute();
+  jobs_->Finish(this);
+
+  picojson::object reply;
+  int error = error_;
+  if (error == NO_ERROR && IsCancelled())
+    error = ABORT_ERR;
+
+  if (error != NO_ERROR) {
+    reply["isError"] = picojson::value(true);
+    reply["errorCode"] = picojson::value(static_cast<double>(error));
+  } else {
+    reply = result_;
+    reply["isError"] = picojson::value(false);
+  }
+  reply["reply_id"] = picojson::value(id_);
+
+  jobs_->PostMessage(picojson::value(reply));
+}
+
+void FilesystemJob::Fail(WebApiAPIErrors error) {
+  __sync_bool_compare_and_swap(&error_, NO_ERROR, error);
+  Cancel();
+}
+
+void FilesystemJob::SetTotal(uint64_t total) {
+  total_ = total;
+}
+
+void FilesystemJob::AddProgress(uint64_t processed) {
+  uint64_t done = __sync_add_and_fetch(&processed_, processed);
+
+  int64_t last = last_progress_time_;
+  int64_t now = NowMilliseconds();
+  if (now - last < kProgressInterval)
+    return;
+  // Only one of the threads working for the job posts.
+  if (!__sync_bool_compare_and_swap(&last_progress_time_, last, now))
+    return;
+
+  picojson::object progress;
+  progress["processed"] = picojson::value(static_cast<double>(done));
+  progress["total"] = picojson::value(static_cast<double>(total_));
+  PostEvent(kCmdJobProgress, progress);
+}
+
+void FilesystemJob::PostEvent(const char* cmd, picojson::object& event) {
+  if (parent_)
+    return;
+
+  event["cmd"] = picojson::value(cmd);
+  event["reply_id"] = picojson::value(id_);
+  jobs_->PostMessage(picojson::value(event));
+}
+
+WorkerPool* FilesystemJob::pool() const {
+  return jobs_->pool();
+}
+
+WebApiAPIErrors FilesystemJob::RunChild(FilesystemJob* child) {
+  child->jobs_ = jobs_;
+  child->parent_ = this;
+  child->Execute();
+
+  if (child->error_ != NO_ERROR)
+    return static_cast<WebApiAPIErrors>(child->error_);
+  return child->IsCancelled() ? ABORT_ERR : NO_ERROR;
+}
+
+FilesystemJobs::FilesystemJobs(ContextAPI* api)
+    : api_(api),
+      shutting_down_(false),
+      pool_(new WorkerPool(WorkerPool::DefaultThreadCount())) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+FilesystemJobs::~FilesystemJobs() {
+  pthread_mutex_lock(&mutex_);
+  shutting_down_ = true;
+  std::map<double, FilesystemJob*>::iterator it;
+  for (it = jobs_.begin(); it != jobs_.end(); ++it)
+    it->second->Cancel();
+  pthread_mutex_unlock(&mutex_);
+
+  // Joins the workers once the cancelled jobs are done.
+  delete pool_;
+  pthread_mutex_destroy(&mutex_);
+}
+
+void FilesystemJobs::Start(FilesystemJob* job) {
+  pthread_mutex_lock(&mutex_);
+  job->jobs_ = this;
+  jobs_[job->id()] = job;
+  pthread_mutex_unlock(&mutex_);
+
+  pool_->Post(job);
+}
+
+void FilesystemJobs::Cancel(double id) {
+  pthread_mutex_lock(&mutex_);
+  std::map<double, FilesystemJob*>::iterator it = jobs_.find(id);
+  if (it != jobs_.end())
+    it->second->Cancel();
+  pthread_mutex_unlock(&mutex_);
+}
+
+void FilesystemJobs::Finish(FilesystemJob* job) {
+  pthread_mutex_lock(&mutex_);
+  jobs_.erase(job->id());
+  pthread_mutex_unlock(&mutex_);
+}
+
+void FilesystemJobs::PostMessage(const picojson::value& message) {
+  pthread_mutex_lock(&mutex_);
+  if (!shutting_down_)
+    api_->PostMessage(message.serialize().c_str());
+  pthread_mutex_unlock(&mutex_);
+}
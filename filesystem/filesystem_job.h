@@ -0,0 +1,109 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_JOB_H_
+#define FILESYSTEM_FILESYSTEM_JOB_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <map>
+
+#include "common/extension_adapter.h"
+#include "common/picojson.h"
+#include "common/utils.h"
+#include "filesystem/filesystem_worker_pool.h"
+#include "tizen/tizen.h"
+
+class FilesystemJobs;
+
+// An asynchronous filesystem operation, run on the worker pool. It is
+// identified by the reply_id of the message that started it, which its
+// progress events and final reply carry. A cancelled job replies ABORT_ERR.
+class FilesystemJob : public WorkerPool::Task {
+ public:
+  explicit FilesystemJob(const picojson::value& msg);
+  virtual ~FilesystemJob() {}
+
+  double id() const { return id_; }
+
+  // Can be called from any thread.
+  void Cancel();
+  bool IsCancelled() const;
+
+  /* WorkerPool::Task implementation */
+  virtual void Run();
+
+ protected:
+  // Does the work of the job, returning early when IsCancelled().
+  virtual void Execute() = 0;
+
+  // Keeps the first error, the one the job replies with, and cancels the
+  // rest of the work.
+  void Fail(WebApiAPIErrors error);
+
+  // Progress is reported as processed out of total units, bytes for most
+  // jobs, and throttled to one event per kProgressInterval.
+  void SetTotal(uint64_t total);
+  void AddProgress(uint64_t processed);
+
+  // Posts an event for the job to JavaScript, |event| gets the reply_id.
+  void PostEvent(const char* cmd, picojson::object& event);
+
+  WorkerPool* pool() const;
+
+  // Runs |child| to completion on the calling thread as a part of this job:
+  // it stops when this job is cancelled, reports no progress and doesn't
+  // reply. Returns the error it failed with, or NO_ERROR.
+  WebApiAPIErrors RunChild(FilesystemJob* child);
+
+  // Added to the success reply.
+  picojson::object& result() { return result_; }
+
+ private:
+  friend class FilesystemJobs;
+
+  FilesystemJobs* jobs_;
+  FilesystemJob* parent_;
+  double id_;
+  volatile int cancelled_;
+  volatile int error_;
+  volatile uint64_t total_;
+  volatile uint64_t processed_;
+  volatile int64_t last_progress_time_;
+  picojson::object result_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilesystemJob);
+};
+
+// Runs the jobs of one FilesystemContext, and lets them post to it from the
+// worker threads.
+class FilesystemJobs {
+ public:
+  explicit FilesystemJobs(ContextAPI* api);
+  // Cancels the running jobs and waits for them, dropping their replies.
+  ~FilesystemJobs();
+
+  // Takes ownership of |job|.
+  void Start(FilesystemJob* job);
+  void Cancel(double id);
+
+  WorkerPool* pool() const { return pool_; }
+
+ private:
+  friend class FilesystemJob;
+
+  void Finish(FilesystemJob* job);
+  void PostMessage(const picojson::value& message);
+
+  ContextAPI* api_;
+  pthread_mutex_t mutex_;
+  std::map<double, FilesystemJob*> jobs_;
+  bool shutting_down_;
+  WorkerPool* pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilesystemJobs);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_JOB_H_
@@ -0,0 +1,92 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_list_job.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "filesystem/filesystem_tree_walker.h"
+#include "filesystem/filesystem_utils.h"
+
+namespace {
+
+const char kCmdListFilesChunk[] = "FileListFilesChunk";
+
+}  // namespace
+
+ListFilesJob::ListFilesJob(const picojson::value& msg,
+                           const std::string& real_path,
+                           const std::string& virtual_path, bool with_stat,
+                           size_t offset, size_t limit, size_t chunk_size)
+    : FilesystemJob(msg),
+      real_path_(real_path),
+      virtual_path_(virtual_path),
+      with_stat_(with_stat),
+      offset_(offset),
+      limit_(limit),
+      chunk_size_(chunk_size) {}
+
+void ListFilesJob::Execute() {
+  int fd = open(real_path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    Fail(IO_ERR);
+    return;
+  }
+
+  DirectoryReader reader(fd);
+  picojson::array entries;
+  size_t index = 0;
+  size_t listed = 0;
+  const char* name;
+  unsigned char type;
+
+  while (!IsCancelled() && (!limit_ || listed < limit_)) {
+    if (!reader.Next(&name, &type)) {
+      if (errno)
+        Fail(IO_ERR);
+      break;
+    }
+    if (index++ < offset_)
+      continue;
+
+    listed++;
+    entries.push_back(EntryToJSON(fd, name, type));
+
+    if (chunk_size_ && entries.size() == chunk_size_) {
+      picojson::object chunk;
+      chunk["value"] = picojson::value(picojson::array());
+      chunk["value"].get<picojson::array>().swap(entries);
+      PostEvent(kCmdListFilesChunk, chunk);
+    }
+  }
+  close(fd);
+
+  result()["value"] = picojson::value(picojson::array());
+  result()["value"].get<picojson::array>().swap(entries);
+}
+
+picojson::value ListFilesJob::EntryToJSON(int dir_fd, const char* name,
+                                          unsigned char type) const {
+  std::string path = virtual_path_ + "/" + name;
+  if (!with_stat_)
+    return picojson::value(path);
+
+  // Relative to the directory, so the path is not resolved again, and
+  // following symlinks like FileStat.
+  picojson::object entry;
+  struct stat st;
+  if (fstatat(dir_fd, name, &st, 0) == 0) {
+    entry = filesystem::StatToJSON(st);
+  } else {
+    entry["isFile"] = picojson::value(type == DT_REG);
+    entry["isDirectory"] = picojson::value(type == DT_DIR);
+  }
+  entry["fullPath"] = picojson::value(path);
+
+  return picojson::value(entry);
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_LIST_JOB_H_
+#define FILESYSTEM_FILESYSTEM_LIST_JOB_H_
+
+#include <string>
+
+#include "filesystem/filesystem_job.h"
+
+// Lists a directory, or the page of it given by |offset| and |limit| (0 for
+// no limit). Entries are virtual paths, or with |with_stat| objects with the
+// fullPath and the FileStat attributes of each file, so no FileStat round
+// trip is needed per entry. With a |chunk_size|, entries are posted in
+// FileListFilesChunk events of that many, the reply holding the rest.
+class ListFilesJob : public FilesystemJob {
+ public:
+  ListFilesJob(const picojson::value& msg, const std::string& real_path,
+               const std::string& virtual_path, bool with_stat,
+               size_t offset, size_t limit, size_t chunk_size);
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+ private:
+  picojson::value EntryToJSON(int dir_fd, const char* name,
+                              unsigned char type) const;
+
+  std::string real_path_;
+  std::string virtual_path_;
+  bool with_stat_;
+  size_t offset_;
+  size_t limit_;
+  size_t chunk_size_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_LIST_JOB_H_
@@ -0,0 +1,117 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_root_table.h"
+
+#include <string.h>
+
+namespace {
+
+// Seeds tried per table size before doubling it.
+const uint32_t kSeedsPerSize = 256;
+
+bool HasParentComponent(const char* path, size_t length) {
+  const char* end = path + length;
+  while (path < end) {
+    const char* slash = static_cast<const char*>(memchr(path, '/', end - path));
+    const char* component_end = slash ? slash : end;
+    if (component_end - path == 2 && path[0] == '.' && path[1] == '.')
+      return true;
+    path = component_end + 1;
+  }
+  return false;
+}
+
+}  // namespace
+
+VirtualRootTable::VirtualRootTable()
+    : slots_(1, -1),
+      seed_(0) {}
+
+bool VirtualRootTable::Add(const std::string& label,
+                           const std::string& real_path) {
+  if (Find(label.data(), label.size()) >= 0)
+    return false;
+
+  Root root;
+  root.label = label;
+  root.real_path = real_path;
+  roots_.push_back(root);
+  Rebuild();
+  return true;
+}
+
+void VirtualRootTable::Clear() {
+  roots_.clear();
+  slots_.assign(1, -1);
+  seed_ = 0;
+}
+
+std::string VirtualRootTable::Resolve(const std::string& virtual_path) const {
+  const char* path = virtual_path.data();
+  size_t length = virtual_path.size();
+  const char* slash = static_cast<const char*>(memchr(path, '/', length));
+  size_t label_length = slash ? slash - path : length;
+
+  int index = Find(path, label_length);
+  if (index < 0)
+    return std::string();
+  if (HasParentComponent(path + label_length, length - label_length))
+    return std::string();
+
+  const std::string& real_path = roots_[index].real_path;
+  std::string resolved;
+  resolved.reserve(real_path.size() + length - label_length);
+  resolved.append(real_path);
+  resolved.append(path + label_length, length - label_length);
+  return resolved;
+}
+
+// FNV-1a, with the seed mixed into the offset basis.
+uint32_t VirtualRootTable::Hash(const char* data, size_t length,
+                                uint32_t seed) {
+  uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int VirtualRootTable::Find(const char* label, size_t length) const {
+  uint32_t slot = Hash(label, length, seed_) & (slots_.size() - 1);
+  int index = slots_[slot];
+  if (index < 0)
+    return -1;
+
+  const std::string& candidate = roots_[index].label;
+  if (candidate.size() != length ||
+      memcmp(candidate.data(), label, length) != 0)
+    return -1;
+  return index;
+}
+
+void VirtualRootTable::Rebuild() {
+  size_t size = 1;
+  while (size < 2 * roots_.size())
+    size *= 2;
+
+  for (;; size *= 2) {
+    for (uint32_t seed = 0; seed < kSeedsPerSize; ++seed) {
+      std::vector<int> slots(size, -1);
+      bool collided = false;
+      for (size_t i = 0; i < roots_.size() && !collided; ++i) {
+        const std::string& label = roots_[i].label;
+        uint32_t slot = Hash(label.data(), label.size(), seed) & (size - 1);
+        collided = slots[slot] >= 0;
+        slots[slot] = i;
+      }
+      if (!collided) {
+        slots_.swap(slots);
+        seed_ = seed;
+        return;
+      }
+    }
+  }
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_ROOT_TABLE_H_
+#define FILESYSTEM_FILESYSTEM_ROOT_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Maps the root of virtual paths, "documents" in "documents/a.txt", to the
+// real path of its storage. The labels are few and rarely added, so the
+// table is rebuilt on each addition with a perfect hash: a lookup hashes
+// the root in place, without copying it, and compares one label.
+class VirtualRootTable {
+ public:
+  VirtualRootTable();
+
+  // Returns false, keeping the current mapping, if |label| is known.
+  bool Add(const std::string& label, const std::string& real_path);
+  // Removes every root, for the table to be filled again.
+  void Clear();
+
+  // The real path for |virtual_path|, or an empty string if its root is
+  // unknown or one of its components is "..".
+  std::string Resolve(const std::string& virtual_path) const;
+
+ private:
+  struct Root {
+    std::string label;
+    std::string real_path;
+  };
+
+  static uint32_t Hash(const char* data, size_t length, uint32_t seed);
+  // -1 if |label| is not in the table.
+  int Find(const char* label, size_t length) const;
+  void Rebuild();
+
+  std::vector<Root> roots_;
+  // Indices in |roots_|, -1 for empty slots.
+  std::vector<int> slots_;
+  uint32_t seed_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_ROOT_TABLE_H_
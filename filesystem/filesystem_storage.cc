@@ -0,0 +1,194 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_storage.h"
+
+namespace {
+
+// Long enough for the partitions of a card to be mounted together.
+const guint kCoalesceInterval = 250;  // ms
+
+const char kStorageTypeInternal[] = "INTERNAL";
+const char kStorageTypeExternal[] = "EXTERNAL";
+const char kStorageStateMounted[] = "MOUNTED";
+const char kStorageStateRemoved[] = "REMOVED";
+const char kStorageStateUnmountable[] = "UNMOUNTABLE";
+
+const char* TypeName(int type) {
+  return type == StorageManager::TYPE_INTERNAL ? kStorageTypeInternal :
+      kStorageTypeExternal;
+}
+
+const char* StateName(int state) {
+  switch (state) {
+  case StorageManager::STATE_MOUNTED:
+  case StorageManager::STATE_MOUNTED_READONLY:
+    return kStorageStateMounted;
+  case StorageManager::STATE_REMOVED:
+    return kStorageStateRemoved;
+  default:
+    return kStorageStateUnmountable;
+  }
+}
+
+bool IsMounted(int state) {
+  return state == StorageManager::STATE_MOUNTED ||
+         state == StorageManager::STATE_MOUNTED_READONLY;
+}
+
+}  // namespace
+
+StorageManager::StorageManager(ContextAPI* api)
+    :
+#if defined(GENERIC_DESKTOP)
+      udev_(NULL),
+      monitor_(NULL),
+      monitor_watch_id_(0),
+      mounts_fd_(-1),
+      mounts_watch_id_(0),
+#endif
+      api_(api),
+      generation_(0),
+      timeout_id_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+StorageManager::~StorageManager() {
+  pthread_mutex_lock(&mutex_);
+  StopBackend();
+  if (timeout_id_)
+    g_source_remove(timeout_id_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void StorageManager::AddInternal(const std::string& label,
+                                 const std::string& path) {
+  pthread_mutex_lock(&mutex_);
+  UpdateLocked(label, path, TYPE_INTERNAL, STATE_MOUNTED);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void StorageManager::Start() {
+  pthread_mutex_lock(&mutex_);
+  StartBackend();
+  // The storages found first are not changes.
+  for (std::map<std::string, Storage>::iterator it = storages_.begin();
+       it != storages_.end(); ++it)
+    it->second.posted_state = StateName(it->second.state);
+  if (timeout_id_) {
+    g_source_remove(timeout_id_);
+    timeout_id_ = 0;
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+picojson::value StorageManager::List() {
+  pthread_mutex_lock(&mutex_);
+  if (!list_.is<picojson::array>()) {
+    picojson::array storages;
+    for (std::map<std::string, Storage>::const_iterator it = storages_.begin();
+         it != storages_.end(); ++it)
+      storages.push_back(it->second.json);
+    list_ = picojson::value(storages);
+  }
+  picojson::value list = list_;
+  pthread_mutex_unlock(&mutex_);
+  return list;
+}
+
+bool StorageManager::Get(const std::string& label, picojson::value* storage) {
+  pthread_mutex_lock(&mutex_);
+  std::map<std::string, Storage>::const_iterator it = storages_.find(label);
+  bool found = it != storages_.end();
+  if (found)
+    *storage = it->second.json;
+  pthread_mutex_unlock(&mutex_);
+  return found;
+}
+
+void StorageManager::UpdateRoots(VirtualRootTable* roots,
+                                 unsigned int* generation) {
+  if (__sync_fetch_and_add(&generation_, 0) == *generation)
+    return;
+
+  // Rebuilt, for the storages moved or unmounted to be dropped: the paths
+  // of those would be on the filesystem below their mount point.
+  pthread_mutex_lock(&mutex_);
+  roots->Clear();
+  for (std::map<std::string, Storage>::const_iterator it = storages_.begin();
+       it != storages_.end(); ++it) {
+    if (!it->second.path.empty() && IsMounted(it->second.state))
+      roots->Add(it->first, it->second.path);
+  }
+  *generation = generation_;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void StorageManager::UpdateLocked(const std::string& label,
+                                  const std::string& path, int type,
+                                  int state) {
+  std::map<std::string, Storage>::iterator it = storages_.find(label);
+  if (it == storages_.end()) {
+    Storage storage;
+    storage.type = type;
+    storage.state = STATE_REMOVED;
+    it = storages_.insert(std::make_pair(label, storage)).first;
+    it->second.posted_state = StateName(STATE_REMOVED);
+  }
+
+  Storage& storage = it->second;
+  if (!path.empty() && path != storage.path) {
+    storage.path = path;
+    __sync_fetch_and_add(&generation_, 1);
+  }
+  if (storage.json.is<picojson::object>() && storage.state == state)
+    return;
+
+  if (IsMounted(state) != IsMounted(storage.state))
+    __sync_fetch_and_add(&generation_, 1);
+  storage.state = state;
+  picojson::object json;
+  json["label"] = picojson::value(label);
+  json["type"] = picojson::value(TypeName(storage.type));
+  json["state"] = picojson::value(StateName(state));
+  storage.json = picojson::value(json);
+  list_ = picojson::value();
+
+  if (!timeout_id_)
+    timeout_id_ = g_timeout_add(kCoalesceInterval, OnCoalesceTimeout, this);
+}
+
+void StorageManager::FlushChangesLocked() {
+  // Only what differs from the last message: a card removed and inserted
+  // back within the interval is no change.
+  picojson::array changes;
+  for (std::map<std::string, Storage>::iterator it = storages_.begin();
+       it != storages_.end(); ++it) {
+    Storage& storage = it->second;
+    std::string state = StateName(storage.state);
+    if (state == storage.posted_state)
+      continue;
+    storage.posted_state = state;
+    changes.push_back(storage.json);
+  }
+  if (changes.empty())
+    return;
+
+  picojson::object message;
+  message["cmd"] = picojson::value("storagesChanged");
+  message["storages"] = picojson::value(changes);
+  api_->PostMessage(picojson::value(message).serialize().c_str());
+}
+
+gboolean StorageManager::OnCoalesceTimeout(gpointer user_data) {
+  StorageManager* manager = static_cast<StorageManager*>(user_data);
+
+  pthread_mutex_lock(&manager->mutex_);
+  manager->timeout_id_ = 0;
+  manager->FlushChangesLocked();
+  pthread_mutex_unlock(&manager->mutex_);
+
+  return FALSE;
+}
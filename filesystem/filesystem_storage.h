@@ -0,0 +1,124 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_STORAGE_H_
+#define FILESYSTEM_FILESYSTEM_STORAGE_H_
+
+#include <glib.h>
+#include <pthread.h>
+
+#if defined(GENERIC_DESKTOP)
+#include <libudev.h>
+#elif defined(TIZEN)
+#include <app_storage.h>
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/extension_adapter.h"
+#include "common/picojson.h"
+#include "common/utils.h"
+#include "filesystem/filesystem_root_table.h"
+
+// The storages listed by FileSystemManager: the internal directories, always
+// mounted, and the devices of the platform, from the Tizen storage API or,
+// on the desktop, from udev block events and the mount table. Each storage
+// keeps its JSON form, so listing them is a memory read.
+//
+// State changes are coalesced over kCoalesceInterval: the burst of events of
+// a card with several partitions is one "storagesChanged" message, with the
+// storages whose state differs from the previous message.
+class StorageManager {
+ public:
+  // Mapped to storage_type_e.
+  enum Type {
+    TYPE_INTERNAL,
+    TYPE_EXTERNAL,
+  };
+
+  // Mapped to storage_state_e.
+  enum State {
+    STATE_UNMOUNTABLE = -2,
+    STATE_REMOVED = -1,
+    STATE_MOUNTED = 0,
+    STATE_MOUNTED_READONLY = 1,
+  };
+
+  explicit StorageManager(ContextAPI* api);
+  ~StorageManager();
+
+  // Adds a directory that is always mounted.
+  void AddInternal(const std::string& label, const std::string& path);
+  // Lists the devices of the platform, and follows their state from then on.
+  void Start();
+
+  // The storages, as an array of {label, type, state}.
+  picojson::value List();
+  // False if |label| is unknown.
+  bool Get(const std::string& label, picojson::value* storage);
+
+  // Fills |roots|, owned by the calling thread, with the mounted storages
+  // if they changed since |*generation|.
+  void UpdateRoots(VirtualRootTable* roots, unsigned int* generation);
+
+ private:
+  struct Storage {
+    std::string path;
+    int type;
+    int state;
+    picojson::value json;
+    // As in the last "storagesChanged" message.
+    std::string posted_state;
+  };
+
+  // Adds or updates a storage, and schedules the message for the change.
+  void UpdateLocked(const std::string& label, const std::string& path,
+                    int type, int state);
+  void FlushChangesLocked();
+
+  // Implemented for each platform.
+  void StartBackend();
+  void StopBackend();
+
+  static gboolean OnCoalesceTimeout(gpointer user_data);
+
+#if defined(GENERIC_DESKTOP)
+  // Updates every removable block device from udev and the mount table.
+  void RescanLocked();
+
+  static gboolean OnUdevEvent(GIOChannel* channel, GIOCondition condition,
+                              gpointer user_data);
+  static gboolean OnMountsChanged(GIOChannel* channel, GIOCondition condition,
+                                  gpointer user_data);
+
+  udev* udev_;
+  udev_monitor* monitor_;
+  guint monitor_watch_id_;
+  int mounts_fd_;
+  guint mounts_watch_id_;
+  // By syspath, for the label of a device to be kept when it comes back.
+  std::map<std::string, std::string> device_labels_;
+#elif defined(TIZEN)
+  static bool OnStorageDeviceSupported(int id, storage_type_e type,
+      storage_state_e state, const char* path, void* user_data);
+  static void OnStorageStateChanged(int id, storage_state_e state,
+      void* user_data);
+
+  std::map<int, std::string> device_labels_;
+#endif
+
+  ContextAPI* api_;
+  pthread_mutex_t mutex_;
+  std::map<std::string, Storage> storages_;
+  // Of List(), empty when a storage changed.
+  picojson::value list_;
+  unsigned int generation_;
+  guint timeout_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(StorageManager);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_STORAGE_H_
@@ -0,0 +1,212 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_storage.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <set>
+#include <sstream>
+
+namespace {
+
+const char kRemovableStorage[] = "removable";
+const char kMounts[] = "/proc/self/mounts";
+
+struct Mount {
+  std::string path;
+  bool read_only;
+};
+
+// Mount points have their spaces and the like escaped as octal.
+std::string Unescape(const char* field) {
+  std::string unescaped;
+  for (const char* p = field; *p; ++p) {
+    if (p[0] == '\\' && p[1] >= '0' && p[1] <= '3' && p[2] && p[3]) {
+      unescaped.push_back(((p[1] - '0') << 6) | ((p[2] - '0') << 3) |
+                          (p[3] - '0'));
+      p += 3;
+    } else {
+      unescaped.push_back(*p);
+    }
+  }
+  return unescaped;
+}
+
+// The first mount of each block device, by device number.
+std::map<dev_t, Mount> ReadMounts() {
+  std::map<dev_t, Mount> mounts;
+  FILE* file = fopen(kMounts, "re");
+  if (!file)
+    return mounts;
+
+  char source[4096], target[4096], type[256], options[4096];
+  while (fscanf(file, "%4095s %4095s %255s %4095s %*d %*d\n",
+                source, target, type, options) == 4) {
+    struct stat st;
+    if (strncmp(source, "/dev/", 5) || stat(source, &st) < 0 ||
+        !S_ISBLK(st.st_mode) || mounts.count(st.st_rdev))
+      continue;
+
+    Mount mount;
+    mount.path = Unescape(target);
+    mount.read_only = !strncmp(options, "ro", 2) &&
+                      (options[2] == ',' || options[2] == '\0');
+    mounts[st.st_rdev] = mount;
+  }
+  fclose(file);
+  return mounts;
+}
+
+// Removable media and the like, not the disks of the system.
+bool IsRemovable(udev_device* device) {
+  const char* bus = udev_device_get_property_value(device, "ID_BUS");
+  if (bus && !strcmp(bus, "usb"))
+    return true;
+
+  udev_device* disk = device;
+  const char* devtype = udev_device_get_devtype(device);
+  if (devtype && !strcmp(devtype, "partition"))
+    disk = udev_device_get_parent_with_subsystem_devtype(device, "block",
+                                                         "disk");
+  const char* removable = disk ?
+      udev_device_get_sysattr_value(disk, "removable") : NULL;
+  return removable && !strcmp(removable, "1");
+}
+
+}  // namespace
+
+void StorageManager::StartBackend() {
+  udev_ = udev_new();
+  if (!udev_)
+    return;
+
+  monitor_ = udev_monitor_new_from_netlink(udev_, "udev");
+  if (monitor_ &&
+      udev_monitor_filter_add_match_subsystem_devtype(monitor_, "block",
+                                                      NULL) == 0 &&
+      udev_monitor_enable_receiving(monitor_) == 0) {
+    GIOChannel* channel =
+        g_io_channel_unix_new(udev_monitor_get_fd(monitor_));
+    monitor_watch_id_ = g_io_add_watch(channel, G_IO_IN, OnUdevEvent, this);
+    g_io_channel_unref(channel);
+  }
+
+  // Devices are mounted after udev reports them, and the mount table
+  // polls as "priority" data when it changes.
+  mounts_fd_ = open(kMounts, O_RDONLY | O_CLOEXEC);
+  if (mounts_fd_ >= 0) {
+    GIOChannel* channel = g_io_channel_unix_new(mounts_fd_);
+    mounts_watch_id_ = g_io_add_watch(
+        channel, static_cast<GIOCondition>(G_IO_PRI | G_IO_ERR),
+        OnMountsChanged, this);
+    g_io_channel_unref(channel);
+  }
+
+  RescanLocked();
+}
+
+void StorageManager::StopBackend() {
+  if (monitor_watch_id_)
+    g_source_remove(monitor_watch_id_);
+  if (mounts_watch_id_)
+    g_source_remove(mounts_watch_id_);
+  if (mounts_fd_ >= 0)
+    close(mounts_fd_);
+  if (monitor_)
+    udev_monitor_unref(monitor_);
+  if (udev_)
+    udev_unref(udev_);
+  monitor_watch_id_ = mounts_watch_id_ = 0;
+  mounts_fd_ = -1;
+  monitor_ = NULL;
+  udev_ = NULL;
+}
+
+void StorageManager::RescanLocked() {
+  if (!udev_)
+    return;
+
+  std::map<dev_t, Mount> mounts = ReadMounts();
+  std::set<std::string> present;
+
+  udev_enumerate* enumerate = udev_enumerate_new(udev_);
+  udev_enumerate_add_match_subsystem(enumerate, "block");
+  udev_enumerate_add_match_property(enumerate, "ID_FS_USAGE", "filesystem");
+  udev_enumerate_scan_devices(enumerate);
+
+  udev_list_entry* entry;
+  udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+    const char* syspath = udev_list_entry_get_name(entry);
+    udev_device* device = udev_device_new_from_syspath(udev_, syspath);
+    if (!device)
+      continue;
+    if (!IsRemovable(device)) {
+      udev_device_unref(device);
+      continue;
+    }
+
+    std::string& label = device_labels_[syspath];
+    if (label.empty()) {
+      std::ostringstream name;
+      name << kRemovableStorage << device_labels_.size() - 1;
+      label = name.str();
+    }
+    present.insert(label);
+
+    std::map<dev_t, Mount>::iterator mount =
+        mounts.find(udev_device_get_devnum(device));
+    if (mount == mounts.end()) {
+      UpdateLocked(label, "", TYPE_EXTERNAL, STATE_UNMOUNTABLE);
+    } else {
+      UpdateLocked(label, mount->second.path, TYPE_EXTERNAL,
+                   mount->second.read_only ? STATE_MOUNTED_READONLY :
+                                             STATE_MOUNTED);
+    }
+    udev_device_unref(device);
+  }
+  udev_enumerate_unref(enumerate);
+
+  for (std::map<std::string, std::string>::iterator it =
+       device_labels_.begin(); it != device_labels_.end(); ++it) {
+    if (!present.count(it->second))
+      UpdateLocked(it->second, "", TYPE_EXTERNAL, STATE_REMOVED);
+  }
+}
+
+gboolean StorageManager::OnUdevEvent(GIOChannel* channel,
+                                     GIOCondition condition,
+                                     gpointer user_data) {
+  StorageManager* manager = static_cast<StorageManager*>(user_data);
+
+  pthread_mutex_lock(&manager->mutex_);
+  // A burst is drained at once, and rescanned once.
+  udev_device* device;
+  while ((device = udev_monitor_receive_device(manager->monitor_)))
+    udev_device_unref(device);
+  manager->RescanLocked();
+  pthread_mutex_unlock(&manager->mutex_);
+
+  return TRUE;
+}
+
+gboolean StorageManager::OnMountsChanged(GIOChannel* channel,
+                                         GIOCondition condition,
+                                         gpointer user_data) {
+  StorageManager* manager = static_cast<StorageManager*>(user_data);
+
+  pthread_mutex_lock(&manager->mutex_);
+  // The change is acknowledged by reading the table again.
+  char buffer[4096];
+  lseek(manager->mounts_fd_, 0, SEEK_SET);
+  while (read(manager->mounts_fd_, buffer, sizeof(buffer)) > 0) {}
+  manager->RescanLocked();
+  pthread_mutex_unlock(&manager->mutex_);
+
+  return TRUE;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_storage.h"
+
+#include <sstream>
+
+namespace {
+
+const char kInternalStorage[] = "internal";
+const char kRemovableStorage[] = "removable";
+
+}  // namespace
+
+void StorageManager::StartBackend() {
+  storage_foreach_device_supported(OnStorageDeviceSupported, this);
+}
+
+void StorageManager::StopBackend() {
+  for (std::map<int, std::string>::iterator it = device_labels_.begin();
+       it != device_labels_.end(); ++it)
+    storage_unset_state_changed_cb(it->first);
+  device_labels_.clear();
+}
+
+// Called from Start(), with the lock held.
+bool StorageManager::OnStorageDeviceSupported(int id, storage_type_e type,
+    storage_state_e state, const char* path, void* user_data) {
+  StorageManager* manager = static_cast<StorageManager*>(user_data);
+
+  std::ostringstream label;
+  label << (type == STORAGE_TYPE_INTERNAL ? kInternalStorage :
+            kRemovableStorage) << id;
+  manager->UpdateLocked(label.str(), path,
+                        type == STORAGE_TYPE_INTERNAL ? TYPE_INTERNAL :
+                                                        TYPE_EXTERNAL,
+                        state);
+
+  if (!manager->device_labels_.count(id)) {
+    manager->device_labels_[id] = label.str();
+    storage_set_state_changed_cb(id, OnStorageStateChanged, manager);
+  }
+  return true;
+}
+
+void StorageManager::OnStorageStateChanged(int id, storage_state_e state,
+    void* user_data) {
+  StorageManager* manager = static_cast<StorageManager*>(user_data);
+
+  pthread_mutex_lock(&manager->mutex_);
+  std::map<int, std::string>::iterator it = manager->device_labels_.find(id);
+  if (it != manager->device_labels_.end()) {
+    Storage& storage = manager->storages_[it->second];
+    manager->UpdateLocked(it->second, storage.path, storage.type, state);
+  }
+  pthread_mutex_unlock(&manager->mutex_);
+}
@@ -0,0 +1,773 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+namespace {
+
+const size_t kMinReadAhead = 64 * 1024;
+const size_t kMaxReadAhead = 1024 * 1024;
+const size_t kWriteBufferSize = 256 * 1024;
+// Atomic streams are written to a private file, read back rarely.
+const size_t kAtomicWriteBufferSize = 1024 * 1024;
+
+// Handles are the generation of their slot, then its index.
+const unsigned int kSlotBits = 16;
+const unsigned int kMaxSlots = 1 << kSlotBits;
+const unsigned int kSlotMask = kMaxSlots - 1;
+const unsigned int kGenerationMask = (1 << (32 - kSlotBits)) - 1;
+
+const size_t kMinDefaultOpen = 16;
+const size_t kMaxDefaultOpen = 256;
+
+// Short only at the end of the file.
+ssize_t ReadAt(int fd, char* buffer, size_t count, int64_t offset) {
+  size_t done = 0;
+  while (done < count) {
+    ssize_t read_bytes = pread(fd, buffer + done, count - done, offset + done);
+    if (read_bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (read_bytes == 0)
+      break;
+    done += read_bytes;
+  }
+  return done;
+}
+
+// Gives |fd| the mode of |path|, if the file exists, and with |content|
+// copies its content too.
+bool CopyFile(const std::string& path, int fd, bool content) {
+  int source = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (source < 0)
+    return errno == ENOENT;
+
+  struct stat st;
+  bool copied = fstat(source, &st) == 0 && fchmod(fd, st.st_mode & 07777) == 0;
+  while (copied && content) {
+    ssize_t sent_bytes = sendfile(fd, source, NULL, kAtomicWriteBufferSize);
+    if (sent_bytes < 0 && errno == EINTR)
+      continue;
+    if (sent_bytes <= 0) {
+      copied = sent_bytes == 0;
+      break;
+    }
+  }
+  close(source);
+  return copied;
+}
+
+bool SyncDirectory(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+std::string DirectoryOf(const std::string& path) {
+  size_t slash = path.find_last_of('/');
+  if (slash == std::string::npos)
+    return ".";
+  return slash ? path.substr(0, slash) : "/";
+}
+
+int64_t MonotonicMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+bool WriteAt(int fd, const char* buffer, size_t count, int64_t offset) {
+  while (count > 0) {
+    ssize_t written_bytes = pwrite(fd, buffer, count, offset);
+    if (written_bytes < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    buffer += written_bytes;
+    offset += written_bytes;
+    count -= written_bytes;
+  }
+  return true;
+}
+
+}  // namespace
+
+// static
+FileStream* FileStream::Open(const std::string& path, int flags) {
+  int fd = open(path.c_str(), flags | O_CLOEXEC, 0666);
+  if (fd < 0)
+    return NULL;
+
+  FileStream* stream = new FileStream(fd, path, flags);
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+    stream->device_ = st.st_dev;
+    stream->inode_ = st.st_ino;
+    stream->size_ = st.st_size;
+  }
+  if (flags & O_APPEND)
+    stream->position_ = lseek(fd, 0, SEEK_END);
+
+  return stream;
+}
+
+// static
+FileStream* FileStream::OpenAtomic(const std::string& path, int flags) {
+  // In the same directory, to be renamed over |path|.
+  size_t slash = path.find_last_of('/');
+  std::string temp_path = path.substr(0, slash + 1) + "." +
+                          path.substr(slash + 1) + ".XXXXXX";
+  int fd = mkostemp(&temp_path[0], O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  if (!CopyFile(path, fd, !(flags & O_TRUNC))) {
+    int error = errno;
+    close(fd);
+    unlink(temp_path.c_str());
+    errno = error;
+    return NULL;
+  }
+
+  // The temporary file is reopened as is if the stream is suspended.
+  flags &= ~(O_TRUNC | O_CREAT | O_EXCL);
+  FileStream* stream = new FileStream(fd, temp_path, flags);
+  stream->target_ = path;
+  stream->write_buffer_size_ = kAtomicWriteBufferSize;
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+    stream->device_ = st.st_dev;
+    stream->inode_ = st.st_ino;
+    stream->size_ = st.st_size;
+  }
+  if (flags & O_APPEND)
+    stream->position_ = lseek(fd, 0, SEEK_END);
+
+  return stream;
+}
+
+FileStream::FileStream(int fd, const std::string& path, int flags)
+    : fd_(fd),
+      path_(path),
+      commit_interval_(0),
+      flags_(flags),
+      access_(0),
+      device_(0),
+      inode_(0),
+      position_(0),
+      size_(-1),
+      read_start_(0),
+      read_length_(0),
+      read_ahead_(kMinReadAhead),
+      write_buffer_size_(kWriteBufferSize),
+      write_start_(0),
+      advice_(0),
+      drop_start_(0),
+      drop_end_(0) {
+  int mode = flags & O_ACCMODE;
+  if (mode == O_RDONLY || mode == O_RDWR)
+    access_ |= READ;
+  if (mode == O_WRONLY || mode == O_RDWR)
+    access_ |= WRITE;
+}
+
+FileStream::~FileStream() {
+  FlushWriteBuffer();
+  DropPending();
+  if (fd_ >= 0)
+    close(fd_);
+  if (IsAtomic())
+    unlink(path_.c_str());
+}
+
+bool FileStream::Suspend() {
+  if (fd_ < 0)
+    return true;
+  if (!FlushWriteBuffer())
+    return false;
+
+  DropPending();
+  DropReadBuffer();
+  close(fd_);
+  fd_ = -1;
+  return true;
+}
+
+bool FileStream::Resume() {
+  if (fd_ >= 0)
+    return true;
+
+  // Already truncated or created, if asked to, when first opened.
+  int fd = open(path_.c_str(), (flags_ & ~(O_TRUNC | O_CREAT | O_EXCL)) |
+                               O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_dev != device_ || st.st_ino != inode_) {
+    close(fd);
+    errno = ESTALE;
+    return false;
+  }
+
+  fd_ = fd;
+  size_ = st.st_size;
+  ApplyAdvice();
+  return true;
+}
+
+void FileStream::SetAdvice(int advice) {
+  advice_ = advice;
+  ApplyAdvice();
+}
+
+bool FileStream::Read(size_t count, std::string* data) {
+  if (!FlushWriteBuffer())
+    return false;
+
+  if (count == kToEnd) {
+    InvalidateSize();
+    int64_t size = Size();
+    if (size < 0)
+      return false;
+    int64_t available = size > position_ ? size - position_ : 0;
+    if (available > static_cast<int64_t>(kMaxRead))
+      available = kMaxRead;
+    count = available;
+    data->reserve(data->size() + count);
+  }
+  if (count > kMaxRead)
+    count = kMaxRead;
+
+  while (count > 0) {
+    int64_t read_end = read_start_ + read_length_;
+    if (position_ >= read_start_ && position_ < read_end) {
+      size_t offset = position_ - read_start_;
+      size_t length = std::min(count, read_length_ - offset);
+      data->append(&read_buffer_[offset], length);
+      position_ += length;
+      count -= length;
+      continue;
+    }
+
+    // Nothing to read past the known end of the file.
+    if (size_ >= 0 && position_ >= size_)
+      break;
+
+    // Too large to be worth going through the read-ahead buffer.
+    if (count >= read_ahead_) {
+      size_t old_size = data->size();
+      data->resize(old_size + count);
+      ssize_t read_bytes = ReadAt(fd_, &(*data)[old_size], count, position_);
+      if (read_bytes < 0) {
+        data->resize(old_size);
+        return false;
+      }
+      data->resize(old_size + read_bytes);
+      DropBehind(position_, position_ + read_bytes);
+      position_ += read_bytes;
+      // Short of the size we had, the file was truncated.
+      if (static_cast<size_t>(read_bytes) < count)
+        InvalidateSize();
+      break;
+    }
+
+    if (!FillReadBuffer())
+      return false;
+    if (!read_length_) {
+      InvalidateSize();
+      break;
+    }
+  }
+
+  return true;
+}
+
+bool FileStream::Write(const char* data, size_t length) {
+  DropReadBuffer();
+
+  int64_t write_end = write_start_ + write_buffer_.size();
+  if (!write_buffer_.empty() && position_ != write_end && !FlushWriteBuffer())
+    return false;
+
+  if (write_buffer_.size() + length > write_buffer_size_) {
+    if (!FlushWriteBuffer())
+      return false;
+    if (length >= write_buffer_size_) {
+      if (!WriteAt(fd_, data, length, position_))
+        return false;
+      DropBehind(position_, position_ + length);
+      position_ += length;
+      GrowSize(position_);
+      return true;
+    }
+  }
+
+  if (write_buffer_.empty()) {
+    write_buffer_.reserve(write_buffer_size_);
+    write_start_ = position_;
+  }
+  write_buffer_.insert(write_buffer_.end(), data, data + length);
+  position_ += length;
+
+  return true;
+}
+
+bool FileStream::Flush() {
+  return FlushWriteBuffer();
+}
+
+bool FileStream::Sync() {
+  return FlushWriteBuffer() && fdatasync(fd_) == 0;
+}
+
+bool FileStream::Commit() {
+  if (!IsAtomic())
+    return Flush();
+  if (!Resume() || !FlushWriteBuffer() || fsync(fd_) < 0 ||
+      rename(path_.c_str(), target_.c_str()) < 0)
+    return false;
+
+  path_ = target_;
+  target_.clear();
+  return true;
+}
+
+bool FileStream::Seek(int64_t position) {
+  if (position < 0 || !FlushWriteBuffer())
+    return false;
+
+  position_ = position;
+  converters_.Reset();
+  return true;
+}
+
+int64_t FileStream::Size() {
+  if (size_ < 0) {
+    struct stat st;
+    if (fstat(fd_, &st) < 0)
+      return -1;
+    size_ = st.st_size;
+  }
+
+  if (!write_buffer_.empty())
+    return std::max<int64_t>(size_, write_start_ + write_buffer_.size());
+  return size_;
+}
+
+int64_t FileStream::BytesAvailable() {
+  int64_t size = Size();
+  if (size < 0 || position_ >= size)
+    return -1;
+  return size - position_;
+}
+
+bool FileStream::FillReadBuffer() {
+  // The read-ahead doubles for each fill continuing the previous one.
+  if (read_length_ &&
+      position_ == read_start_ + static_cast<int64_t>(read_length_))
+    read_ahead_ = std::min(read_ahead_ * 2, kMaxReadAhead);
+  else
+    read_ahead_ = kMinReadAhead;
+
+  read_buffer_.resize(read_ahead_);
+  ssize_t read_bytes = ReadAt(fd_, &read_buffer_[0], read_ahead_, position_);
+  if (read_bytes < 0) {
+    DropReadBuffer();
+    return false;
+  }
+
+  read_start_ = position_;
+  read_length_ = read_bytes;
+  DropBehind(read_start_, read_start_ + read_length_);
+  return true;
+}
+
+bool FileStream::FlushWriteBuffer() {
+  if (write_buffer_.empty())
+    return true;
+
+  bool written = WriteAt(fd_, &write_buffer_[0], write_buffer_.size(),
+                         write_start_);
+  if (written) {
+    GrowSize(write_start_ + write_buffer_.size());
+    DropBehind(write_start_, write_start_ + write_buffer_.size());
+  }
+  write_buffer_.clear();
+  return written;
+}
+
+void FileStream::DropReadBuffer() {
+  read_start_ = 0;
+  read_length_ = 0;
+}
+
+void FileStream::GrowSize(int64_t end) {
+  if (size_ >= 0 && end > size_)
+    size_ = end;
+}
+
+void FileStream::ApplyAdvice() {
+  if (fd_ >= 0 && (advice_ & ADVICE_SEQUENTIAL))
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+void FileStream::DropBehind(int64_t start, int64_t end) {
+  if (!(advice_ & ADVICE_DONTNEED) || end <= start)
+    return;
+
+  // Dirty pages are not dropped.
+  if (access_ & WRITE)
+    sync_file_range(fd_, start, end - start, SYNC_FILE_RANGE_WRITE);
+  DropPending();
+  drop_start_ = start;
+  drop_end_ = end;
+}
+
+void FileStream::DropPending() {
+  if (drop_end_ <= drop_start_ || fd_ < 0)
+    return;
+
+  if (access_ & WRITE) {
+    sync_file_range(fd_, drop_start_, drop_end_ - drop_start_,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                    SYNC_FILE_RANGE_WAIT_AFTER);
+  }
+  posix_fadvise(fd_, drop_start_, drop_end_ - drop_start_,
+                POSIX_FADV_DONTNEED);
+  drop_start_ = drop_end_ = 0;
+}
+
+FileStreamTable::FileStreamTable(size_t max_open)
+    : max_open_(std::max<size_t>(max_open, 1)),
+      open_(0),
+      newest_(-1),
+      oldest_(-1) {}
+
+FileStreamTable::~FileStreamTable() {
+  for (size_t i = 0; i < slots_.size(); ++i)
+    delete slots_[i].stream;
+}
+
+// static
+size_t FileStreamTable::DefaultMaxOpen() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur == RLIM_INFINITY)
+    return kMaxDefaultOpen;
+  return std::min(std::max<size_t>(limit.rlim_cur / 4, kMinDefaultOpen),
+                  kMaxDefaultOpen);
+}
+
+FileStream* FileStreamTable::Open(const std::string& path, int flags,
+                                  bool atomic) {
+  FileStream* stream;
+  while (!(stream = atomic ? FileStream::OpenAtomic(path, flags) :
+                             FileStream::Open(path, flags))) {
+    if ((errno != EMFILE && errno != ENFILE) || !SuspendIdle(-1))
+      return NULL;
+  }
+  return stream;
+}
+
+unsigned int FileStreamTable::Add(FileStream* stream) {
+  int index;
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else if (slots_.size() < kSlotMask) {
+    // The last index is left out, so that no handle is kInvalidHandle.
+    index = slots_.size();
+    Slot slot = { NULL, 0, -1, -1 };
+    slots_.push_back(slot);
+  } else {
+    return kInvalidHandle;
+  }
+
+  Slot& slot = slots_[index];
+  slot.stream = stream;
+  if (!stream->IsSuspended()) {
+    Link(index);
+    while (open_ > max_open_ && SuspendIdle(index)) {}
+  }
+
+  return (slot.generation << kSlotBits) | index;
+}
+
+bool FileStreamTable::Contains(unsigned int handle) const {
+  return Find(handle) >= 0;
+}
+
+FileStream* FileStreamTable::Get(unsigned int handle) {
+  int index = Find(handle);
+  if (index < 0)
+    return NULL;
+
+  FileStream* stream = slots_[index].stream;
+  if (stream->IsSuspended()) {
+    while (open_ >= max_open_ && SuspendIdle(index)) {}
+    while (!stream->Resume()) {
+      if ((errno != EMFILE && errno != ENFILE) || !SuspendIdle(index))
+        return NULL;
+    }
+  } else {
+    Unlink(index);
+  }
+  Link(index);
+
+  return stream;
+}
+
+FileStream* FileStreamTable::Remove(unsigned int handle) {
+  int index = Find(handle);
+  if (index < 0)
+    return NULL;
+
+  Slot& slot = slots_[index];
+  FileStream* stream = slot.stream;
+  if (!stream->IsSuspended())
+    Unlink(index);
+  slot.stream = NULL;
+  slot.generation = (slot.generation + 1) & kGenerationMask;
+  free_slots_.push_back(index);
+
+  return stream;
+}
+
+int FileStreamTable::Find(unsigned int handle) const {
+  unsigned int index = handle & kSlotMask;
+  if (index >= slots_.size())
+    return -1;
+
+  const Slot& slot = slots_[index];
+  if (!slot.stream || slot.generation != handle >> kSlotBits)
+    return -1;
+  return index;
+}
+
+void FileStreamTable::Link(int index) {
+  Slot& slot = slots_[index];
+  slot.newer = -1;
+  slot.older = newest_;
+  if (newest_ >= 0)
+    slots_[newest_].newer = index;
+  newest_ = index;
+  if (oldest_ < 0)
+    oldest_ = index;
+  open_++;
+}
+
+void FileStreamTable::Unlink(int index) {
+  Slot& slot = slots_[index];
+  if (slot.newer >= 0)
+    slots_[slot.newer].older = slot.older;
+  else
+    newest_ = slot.older;
+  if (slot.older >= 0)
+    slots_[slot.older].newer = slot.newer;
+  else
+    oldest_ = slot.newer;
+  slot.newer = slot.older = -1;
+  open_--;
+}
+
+bool FileStreamTable::SuspendIdle(int keep) {
+  for (int index = oldest_; index >= 0; index = slots_[index].newer) {
+    if (index == keep)
+      continue;
+    if (slots_[index].stream->Suspend()) {
+      Unlink(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+FileStreamWatcher::FileStreamWatcher()
+    : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+
+FileStreamWatcher::~FileStreamWatcher() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+void FileStreamWatcher::Watch(FileStream* stream, const std::string& path) {
+  if (fd_ < 0)
+    return;
+
+  int wd = inotify_add_watch(fd_, path.c_str(), IN_MODIFY);
+  if (wd < 0)
+    return;
+
+  streams_.insert(std::make_pair(wd, stream));
+  watches_[stream] = wd;
+}
+
+void FileStreamWatcher::Unwatch(FileStream* stream) {
+  std::map<FileStream*, int>::iterator watch = watches_.find(stream);
+  if (watch == watches_.end())
+    return;
+  int wd = watch->second;
+  watches_.erase(watch);
+
+  typedef std::multimap<int, FileStream*>::iterator Iterator;
+  std::pair<Iterator, Iterator> range = streams_.equal_range(wd);
+  for (Iterator it = range.first; it != range.second; ++it) {
+    if (it->second == stream) {
+      streams_.erase(it);
+      break;
+    }
+  }
+
+  if (!streams_.count(wd))
+    inotify_rm_watch(fd_, wd);
+}
+
+void FileStreamWatcher::Poll() {
+  if (fd_ < 0 || streams_.empty())
+    return;
+
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+  while ((length = read(fd_, buffer, sizeof(buffer))) > 0) {
+    for (char* p = buffer; p < buffer + length;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(*event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        std::multimap<int, FileStream*>::iterator it;
+        for (it = streams_.begin(); it != streams_.end(); ++it)
+          it->second->InvalidateSize();
+        continue;
+      }
+
+      typedef std::multimap<int, FileStream*>::iterator Iterator;
+      std::pair<Iterator, Iterator> range = streams_.equal_range(event->wd);
+      for (Iterator it = range.first; it != range.second; ++it)
+        it->second->InvalidateSize();
+    }
+  }
+}
+
+FileStreamCommitter::FileStreamCommitter()
+    : timeout_id_(0),
+      deadline_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+FileStreamCommitter::~FileStreamCommitter() {
+  pthread_mutex_lock(&mutex_);
+  if (timeout_id_)
+    g_source_remove(timeout_id_);
+  CommitPendingLocked();
+  pthread_mutex_unlock(&mutex_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool FileStreamCommitter::Commit(FileStream* stream) {
+  // Write errors are still reported to the caller.
+  if (!stream->Flush()) {
+    delete stream;
+    return false;
+  }
+
+  pthread_mutex_lock(&mutex_);
+  pending_.push_back(stream);
+  bool committed = true;
+  if (stream->commit_interval())
+    ScheduleLocked(stream->commit_interval());
+  else
+    committed = CommitPendingLocked();
+  pthread_mutex_unlock(&mutex_);
+
+  return committed;
+}
+
+void FileStreamCommitter::CommitPath(const std::string& path) {
+  pthread_mutex_lock(&mutex_);
+  for (size_t i = 0; i < pending_.size(); ++i) {
+    if (pending_[i]->target() == path) {
+      CommitPendingLocked();
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+bool FileStreamCommitter::CommitPendingLocked() {
+  if (timeout_id_) {
+    g_source_remove(timeout_id_);
+    timeout_id_ = 0;
+  }
+
+  bool committed = true;
+  std::set<std::string> targets;
+  std::set<std::string> directories;
+  // Latest first, so that only the last stream on a file is committed.
+  for (size_t i = pending_.size(); i-- > 0;) {
+    FileStream* stream = pending_[i];
+    if (targets.insert(stream->target()).second) {
+      std::string target = stream->target();
+      if (stream->Commit()) {
+        directories.insert(DirectoryOf(target));
+      } else {
+        std::cerr << "Failed to commit " << target << "\n";
+        committed = false;
+      }
+    }
+    delete stream;
+  }
+  pending_.clear();
+
+  for (std::set<std::string>::iterator it = directories.begin();
+       it != directories.end(); ++it) {
+    if (!SyncDirectory(*it))
+      committed = false;
+  }
+  return committed;
+}
+
+void FileStreamCommitter::ScheduleLocked(unsigned int interval) {
+  int64_t deadline = MonotonicMs() + interval;
+  if (timeout_id_) {
+    if (deadline >= deadline_)
+      return;
+    g_source_remove(timeout_id_);
+  }
+
+  deadline_ = deadline;
+  timeout_id_ = g_timeout_add(interval, OnCommitTimeout, this);
+}
+
+gboolean FileStreamCommitter::OnCommitTimeout(gpointer user_data) {
+  FileStreamCommitter* committer = static_cast<FileStreamCommitter*>(user_data);
+
+  pthread_mutex_lock(&committer->mutex_);
+  committer->timeout_id_ = 0;
+  committer->CommitPendingLocked();
+  pthread_mutex_unlock(&committer->mutex_);
+
+  return FALSE;
+}
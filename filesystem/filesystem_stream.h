@@ -0,0 +1,281 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_STREAM_H_
+#define FILESYSTEM_FILESYSTEM_STREAM_H_
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/utils.h"
+#include "filesystem/filesystem_charset.h"
+
+// A file stream over a raw fd, positioned with pread()/pwrite().
+//
+// Reads go through a read-ahead buffer that grows while the stream is read
+// sequentially and shrinks back after a seek; reads larger than it bypass
+// it. Files are not mapped: another writer truncating one would make
+// reading the mapping a SIGBUS. Writes are kept in a write-behind buffer
+// until it fills, the stream is read, seeked, flushed or closed.
+//
+// The size of the file is kept up to date through the stream's own writes,
+// so that eof() and BytesAvailable() are plain arithmetic. Changes made by
+// other writers are reported by a FileStreamWatcher.
+//
+// An atomic stream writes to a temporary sibling of its file instead, with
+// a larger write-behind buffer, and Commit() replaces the file with it.
+//
+// Advice tells the kernel how the file is used: sequentially, for a larger
+// read-ahead, and without reuse, for what the stream read or wrote to be
+// dropped from the page cache behind it instead of evicting other files.
+class FileStream {
+ public:
+  enum Access {
+    READ = 1 << 0,
+    WRITE = 1 << 1,
+  };
+
+  enum Advice {
+    ADVICE_SEQUENTIAL = 1 << 0,
+    ADVICE_DONTNEED = 1 << 1,
+  };
+
+  // Read() count meaning "up to the end of the file".
+  static const size_t kToEnd = static_cast<size_t>(-1);
+  // The most a Read() returns, the rest of a larger file taking several
+  // reads.
+  static const size_t kMaxRead = 64 * 1024 * 1024;
+
+  // |flags| are open(2) flags. Returns NULL on failure, with errno set.
+  static FileStream* Open(const std::string& path, int flags);
+  // Opens an atomic stream on |path|, starting with its content unless
+  // |flags| truncate it. The file is left untouched until Commit(), and the
+  // temporary one is removed if the stream is destroyed uncommitted.
+  static FileStream* OpenAtomic(const std::string& path, int flags);
+  // Flushes and closes.
+  ~FileStream();
+
+  int fd() const { return fd_; }
+  bool CanAccess(int access) const { return (access_ & access) == access; }
+
+  // Flushes and closes the fd of an idle stream, keeping its position.
+  // Resume() opens the file again by path, and fails with errno
+  // ESTALE if the path now names another file.
+  bool Suspend();
+  bool Resume();
+  bool IsSuspended() const { return fd_ < 0; }
+
+  bool IsAtomic() const { return !target_.empty(); }
+  // The file an atomic stream replaces.
+  const std::string& target() const { return target_; }
+  // Flushes, syncs and renames the temporary file over the target, which
+  // then holds either its old or its new content after a crash, once its
+  // directory is synced too. The stream is no longer atomic afterwards.
+  bool Commit();
+  // How long the commit may be delayed by, in ms, for it to be grouped
+  // with others.
+  unsigned int commit_interval() const { return commit_interval_; }
+  void set_commit_interval(unsigned int ms) { commit_interval_ = ms; }
+
+  // A combination of Advice values.
+  void SetAdvice(int advice);
+
+  // Appends up to |count| bytes to |data|, at most kMaxRead, less at the
+  // end of the file.
+  bool Read(size_t count, std::string* data);
+  bool Write(const char* data, size_t length);
+
+  // Hands the buffered writes to the kernel.
+  bool Flush();
+  // Flushes, then waits for the data to reach the storage.
+  bool Sync();
+
+  bool Seek(int64_t position);
+  int64_t position() const { return position_; }
+
+  // Including the buffered writes, or -1 if fstat() fails.
+  int64_t Size();
+  // Makes the next Size() fstat() the file again.
+  void InvalidateSize() { size_ = -1; }
+
+  bool IsEof() { return position_ >= Size(); }
+  // Bytes left up to the end of the file, or -1 at the end.
+  int64_t BytesAvailable();
+
+  // The text converters of the stream, reset on Seek().
+  CharsetConverterCache* converters() { return &converters_; }
+
+ private:
+  FileStream(int fd, const std::string& path, int flags);
+
+  bool FillReadBuffer();
+  bool FlushWriteBuffer();
+  void DropReadBuffer();
+  void GrowSize(int64_t end);
+  void ApplyAdvice();
+  // Starts the writeback of [start, end), read or written last, and drops
+  // the range done before it.
+  void DropBehind(int64_t start, int64_t end);
+  // Drops the range left by DropBehind(), once written back.
+  void DropPending();
+
+  int fd_;
+  // The temporary file, for atomic streams.
+  std::string path_;
+  std::string target_;
+  unsigned int commit_interval_;
+  int flags_;
+  int access_;
+  // Of the file opened first, checked when resuming.
+  dev_t device_;
+  ino_t inode_;
+  int64_t position_;
+  // Of the file on disk, -1 when unknown.
+  int64_t size_;
+
+  // File bytes [read_start_, read_start_ + read_length_).
+  std::vector<char> read_buffer_;
+  int64_t read_start_;
+  size_t read_length_;
+  size_t read_ahead_;
+
+  // To be written at [write_start_, write_start_ + write_buffer_.size()).
+  std::vector<char> write_buffer_;
+  size_t write_buffer_size_;
+  int64_t write_start_;
+
+  int advice_;
+  // Not dropped yet, for its writeback to overlap with the next writes.
+  int64_t drop_start_;
+  int64_t drop_end_;
+
+  CharsetConverterCache converters_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileStream);
+};
+
+// The open streams of a context, by handle. Handles index a slot array and
+// carry the generation of their slot, so lookups are O(1) and a handle of a
+// closed stream is never mistaken for the stream reusing its slot.
+//
+// At most |max_open| streams keep their fd open: the least recently used
+// ones are suspended past that, or when the process runs out of fds, and
+// resumed transparently by Get().
+class FileStreamTable {
+ public:
+  static const unsigned int kInvalidHandle = static_cast<unsigned int>(-1);
+
+  explicit FileStreamTable(size_t max_open);
+  // Closes the streams left.
+  ~FileStreamTable();
+
+  // A quarter of the fd limit of the process, within [16, 256].
+  static size_t DefaultMaxOpen();
+
+  // Opens a stream, suspending idle ones if the process is out of fds.
+  // Returns NULL with errno set on failure.
+  FileStream* Open(const std::string& path, int flags, bool atomic);
+
+  // Takes ownership of |stream|. Returns kInvalidHandle if the table is
+  // full.
+  unsigned int Add(FileStream* stream);
+  bool Contains(unsigned int handle) const;
+  // Resumes the stream if it was suspended, and marks it as used. NULL for
+  // unknown handles and streams that can't be resumed.
+  FileStream* Get(unsigned int handle);
+  // Gives up ownership of the stream, NULL for unknown handles.
+  FileStream* Remove(unsigned int handle);
+
+ private:
+  struct Slot {
+    FileStream* stream;
+    unsigned int generation;
+    // Links of the open streams, most recently used first, -1 at the ends.
+    int newer;
+    int older;
+  };
+
+  // A slot holding a stream, or -1.
+  int Find(unsigned int handle) const;
+  void Link(int index);
+  void Unlink(int index);
+  // Suspends the least recently used open stream, other than |keep|.
+  bool SuspendIdle(int keep);
+
+  size_t max_open_;
+  size_t open_;
+  std::vector<Slot> slots_;
+  std::vector<int> free_slots_;
+  int newest_;
+  int oldest_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileStreamTable);
+};
+
+// Invalidates the size of the streams whose file is modified, by someone
+// else or through another stream, with an inotify IN_MODIFY watch on each.
+// The events are drained on demand by Poll(), no thread or main loop is
+// involved.
+class FileStreamWatcher {
+ public:
+  FileStreamWatcher();
+  ~FileStreamWatcher();
+
+  void Watch(FileStream* stream, const std::string& path);
+  void Unwatch(FileStream* stream);
+
+  // Handles the pending events, without blocking.
+  void Poll();
+
+ private:
+  int fd_;
+  // Streams on the same file share the watch descriptor.
+  std::multimap<int, FileStream*> streams_;
+  std::map<FileStream*, int> watches_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileStreamWatcher);
+};
+
+// Commits closed atomic streams. The streams given a commit interval are
+// held until the earliest of their deadlines, from the GLib main loop, and
+// committed together: a stream superseded by a later one on the same file
+// is dropped without being synced, and each directory is synced once for
+// the group.
+class FileStreamCommitter {
+ public:
+  FileStreamCommitter();
+  // Commits the streams left.
+  ~FileStreamCommitter();
+
+  // Takes ownership of the atomic |stream|, flushing it. Without a commit
+  // interval, it is committed along with the pending ones before returning.
+  bool Commit(FileStream* stream);
+  // Commits the pending streams if one targets |path|, so that opening it
+  // sees the last content written.
+  void CommitPath(const std::string& path);
+
+ private:
+  // Returns false if a stream failed.
+  bool CommitPendingLocked();
+  void ScheduleLocked(unsigned int interval);
+
+  static gboolean OnCommitTimeout(gpointer user_data);
+
+  pthread_mutex_t mutex_;
+  // In closing order.
+  std::vector<FileStream*> pending_;
+  guint timeout_id_;
+  // Of the timeout, on the monotonic clock in ms.
+  int64_t deadline_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileStreamCommitter);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_STREAM_H_
@@ -0,0 +1,191 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_tree_walker.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const int kDirectoryFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+const size_t kEntriesBufferSize = 32 * 1024;
+
+// Not exported by the C library.
+struct linux_dirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;  // NOLINT
+  unsigned char d_type;
+  char d_name[];
+};
+
+unsigned char TypeFromStat(int dir_fd, const char* name) {
+  struct stat st;
+  if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+    return DT_UNKNOWN;
+  return IFTODT(st.st_mode);
+}
+
+}  // namespace
+
+DirectoryReader::DirectoryReader(int fd)
+    : fd_(fd),
+      buffer_(kEntriesBufferSize),
+      size_(0),
+      offset_(0) {}
+
+bool DirectoryReader::Next(const char** name, unsigned char* type) {
+  while (true) {
+    if (offset_ >= size_) {
+      size_ = syscall(SYS_getdents64, fd_, &buffer_[0], buffer_.size());
+      offset_ = 0;
+      if (size_ < 0 && errno == EINTR)
+        continue;
+      if (size_ <= 0) {
+        if (size_ == 0)
+          errno = 0;
+        return false;
+      }
+    }
+
+    linux_dirent64* entry =
+        reinterpret_cast<linux_dirent64*>(&buffer_[offset_]);
+    offset_ += entry->d_reclen;
+
+    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      continue;
+
+    *name = entry->d_name;
+    *type = entry->d_type;
+    return true;
+  }
+}
+
+// A directory being walked. It is released by its own walk and by the walk
+// of each of its subdirectories; the last release leaves it. It is opened,
+// and left, relative to a dup of the fd of its parent, so a parent renamed
+// meanwhile doesn't redirect the walk.
+struct TreeWalker::Directory {
+  Directory(Directory* parent, int parent_fd, const std::string& name,
+            const std::string& path)
+      : parent(parent),
+        parent_fd(parent_fd),
+        name(name),
+        path(path),
+        pending(1),
+        entered(false) {}
+
+  ~Directory() {
+    if (parent_fd >= 0)
+      close(parent_fd);
+  }
+
+  Directory* parent;
+  // AT_FDCWD for the root, named by its path.
+  int parent_fd;
+  std::string name;
+  std::string path;
+  volatile int pending;
+  bool entered;
+};
+
+class TreeWalker::DirectoryTask : public WorkerPool::Task {
+ public:
+  DirectoryTask(TreeWalker* walker, Directory* dir)
+      : walker_(walker),
+        dir_(dir) {}
+
+  virtual void Run() {
+    __sync_sub_and_fetch(&walker_->queued_, 1);
+    walker_->ProcessDirectory(
+        dir_, openat(dir_->parent_fd, dir_->name.c_str(), kDirectoryFlags));
+  }
+
+ private:
+  TreeWalker* walker_;
+  Directory* dir_;
+};
+
+TreeWalker::TreeWalker(WorkerPool* pool, Visitor* visitor, int max_parallel)
+    : pool_(pool),
+      visitor_(visitor),
+      max_parallel_(max_parallel),
+      queued_(0) {}
+
+void TreeWalker::Walk(const std::string& root) {
+  // The root itself may be a symlink.
+  int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  ProcessDirectory(new Directory(NULL, AT_FDCWD, root, root), fd);
+  pool_->Wait(&group_);
+}
+
+void TreeWalker::ProcessDirectory(Directory* dir, int fd) {
+  if (fd < 0) {
+    visitor_->OnError(dir->path, errno);
+    Release(dir);
+    return;
+  }
+
+  if (!visitor_->ShouldStop() && visitor_->EnterDirectory(fd, dir->path)) {
+    dir->entered = true;
+    ReadEntries(dir, fd);
+  }
+
+  close(fd);
+  Release(dir);
+}
+
+void TreeWalker::ReadEntries(Directory* dir, int fd) {
+  DirectoryReader reader(fd);
+  const char* name;
+  unsigned char type;
+
+  while (!visitor_->ShouldStop() && reader.Next(&name, &type)) {
+    if (type == DT_UNKNOWN)
+      type = TypeFromStat(fd, name);
+
+    std::string path = dir->path + "/" + name;
+    if (type == DT_DIR)
+      VisitSubdirectory(dir, fd, name, path);
+    else
+      visitor_->VisitEntry(fd, name, path, type);
+  }
+
+  if (errno && !visitor_->ShouldStop())
+    visitor_->OnError(dir->path, errno);
+}
+
+void TreeWalker::VisitSubdirectory(Directory* dir, int fd, const char* name,
+                                   const std::string& path) {
+  // A failed dup() fails the openat() below, and is reported.
+  Directory* child = new Directory(dir, dup(fd), name, path);
+  __sync_add_and_fetch(&dir->pending, 1);
+
+  if (__sync_add_and_fetch(&queued_, 1) <= max_parallel_) {
+    pool_->Post(new DirectoryTask(this, child), &group_);
+    return;
+  }
+
+  // Enough is queued to keep the pool busy.
+  __sync_sub_and_fetch(&queued_, 1);
+  ProcessDirectory(child,
+                   openat(child->parent_fd, name, kDirectoryFlags));
+}
+
+void TreeWalker::Release(Directory* dir) {
+  while (dir && __sync_sub_and_fetch(&dir->pending, 1) == 0) {
+    if (dir->entered && !visitor_->ShouldStop())
+      visitor_->LeaveDirectory(dir->parent_fd, dir->name.c_str(), dir->path);
+
+    Directory* parent = dir->parent;
+    delete dir;
+    dir = parent;
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_TREE_WALKER_H_
+#define FILESYSTEM_FILESYSTEM_TREE_WALKER_H_
+
+#include <string>
+#include <vector>
+
+#include "common/utils.h"
+#include "filesystem/filesystem_worker_pool.h"
+
+// Reads the entries of a directory, other than "." and "..", with
+// getdents64().
+class DirectoryReader {
+ public:
+  explicit DirectoryReader(int fd);
+
+  // Returns false at the end of the directory, or on error with errno set.
+  // |type| is a DT_* value, DT_UNKNOWN if the filesystem doesn't tell.
+  bool Next(const char** name, unsigned char* type);
+
+ private:
+  int fd_;
+  std::vector<char> buffer_;
+  long size_;  // NOLINT
+  long offset_;  // NOLINT
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryReader);
+};
+
+// Walks a directory tree with getdents64(), relative to the fd of each
+// directory. Entry types come from d_type, so nothing is stat()ed unless the
+// filesystem doesn't report them. Subdirectories are handed to the worker
+// pool while fewer than |max_parallel| are queued, and walked inline
+// otherwise.
+class TreeWalker {
+ public:
+  // Called concurrently from the worker threads.
+  class Visitor {
+   public:
+    virtual ~Visitor() {}
+
+    // Before the entries of the directory at |path|, opened as |fd|.
+    // Returning false skips the directory.
+    virtual bool EnterDirectory(int fd, const std::string& path) {
+      return true;
+    }
+    // For each entry that is not a directory. |type| is a DT_* value and
+    // |dir_fd| the fd of the parent directory.
+    virtual void VisitEntry(int dir_fd, const char* name,
+                            const std::string& path, unsigned char type) = 0;
+    // Once everything below an entered directory has been visited. |name|
+    // is relative to |parent_fd|, the fd of the parent directory, or
+    // AT_FDCWD and the path itself for the root.
+    virtual void LeaveDirectory(int parent_fd, const char* name,
+                                const std::string& path) {}
+
+    virtual void OnError(const std::string& path, int error) = 0;
+    // Polled between entries, the walk ends as soon as it returns true.
+    virtual bool ShouldStop() const = 0;
+  };
+
+  TreeWalker(WorkerPool* pool, Visitor* visitor, int max_parallel);
+
+  // Returns once the whole tree has been visited or the walk stopped.
+  void Walk(const std::string& root);
+
+ private:
+  struct Directory;
+  class DirectoryTask;
+
+  void ProcessDirectory(Directory* dir, int fd);
+  void ReadEntries(Directory* dir, int fd);
+  void VisitSubdirectory(Directory* dir, int fd, const char* name,
+                         const std::string& path);
+  void Release(Directory* dir);
+
+  WorkerPool* pool_;
+  Visitor* visitor_;
+  int max_parallel_;
+  volatile int queued_;
+  WorkerPool::TaskGroup group_;
+
+  DISALLOW_COPY_AND_ASSIGN(TreeWalker);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_TREE_WALKER_H_
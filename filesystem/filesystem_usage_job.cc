@@ -0,0 +1,264 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_usage_job.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Anything that changes the size or the entries of a directory.
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MODIFY |
+                            IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                            IN_MOVE_SELF | IN_ONLYDIR;
+// Trees with more directories are computed every time rather than hold
+// that many watches.
+const size_t kMaxWatchesPerTree = 4096;
+const size_t kMaxEntries = 32;
+
+picojson::value ToJSON(uint64_t value) {
+  return picojson::value(static_cast<double>(value));
+}
+
+std::string ExtensionOf(const char* name) {
+  const char* dot = strrchr(name, '.');
+  // Hidden files without an extension start with their only dot.
+  if (!dot || dot == name)
+    return std::string();
+
+  std::string extension(dot + 1);
+  for (size_t i = 0; i < extension.size(); ++i)
+    extension[i] = tolower(extension[i]);
+  return extension;
+}
+
+}  // namespace
+
+DirectoryUsageCache::DirectoryUsageCache()
+    : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      events_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+DirectoryUsageCache::~DirectoryUsageCache() {
+  if (fd_ >= 0)
+    close(fd_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool DirectoryUsageCache::Lookup(const std::string& path,
+                                 picojson::object* usage) {
+  pthread_mutex_lock(&mutex_);
+  PollLocked();
+  EntryMap::iterator entry = entries_.find(path);
+  bool found = entry != entries_.end();
+  if (found)
+    *usage = entry->second.usage;
+  pthread_mutex_unlock(&mutex_);
+  return found;
+}
+
+uint64_t DirectoryUsageCache::Begin() {
+  pthread_mutex_lock(&mutex_);
+  PollLocked();
+  uint64_t begin = events_;
+  pthread_mutex_unlock(&mutex_);
+  return begin;
+}
+
+bool DirectoryUsageCache::Watch(const std::string& directory,
+                                std::vector<int>* watches) {
+  if (fd_ < 0 || watches->size() >= kMaxWatchesPerTree)
+    return false;
+
+  pthread_mutex_lock(&mutex_);
+  int wd = inotify_add_watch(fd_, directory.c_str(), kWatchMask);
+  if (wd >= 0) {
+    references_[wd]++;
+    watches->push_back(wd);
+  }
+  pthread_mutex_unlock(&mutex_);
+  return wd >= 0;
+}
+
+void DirectoryUsageCache::Finish(const std::string& path, uint64_t begin,
+                                 const std::vector<int>& watches,
+                                 const picojson::object* usage) {
+  pthread_mutex_lock(&mutex_);
+  PollLocked();
+
+  bool changed = !usage;
+  for (size_t i = 0; i < watches.size() && !changed; ++i) {
+    std::map<int, uint64_t>::iterator last = last_event_.find(watches[i]);
+    changed = last != last_event_.end() && last->second > begin;
+  }
+
+  if (changed) {
+    ReleaseLocked(watches);
+  } else {
+    EntryMap::iterator old = entries_.find(path);
+    if (old != entries_.end())
+      EraseLocked(old);
+    if (entries_.size() >= kMaxEntries)
+      EraseLocked(entries_.find(order_.front()));
+
+    Entry& entry = entries_[path];
+    entry.usage = *usage;
+    entry.watches = watches;
+    order_.push_back(path);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+void DirectoryUsageCache::PollLocked() {
+  if (fd_ < 0)
+    return;
+
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+  while ((length = read(fd_, buffer, sizeof(buffer))) > 0) {
+    for (char* p = buffer; p < buffer + length;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(*event) + event->len;
+      events_++;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Everything may have changed, including trees being computed.
+        while (!entries_.empty())
+          EraseLocked(entries_.begin());
+        std::map<int, int>::iterator it;
+        for (it = references_.begin(); it != references_.end(); ++it)
+          last_event_[it->first] = events_;
+        continue;
+      }
+
+      // Also for IN_IGNORED: a watch removed while a job had added it
+      // again, for the same wd, makes that job's result unreliable.
+      if (references_.count(event->wd))
+        last_event_[event->wd] = events_;
+      InvalidateLocked(event->wd);
+    }
+  }
+}
+
+void DirectoryUsageCache::InvalidateLocked(int wd) {
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end()) {
+    EntryMap::iterator entry = it++;
+    const std::vector<int>& watches = entry->second.watches;
+    for (size_t i = 0; i < watches.size(); ++i) {
+      if (watches[i] == wd) {
+        EraseLocked(entry);
+        break;
+      }
+    }
+  }
+}
+
+void DirectoryUsageCache::EraseLocked(EntryMap::iterator entry) {
+  ReleaseLocked(entry->second.watches);
+  order_.remove(entry->first);
+  entries_.erase(entry);
+}
+
+void DirectoryUsageCache::ReleaseLocked(const std::vector<int>& watches) {
+  for (size_t i = 0; i < watches.size(); ++i) {
+    std::map<int, int>::iterator reference = references_.find(watches[i]);
+    if (reference == references_.end() || --reference->second > 0)
+      continue;
+    references_.erase(reference);
+    last_event_.erase(watches[i]);
+    inotify_rm_watch(fd_, watches[i]);
+  }
+}
+
+UsageJob::UsageJob(const picojson::value& msg, const std::string& path,
+                   DirectoryUsageCache* cache)
+    : FilesystemJob(msg),
+      path_(path),
+      cache_(cache),
+      cacheable_(true),
+      allocated_bytes_(0),
+      directories_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+UsageJob::~UsageJob() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+void UsageJob::Execute() {
+  uint64_t begin = cache_->Begin();
+  TreeWalker walker(pool(), this, WorkerPool::DefaultThreadCount() * 2);
+  walker.Walk(path_);
+
+  if (IsCancelled()) {
+    cache_->Finish(path_, begin, watches_, NULL);
+    return;
+  }
+
+  picojson::object extensions;
+  std::map<std::string, Totals>::const_iterator it;
+  for (it = extensions_.begin(); it != extensions_.end(); ++it) {
+    picojson::object totals;
+    totals["files"] = ToJSON(it->second.files);
+    totals["bytes"] = ToJSON(it->second.bytes);
+    extensions[it->first] = picojson::value(totals);
+  }
+
+  picojson::object usage;
+  usage["bytes"] = ToJSON(totals_.bytes);
+  usage["allocatedBytes"] = ToJSON(allocated_bytes_);
+  usage["files"] = ToJSON(totals_.files);
+  usage["directories"] = ToJSON(directories_);
+  usage["extensions"] = picojson::value(extensions);
+
+  cache_->Finish(path_, begin, watches_, cacheable_ ? &usage : NULL);
+  result()["value"] = picojson::value(usage);
+}
+
+// Watched before its entries are read, so no change can be missed.
+bool UsageJob::EnterDirectory(int fd, const std::string& path) {
+  pthread_mutex_lock(&mutex_);
+  if (cacheable_)
+    cacheable_ = cache_->Watch(path, &watches_);
+  if (path.size() != path_.size())
+    directories_++;
+  pthread_mutex_unlock(&mutex_);
+  return true;
+}
+
+void UsageJob::VisitEntry(int dir_fd, const char* name,
+                          const std::string& path, unsigned char type) {
+  struct stat st;
+  if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+    return;
+  std::string extension = ExtensionOf(name);
+
+  pthread_mutex_lock(&mutex_);
+  totals_.files++;
+  totals_.bytes += st.st_size;
+  allocated_bytes_ += static_cast<uint64_t>(st.st_blocks) * 512;
+  Totals& totals = extensions_[extension];
+  totals.files++;
+  totals.bytes += st.st_size;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void UsageJob::OnError(const std::string& path, int error) {
+  if (path.size() == path_.size())
+    Fail(error == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+}
+
+bool UsageJob::ShouldStop() const {
+  return IsCancelled();
+}
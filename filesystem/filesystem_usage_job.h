@@ -0,0 +1,110 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_USAGE_JOB_H_
+#define FILESYSTEM_FILESYSTEM_USAGE_JOB_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/picojson.h"
+#include "common/utils.h"
+#include "filesystem/filesystem_job.h"
+#include "filesystem/filesystem_tree_walker.h"
+
+// The usage of the directories computed lately, each valid until something
+// changes below it. Every directory of a computed tree is watched with
+// inotify, the watches being referenced by the entries and by the jobs
+// computing them; the events are drained on each call, no thread or main
+// loop is involved. Can be called from any thread.
+class DirectoryUsageCache {
+ public:
+  DirectoryUsageCache();
+  ~DirectoryUsageCache();
+
+  // False if the usage of |path| is not known or out of date.
+  bool Lookup(const std::string& path, picojson::object* usage);
+
+  // A computation starts with Begin(), watches each directory before
+  // reading it, and ends with Finish(), with the usage or NULL on failure.
+  // The usage is only kept if none of the directories changed meanwhile.
+  uint64_t Begin();
+  // Returns false when the tree can't be watched, it won't be cached then.
+  bool Watch(const std::string& directory, std::vector<int>* watches);
+  void Finish(const std::string& path, uint64_t begin,
+              const std::vector<int>& watches,
+              const picojson::object* usage);
+
+ private:
+  struct Entry {
+    picojson::object usage;
+    std::vector<int> watches;
+  };
+  typedef std::map<std::string, Entry> EntryMap;
+
+  void PollLocked();
+  void InvalidateLocked(int wd);
+  void EraseLocked(EntryMap::iterator entry);
+  void ReleaseLocked(const std::vector<int>& watches);
+
+  pthread_mutex_t mutex_;
+  int fd_;
+  EntryMap entries_;
+  // Least recently stored first.
+  std::list<std::string> order_;
+  // References to each watch descriptor, from entries and running jobs.
+  std::map<int, int> references_;
+  // The event count when each referenced watch last had an event.
+  std::map<int, uint64_t> last_event_;
+  uint64_t events_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryUsageCache);
+};
+
+// Computes the usage of a directory tree: the bytes and blocks of its files,
+// the number of files and directories, and the files and bytes per
+// lowercase extension. The entries are lstat()ed relative to their
+// directory, subtrees in parallel. The result goes to |cache|.
+class UsageJob : public FilesystemJob, public TreeWalker::Visitor {
+ public:
+  UsageJob(const picojson::value& msg, const std::string& path,
+           DirectoryUsageCache* cache);
+  virtual ~UsageJob();
+
+ protected:
+  /* FilesystemJob implementation */
+  virtual void Execute();
+
+  /* TreeWalker::Visitor implementation */
+  virtual bool EnterDirectory(int fd, const std::string& path);
+  virtual void VisitEntry(int dir_fd, const char* name,
+                          const std::string& path, unsigned char type);
+  virtual void OnError(const std::string& path, int error);
+  virtual bool ShouldStop() const;
+
+ private:
+  struct Totals {
+    Totals() : files(0), bytes(0) {}
+    uint64_t files;
+    uint64_t bytes;
+  };
+
+  std::string path_;
+  DirectoryUsageCache* cache_;
+
+  pthread_mutex_t mutex_;
+  bool cacheable_;
+  std::vector<int> watches_;
+  Totals totals_;
+  uint64_t allocated_bytes_;
+  uint64_t directories_;
+  std::map<std::string, Totals> extensions_;
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_USAGE_JOB_H_
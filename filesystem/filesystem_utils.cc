@@ -0,0 +1,77 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_utils.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace filesystem {
+
+bool IsWritable(const struct stat& st) {
+  if (st.st_mode & S_IWOTH)
+    return true;
+  if ((st.st_mode & S_IWUSR) && geteuid() == st.st_uid)
+    return true;
+  if ((st.st_mode & S_IWGRP) && getegid() == st.st_gid)
+    return true;
+  return false;
+}
+
+picojson::object StatToJSON(const struct stat& st) {
+  picojson::object o;
+  o["size"] = picojson::value(static_cast<double>(st.st_size));
+  o["modified"] = picojson::value(static_cast<double>(st.st_mtime));
+  o["created"] = picojson::value(static_cast<double>(st.st_ctime));  // ?
+  o["readOnly"] = picojson::value(!IsWritable(st));
+  o["isFile"] = picojson::value(!!S_ISREG(st.st_mode));
+  o["isDirectory"] = picojson::value(!!S_ISDIR(st.st_mode));
+  return o;
+}
+
+std::string FileURIFromPath(const std::string& path) {
+  static const char kHex[] = "0123456789ABCDEF";
+  std::string uri("file://");
+  for (size_t i = 0; i < path.size(); ++i) {
+    unsigned char c = path[i];
+    if (isalnum(c) || c == '/' || c == '-' || c == '.' || c == '_' ||
+        c == '~') {
+      uri.push_back(c);
+    } else {
+      uri.push_back('%');
+      uri.push_back(kHex[c >> 4]);
+      uri.push_back(kHex[c & 0xf]);
+    }
+  }
+  return uri;
+}
+
+std::string FormatHTTPDate(time_t time) {
+  // Not strftime(), the names must not depend on the locale.
+  static const char* kDays[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+  };
+  static const char* kMonths[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+  };
+  struct tm tm;
+  gmtime_r(&time, &tm);
+  char date[32];
+  snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+           kDays[tm.tm_wday], tm.tm_mday, kMonths[tm.tm_mon],
+           tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+  return date;
+}
+
+bool IsPathInside(const std::string& path, const std::string& directory) {
+  if (path.compare(0, directory.size(), directory) != 0)
+    return false;
+  // "/opt/usr/media2" is not in "/opt/usr/media".
+  return path.size() == directory.size() || path[directory.size()] == '/' ||
+         directory == "/";
+}
+
+}  // namespace filesystem
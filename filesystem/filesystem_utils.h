@@ -0,0 +1,35 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_UTILS_H_
+#define FILESYSTEM_FILESYSTEM_UTILS_H_
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include <string>
+
+#include "common/picojson.h"
+
+namespace filesystem {
+
+bool IsWritable(const struct stat& st);
+
+// The attributes of a File, as returned by FileStat.
+picojson::object StatToJSON(const struct stat& st);
+
+// A file:// URI for an absolute path, with the bytes other than unreserved
+// characters and '/' percent-encoded.
+std::string FileURIFromPath(const std::string& path);
+
+// Whether |path| is |directory| or below it. Both are canonical paths, as
+// returned by realpath().
+bool IsPathInside(const std::string& path, const std::string& directory);
+
+// An RFC 7231 date, as used by Last-Modified.
+std::string FormatHTTPDate(time_t time);
+
+}  // namespace filesystem
+
+#endif  // FILESYSTEM_FILESYSTEM_UTILS_H_
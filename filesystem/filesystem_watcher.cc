@@ -0,0 +1,379 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_watcher.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/picojson.h"
+#include "filesystem/filesystem_tree_walker.h"
+
+namespace {
+
+const char kCmdWatchEvents[] = "FileWatchEvents";
+const guint kCoalesceInterval = 100;  // ms
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB |
+    IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+    IN_EXCL_UNLINK | IN_ONLYDIR;
+const int kDirectoryFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+// By DirectoryWatcher::EventType.
+const char* kEventTypes[] = { "created", "modified", "deleted", "overflow" };
+
+std::string StripTrailingSlashes(const std::string& path) {
+  size_t end = path.find_last_not_of('/');
+  if (end == std::string::npos)
+    return path.empty() ? path : "/";
+  return path.substr(0, end + 1);
+}
+
+}  // namespace
+
+DirectoryWatcher::DirectoryWatcher(ContextAPI* api)
+    : api_(api),
+      fd_(-1),
+      io_watch_id_(0),
+      timeout_id_(0),
+      next_watch_id_(1) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+  pthread_mutex_lock(&mutex_);
+  if (io_watch_id_)
+    g_source_remove(io_watch_id_);
+  if (timeout_id_)
+    g_source_remove(timeout_id_);
+  if (fd_ >= 0)
+    close(fd_);
+
+  std::map<int, Watch*>::iterator it;
+  for (it = watches_.begin(); it != watches_.end(); ++it)
+    delete it->second;
+  pthread_mutex_unlock(&mutex_);
+
+  pthread_mutex_destroy(&mutex_);
+}
+
+int DirectoryWatcher::AddWatch(const std::string& real_path,
+                               const std::string& virtual_path,
+                               bool recursive) {
+  pthread_mutex_lock(&mutex_);
+  if (!StartReading()) {
+    pthread_mutex_unlock(&mutex_);
+    return -1;
+  }
+
+  Watch* watch = new Watch;
+  watch->id = next_watch_id_++;
+  watch->real_root = StripTrailingSlashes(real_path);
+  watch->virtual_root = StripTrailingSlashes(virtual_path);
+  watch->recursive = recursive;
+  watches_[watch->id] = watch;
+
+  if (!AddDirectory(watch, watch->real_root) ||
+      (recursive && !AddTree(watch, watch->real_root, false))) {
+    int error = errno;
+    RemoveWatchLocked(watch->id);
+    pthread_mutex_unlock(&mutex_);
+    errno = error;
+    return -1;
+  }
+
+  int id = watch->id;
+  pthread_mutex_unlock(&mutex_);
+  return id;
+}
+
+bool DirectoryWatcher::RemoveWatch(int id) {
+  pthread_mutex_lock(&mutex_);
+  bool removed = RemoveWatchLocked(id);
+  pthread_mutex_unlock(&mutex_);
+  return removed;
+}
+
+bool DirectoryWatcher::RemoveWatchLocked(int id) {
+  std::map<int, Watch*>::iterator it = watches_.find(id);
+  if (it == watches_.end())
+    return false;
+
+  Watch* watch = it->second;
+  std::set<int> descriptors = watch->descriptors;
+  for (std::set<int>::iterator wd = descriptors.begin();
+       wd != descriptors.end(); ++wd)
+    RemoveDescriptor(watch, *wd);
+
+  watches_.erase(it);
+  delete watch;
+  return true;
+}
+
+bool DirectoryWatcher::StartReading() {
+  if (fd_ >= 0)
+    return true;
+
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ < 0)
+    return false;
+
+  GIOChannel* channel = g_io_channel_unix_new(fd_);
+  io_watch_id_ = g_io_add_watch(channel,
+      static_cast<GIOCondition>(G_IO_IN | G_IO_ERR | G_IO_HUP),
+      DirectoryWatcher::OnInotifyEvent,
+      static_cast<gpointer>(this));
+  g_io_channel_unref(channel);
+  return true;
+}
+
+bool DirectoryWatcher::AddDirectory(Watch* watch, const std::string& path) {
+  int wd = inotify_add_watch(fd_, path.c_str(), kWatchMask);
+  if (wd < 0)
+    return false;
+
+  Directory& directory = directories_[wd];
+  directory.path = path;
+  directory.watches.insert(watch->id);
+  watch->descriptors.insert(wd);
+  return true;
+}
+
+bool DirectoryWatcher::AddTree(Watch* watch, const std::string& path,
+                               bool report) {
+  std::vector<std::string> stack(1, path);
+  while (!stack.empty()) {
+    std::string dir_path = stack.back();
+    stack.pop_back();
+
+    int fd = open(dir_path.c_str(), kDirectoryFlags);
+    if (fd < 0)
+      continue;  // Already gone.
+
+    DirectoryReader reader(fd);
+    const char* name;
+    unsigned char type;
+    while (reader.Next(&name, &type)) {
+      if (type == DT_UNKNOWN) {
+        struct stat st;
+        if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+          type = IFTODT(st.st_mode);
+      }
+
+      std::string child = dir_path + "/" + name;
+      // Created before its parent was watched, never reported otherwise.
+      if (report)
+        QueueEvent(watch, EVENT_CREATED, child, type == DT_DIR);
+      if (type != DT_DIR)
+        continue;
+
+      if (!AddDirectory(watch, child)) {
+        if (errno == ENOSPC) {
+          close(fd);
+          return false;
+        }
+        continue;
+      }
+      stack.push_back(child);
+    }
+    close(fd);
+  }
+  return true;
+}
+
+void DirectoryWatcher::RemoveDescriptor(Watch* watch, int wd) {
+  watch->descriptors.erase(wd);
+
+  std::map<int, Directory>::iterator it = directories_.find(wd);
+  if (it == directories_.end())
+    return;
+  it->second.watches.erase(watch->id);
+  if (it->second.watches.empty()) {
+    inotify_rm_watch(fd_, wd);
+    directories_.erase(it);
+  }
+}
+
+void DirectoryWatcher::RemoveTree(Watch* watch, const std::string& path) {
+  std::string prefix = path + "/";
+  std::set<int> descriptors = watch->descriptors;
+  for (std::set<int>::iterator wd = descriptors.begin();
+       wd != descriptors.end(); ++wd) {
+    const std::string& dir_path = directories_[*wd].path;
+    if (dir_path == path || !dir_path.compare(0, prefix.size(), prefix))
+      RemoveDescriptor(watch, *wd);
+  }
+}
+
+void DirectoryWatcher::ReadEvents() {
+  char buffer[64 * 1024]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+  while ((length = read(fd_, buffer, sizeof(buffer))) > 0) {
+    for (char* p = buffer; p < buffer + length;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(*event) + event->len;
+      HandleEvent(event->wd, event->mask, event->len ? event->name : NULL);
+    }
+  }
+
+  if (!pending_.empty() && !timeout_id_)
+    timeout_id_ = g_timeout_add(kCoalesceInterval,
+                                DirectoryWatcher::OnCoalesceTimeout,
+                                static_cast<gpointer>(this));
+}
+
+void DirectoryWatcher::HandleEvent(int wd, uint32_t mask, const char* name) {
+  if (mask & IN_Q_OVERFLOW) {
+    // Events were lost, the application has to list the directories again.
+    std::map<int, Watch*>::iterator it;
+    for (it = watches_.begin(); it != watches_.end(); ++it)
+      QueueEvent(it->second, EVENT_OVERFLOW, it->second->real_root, true);
+    return;
+  }
+
+  std::map<int, Directory>::iterator dir = directories_.find(wd);
+  if (dir == directories_.end())
+    return;
+
+  if (mask & IN_IGNORED) {
+    std::set<int> watch_ids = dir->second.watches;
+    directories_.erase(dir);
+    for (std::set<int>::iterator id = watch_ids.begin();
+         id != watch_ids.end(); ++id)
+      watches_[*id]->descriptors.erase(wd);
+    return;
+  }
+
+  std::string path = dir->second.path;
+  if (name)
+    path += std::string("/") + name;
+  bool is_directory = mask & IN_ISDIR;
+
+  // Adding or removing descriptors below may change the directory's set.
+  std::set<int> watch_ids = dir->second.watches;
+  for (std::set<int>::iterator id = watch_ids.begin();
+       id != watch_ids.end(); ++id) {
+    Watch* watch = watches_[*id];
+
+    if (mask & (IN_CREATE | IN_MOVED_TO)) {
+      QueueEvent(watch, EVENT_CREATED, path, is_directory);
+      if (is_directory && watch->recursive && AddDirectory(watch, path))
+        AddTree(watch, path, true);
+    } else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+      QueueEvent(watch, EVENT_DELETED, path, is_directory);
+      // A deleted directory's descriptor goes away with IN_IGNORED.
+      if (is_directory && (mask & IN_MOVED_FROM))
+        RemoveTree(watch, path);
+    } else if (mask & (IN_MODIFY | IN_ATTRIB)) {
+      QueueEvent(watch, EVENT_MODIFIED, path, is_directory);
+    } else if ((mask & (IN_DELETE_SELF | IN_MOVE_SELF)) &&
+               path == watch->real_root) {
+      // Below the root, the event on the parent reported it.
+      QueueEvent(watch, EVENT_DELETED, path, true);
+    }
+  }
+}
+
+void DirectoryWatcher::QueueEvent(Watch* watch, EventType type,
+                                  const std::string& real_path,
+                                  bool is_directory) {
+  std::string path =
+      watch->virtual_root + real_path.substr(watch->real_root.size());
+
+  if (type == EVENT_OVERFLOW) {
+    Event event = { watch->id, type, path, is_directory };
+    pending_.push_back(event);
+    return;
+  }
+
+  std::pair<int, std::string> key(watch->id, path);
+  std::map<std::pair<int, std::string>, size_t>::iterator it =
+      pending_index_.find(key);
+  if (it == pending_index_.end()) {
+    Event event = { watch->id, type, path, is_directory };
+    pending_index_[key] = pending_.size();
+    pending_.push_back(event);
+    return;
+  }
+
+  Event& event = pending_[it->second];
+  switch (event.type) {
+    case EVENT_CREATED:
+      // Nothing to report about a file that came and went.
+      if (type == EVENT_DELETED) {
+        event.type = EVENT_NONE;
+        pending_index_.erase(it);
+      }
+      break;
+    case EVENT_DELETED:
+      // Replaced by another file.
+      if (type != EVENT_DELETED)
+        event.type = EVENT_MODIFIED;
+      break;
+    default:
+      if (type == EVENT_DELETED)
+        event.type = EVENT_DELETED;
+      break;
+  }
+  event.is_directory = is_directory;
+}
+
+void DirectoryWatcher::FlushEvents() {
+  std::map<int, picojson::array> events;
+  for (size_t i = 0; i < pending_.size(); ++i) {
+    const Event& event = pending_[i];
+    if (event.type == EVENT_NONE || !watches_.count(event.watch))
+      continue;
+
+    picojson::object o;
+    o["type"] = picojson::value(kEventTypes[event.type]);
+    o["fullPath"] = picojson::value(event.path);
+    o["isDirectory"] = picojson::value(event.is_directory);
+    events[event.watch].push_back(picojson::value(o));
+  }
+  pending_.clear();
+  pending_index_.clear();
+
+  std::map<int, picojson::array>::iterator it;
+  for (it = events.begin(); it != events.end(); ++it) {
+    picojson::object message;
+    message["cmd"] = picojson::value(kCmdWatchEvents);
+    message["watchId"] = picojson::value(static_cast<double>(it->first));
+    message["events"] = picojson::value(it->second);
+    api_->PostMessage(picojson::value(message).serialize().c_str());
+  }
+}
+
+gboolean DirectoryWatcher::OnInotifyEvent(GIOChannel* channel,
+                                          GIOCondition condition,
+                                          gpointer user_data) {
+  DirectoryWatcher* watcher = static_cast<DirectoryWatcher*>(user_data);
+
+  pthread_mutex_lock(&watcher->mutex_);
+  if (condition & (G_IO_ERR | G_IO_HUP)) {
+    watcher->io_watch_id_ = 0;
+    pthread_mutex_unlock(&watcher->mutex_);
+    return FALSE;
+  }
+  watcher->ReadEvents();
+  pthread_mutex_unlock(&watcher->mutex_);
+
+  return TRUE;
+}
+
+gboolean DirectoryWatcher::OnCoalesceTimeout(gpointer user_data) {
+  DirectoryWatcher* watcher = static_cast<DirectoryWatcher*>(user_data);
+
+  pthread_mutex_lock(&watcher->mutex_);
+  watcher->timeout_id_ = 0;
+  watcher->FlushEvents();
+  pthread_mutex_unlock(&watcher->mutex_);
+
+  return FALSE;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_WATCHER_H_
+#define FILESYSTEM_FILESYSTEM_WATCHER_H_
+
+#include <glib.h>
+#include <pthread.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/extension_adapter.h"
+#include "common/utils.h"
+
+// Watches directories for changes with a single inotify fd, read from the
+// GLib main loop. The changes are reported to JavaScript as "FileWatchEvents"
+// messages with the virtual paths of the entries, and coalesced over
+// kCoalesceInterval: a burst of writes to a file is one "modified" event, and
+// a file created and deleted in between is not reported at all.
+class DirectoryWatcher {
+ public:
+  explicit DirectoryWatcher(ContextAPI* api);
+  ~DirectoryWatcher();
+
+  // Watches the directory at |real_path|, known to JavaScript as
+  // |virtual_path|, and with |recursive| every directory below it,
+  // including those created later. Returns the id of the watch, or -1 with
+  // errno set.
+  int AddWatch(const std::string& real_path, const std::string& virtual_path,
+               bool recursive);
+  bool RemoveWatch(int id);
+
+ private:
+  struct Watch {
+    int id;
+    std::string real_root;
+    std::string virtual_root;
+    bool recursive;
+    std::set<int> descriptors;
+  };
+
+  // An inotify watch descriptor, shared by the watches that overlap on it.
+  struct Directory {
+    std::string path;
+    std::set<int> watches;
+  };
+
+  // Named by kEventTypes.
+  enum EventType {
+    EVENT_CREATED,
+    EVENT_MODIFIED,
+    EVENT_DELETED,
+    EVENT_OVERFLOW,
+    EVENT_NONE,
+  };
+
+  struct Event {
+    int watch;
+    EventType type;
+    std::string path;
+    bool is_directory;
+  };
+
+  bool RemoveWatchLocked(int id);
+  bool StartReading();
+  bool AddDirectory(Watch* watch, const std::string& path);
+  // Adds the directories below |path|, reporting their entries as created
+  // when |report| is set.
+  bool AddTree(Watch* watch, const std::string& path, bool report);
+  void RemoveDescriptor(Watch* watch, int wd);
+  void RemoveTree(Watch* watch, const std::string& path);
+
+  void ReadEvents();
+  void HandleEvent(int wd, uint32_t mask, const char* name);
+  void QueueEvent(Watch* watch, EventType type, const std::string& real_path,
+                  bool is_directory);
+  void FlushEvents();
+
+  static gboolean OnInotifyEvent(GIOChannel* channel, GIOCondition condition,
+                                 gpointer user_data);
+  static gboolean OnCoalesceTimeout(gpointer user_data);
+
+  ContextAPI* api_;
+  pthread_mutex_t mutex_;
+  int fd_;
+  guint io_watch_id_;
+  guint timeout_id_;
+  int next_watch_id_;
+
+  std::map<int, Watch*> watches_;
+  std::map<int, Directory> directories_;
+
+  // In arrival order. Events on the same path are merged in place.
+  std::vector<Event> pending_;
+  std::map<std::pair<int, std::string>, size_t> pending_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryWatcher);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_WATCHER_H_
@@ -0,0 +1,103 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/filesystem_worker_pool.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int max_threads)
+    : max_threads_(std::max(max_threads, 1)),
+      idle_threads_(0),
+      quit_(false) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&cond_, NULL);
+}
+
+WorkerPool::~WorkerPool() {
+  pthread_mutex_lock(&mutex_);
+  quit_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+
+  for (size_t i = 0; i < threads_.size(); ++i)
+    pthread_join(threads_[i], NULL);
+
+  pthread_cond_destroy(&cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void WorkerPool::Post(Task* task, TaskGroup* group) {
+  pthread_mutex_lock(&mutex_);
+  task->group_ = group;
+  if (group)
+    group->pending_++;
+  queue_.push_back(task);
+
+  if (idle_threads_ == 0 && threads_.size() < max_threads_) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ThreadMain, this) == 0)
+      threads_.push_back(thread);
+  }
+
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void WorkerPool::Wait(TaskGroup* group) {
+  pthread_mutex_lock(&mutex_);
+  while (group->pending_ > 0) {
+    if (!queue_.empty()) {
+      Task* task = queue_.front();
+      queue_.pop_front();
+      RunTaskLocked(task);
+      continue;
+    }
+    pthread_cond_wait(&cond_, &mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+// static
+int WorkerPool::DefaultThreadCount() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);  // NOLINT
+  return std::min(std::max(static_cast<int>(cpus), 2), 8);
+}
+
+// static
+void* WorkerPool::ThreadMain(void* data) {
+  WorkerPool* pool = static_cast<WorkerPool*>(data);
+
+  pthread_mutex_lock(&pool->mutex_);
+  while (true) {
+    if (!pool->queue_.empty()) {
+      Task* task = pool->queue_.front();
+      pool->queue_.pop_front();
+      pool->RunTaskLocked(task);
+      continue;
+    }
+    if (pool->quit_)
+      break;
+
+    pool->idle_threads_++;
+    pthread_cond_wait(&pool->cond_, &pool->mutex_);
+    pool->idle_threads_--;
+  }
+  pthread_mutex_unlock(&pool->mutex_);
+
+  return NULL;
+}
+
+// Called with |mutex_| held, which is released while the task runs.
+void WorkerPool::RunTaskLocked(Task* task) {
+  pthread_mutex_unlock(&mutex_);
+  TaskGroup* group = task->group_;
+  task->Run();
+  delete task;
+  pthread_mutex_lock(&mutex_);
+
+  if (group && --group->pending_ == 0)
+    pthread_cond_broadcast(&cond_);
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILESYSTEM_WORKER_POOL_H_
+#define FILESYSTEM_FILESYSTEM_WORKER_POOL_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+#include "common/utils.h"
+
+// Runs tasks on a bounded number of threads, started on demand. A task can
+// fan out more tasks into a TaskGroup and wait for them: the waiting thread
+// runs queued tasks meanwhile, so nested waits never starve the pool.
+class WorkerPool {
+ public:
+  class TaskGroup {
+   public:
+    TaskGroup() : pending_(0) {}
+
+   private:
+    friend class WorkerPool;
+    int pending_;
+  };
+
+  class Task {
+   public:
+    Task() : group_(NULL) {}
+    virtual ~Task() {}
+    virtual void Run() = 0;
+
+   private:
+    friend class WorkerPool;
+    TaskGroup* group_;
+  };
+
+  explicit WorkerPool(int max_threads);
+  // Runs the tasks still queued, then joins the threads.
+  ~WorkerPool();
+
+  // Takes ownership of |task|, deleted once it has run.
+  void Post(Task* task, TaskGroup* group = NULL);
+
+  // Returns when every task posted to |group| has run.
+  void Wait(TaskGroup* group);
+
+  // One thread per online CPU, between 2 and 8.
+  static int DefaultThreadCount();
+
+ private:
+  static void* ThreadMain(void* data);
+  void RunTaskLocked(Task* task);
+
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  std::deque<Task*> queue_;
+  std::vector<pthread_t> threads_;
+  size_t max_threads_;
+  int idle_threads_;
+  bool quit_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+#endif  // FILESYSTEM_FILESYSTEM_WORKER_POOL_H_
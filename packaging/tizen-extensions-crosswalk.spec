@@ -56,6 +56,7 @@ BuildRequires: pkgconfig(pkgmgr)
 BuildRequires: pkgconfig(pkgmgr-info)
 BuildRequires: pkgconfig(pmapi)
 BuildRequires: pkgconfig(vconf)
+BuildRequires: pkgconfig(zlib)
 %if %{with wayland}
 BuildRequires: pkgconfig(wayland-client)
 %else
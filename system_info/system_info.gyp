@@ -48,6 +48,14 @@
             ]
           },
         }],
+        [ 'display_type == "x11"', {
+          'variables': {
+            'packages': [
+              'x11',
+              'xrandr',
+            ]
+          },
+        }],
       ],
       'variables': {
         'packages': [
@@ -75,6 +83,7 @@
         'system_info_device_orientation.h',
         'system_info_device_orientation_desktop.cc',
         'system_info_device_orientation_tizen.cc',
+        'system_info_display.cc',
         'system_info_display.h',
         'system_info_display_wayland.cc',
         'system_info_display_x11.cc',
@@ -88,6 +97,8 @@
         'system_info_network.cc',
         'system_info_network.h',
         'system_info_network_desktop.cc',
+        'system_info_network_manager.h',
+        'system_info_network_manager_desktop.cc',
         'system_info_network_tizen.cc',
         'system_info_peripheral.h',
         'system_info_peripheral_desktop.cc',
@@ -107,4 +118,38 @@
       ],
     },
   ],
+  'conditions': [
+    ['build_benchmarks == 1', {
+      'targets': [
+        {
+          'target_name': 'system_info_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'tizen_system_info',
+          ],
+          'variables': {
+            'packages': [
+              'glib-2.0',
+            ]
+          },
+          'includes': [
+            '../common/pkg-config.gypi',
+          ],
+          'ldflags': [
+            # Lets the counting allocators override the ones of the C library
+            # for the dlopen()ed extension module.
+            '-rdynamic',
+          ],
+          'libraries': [
+            '-ldl',
+          ],
+          'sources': [
+            'system_info_benchmark.cc',
+            '../common/extension_benchmark.cc',
+            '../common/extension_benchmark.h',
+          ],
+        },
+      ],
+    }],
+  ],
 }
@@ -50,71 +50,39 @@ function _createConstClone(obj) {
   return const_obj;
 }
 
-var _checkThreshold = function(value, highThreshold, lowThreshold) {
-  if ((highThreshold && (highThreshold >= 0) && (value >= highThreshold)) ||
-      (lowThreshold && (lowThreshold >= 0) && (value <= lowThreshold)))
-    return true;
-
-  return false;
+var _stopListening = function(listenerId) {
+  var msg = {
+    'cmd': 'stopListening',
+    'prop': _listeners[listenerId]['prop'],
+    'listenerId': listenerId
+  };
+  delete _listeners[listenerId];
+  extension.postMessage(JSON.stringify(msg));
 };
 
 extension.setMessageListener(function(json) {
   var msg = JSON.parse(json);
 
-  // For listeners
+  // For listeners, thresholds and minimum delta/interval are already applied
+  // natively and msg.listeners holds the ids of the listeners to notify.
   if (msg.cmd == 'SystemInfoPropertyValueChanged') {
-    if (msg.prop && (0 !== msg.prop.length)) {
-      for (var id in _listeners) {
-        if (_listeners[id]['prop'] === msg.prop) {
-          var option = _listeners[id]['option'];
-          if (option) {
-            var currentTime = (new Date()).valueOf();
-            var timeout = parseFloat(option['timeout']);
-            var highThreshold = parseFloat(option['highThreshold']);
-            var lowThreshold = parseFloat(option['lowThreshold']);
-            var timeStamp = parseFloat(_listeners[id]['timestamp']);
-            if (timeout && (currentTime - timeStamp) > timeout) {
-              delete _listeners[id];
-              if (!_hasListener(msg.prop)) {
-                var message = {
-                  'cmd': 'stopListening',
-                  'prop': msg.prop
-                };
-                extension.postMessage(JSON.stringify(message));
-                return;
-              }
-              continue;
-            }
-            switch (msg.prop) {
-              case 'BATTERY':
-                if (_checkThreshold(msg.data.level, highThreshold, lowThreshold))
-                  _listeners[id]['callback'](_createConstClone(msg.data));
-                break;
-              case 'CPU':
-                if (_checkThreshold(msg.data.load, highThreshold, lowThreshold))
-                  _listeners[id]['callback'](_createConstClone(msg.data));
-                break;
-              case 'DISPLAY':
-                if (_checkThreshold(msg.data.brightness, highThreshold, lowThreshold))
-                  _listeners[id]['callback'](_createConstClone(msg.data));
-                break;
-              case 'STORAGE':
-              case 'DEVICE_ORIENTATION':
-              case 'BUILD':
-              case 'LOCALE':
-              case 'NETWORK':
-              case 'WIFI_NETWORK':
-              case 'CELLULAR_NETWORK':
-              case 'SIM':
-              case 'PERIPHERAL':
-                _listeners[id]['callback'](_createConstClone(msg.data));
-            }
-            _listeners[id]['timestamp'] = currentTime;
-            continue;
-          }
-          _listeners[id]['callback'](_createConstClone(msg.data));
+    var ids = msg.listeners || [];
+    for (var i = 0; i < ids.length; ++i) {
+      var listener = _listeners[ids[i]];
+      if (!listener)
+        continue;
+
+      var currentTime = (new Date()).valueOf();
+      var option = listener['option'];
+      if (option) {
+        var timeout = parseFloat(option['timeout']);
+        if (timeout && (currentTime - listener['timestamp']) > timeout) {
+          _stopListening(ids[i]);
+          continue;
         }
       }
+      listener['timestamp'] = currentTime;
+      listener['callback'](_createConstClone(msg.data));
     }
     return;
   }
@@ -176,16 +144,18 @@ exports.getPropertyValue = function(prop, successCallback, errorCallback) {
   });
 };
 
-var _hasListener = function(prop) {
-  var count = 0;
+var _listenerOptions = function(option) {
+  var options = {};
+  if (!option)
+    return options;
 
-  for (var i in _listeners) {
-    if (_listeners[i]['prop'] === prop) {
-      count += 1;
-    }
+  var keys = ['lowThreshold', 'highThreshold', 'minimumDelta', 'minimumInterval'];
+  for (var i = 0; i < keys.length; ++i) {
+    var value = parseFloat(option[keys[i]]);
+    if (!isNaN(value))
+      options[keys[i]] = value;
   }
-
-  return (0 !== count);
+  return options;
 };
 
 exports.addPropertyValueChangeListener = function(prop, successCallback, option) {
@@ -198,14 +168,6 @@ exports.addPropertyValueChangeListener = function(prop, successCallback, option)
   if (arguments.length == 3 && option !== null && (typeof option !== 'object'))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
-  if (!_hasListener(prop)) {
-    var msg = {
-      'cmd': 'startListening',
-      'prop': prop
-    };
-    extension.postMessage(JSON.stringify(msg));
-  }
-
   var timeStamp = (new Date()).valueOf();
   var listener = {
     'prop': prop,
@@ -218,6 +180,14 @@ exports.addPropertyValueChangeListener = function(prop, successCallback, option)
   _next_listener_id += 1;
   _listeners[listener_id] = listener;
 
+  var msg = {
+    'cmd': 'startListening',
+    'prop': prop,
+    'listenerId': listener_id,
+    'options': _listenerOptions(option)
+  };
+  extension.postMessage(JSON.stringify(msg));
+
   return listener_id;
 };
 
@@ -225,14 +195,8 @@ exports.removePropertyValueChangeListener = function(listenerId) {
   if (typeof listenerId !== 'number')
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
-  var prop = _listeners[listenerId]['prop'];
+  if (!_listeners[listenerId])
+    return;
 
-  delete _listeners[listenerId];
-  if (!_hasListener(prop)) {
-    var msg = {
-      'cmd': 'stopListening',
-      'prop': prop
-    };
-    extension.postMessage(JSON.stringify(msg));
-  }
+  _stopListening(listenerId);
 };
@@ -34,6 +34,9 @@ class SysInfoBattery : public SysInfoObject {
 
   static const std::string name_;
 
+ protected:
+  const char* ThresholdKey() const { return "level"; }
+
  private:
   explicit SysInfoBattery();
   bool Update(picojson::value& error);
@@ -0,0 +1,285 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Drives the getPropertyValue and listener paths of the system_info
+// extension, loaded as Crosswalk would load it, and reports latency and
+// allocations per property. It can run against the live system, a fixture
+// recorded with --record, or a generated pathological fixture.
+
+#include <errno.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "common/extension_benchmark.h"
+#include "common/picojson.h"
+
+#if defined(TIZEN)
+  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/psb-bl"
+#else
+  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/acpi_video0"
+#endif
+
+namespace {
+
+const char* kProperties[] = {
+  "BATTERY",
+  "BUILD",
+  "CELLULAR_NETWORK",
+  "CPU",
+  "DEVICE_ORIENTATION",
+  "DISPLAY",
+  "LOCALE",
+  "NETWORK",
+  "PERIPHERAL",
+  "STORAGE",
+  "WIFI_NETWORK",
+};
+
+const int kPathologicalMounts = 500;
+const size_t kPathologicalDmesgSize = 50 * 1024 * 1024;
+
+struct Options {
+  Options()
+      : module("libtizen_system_info.so"),
+        iterations(1000),
+        listen_ms(3000) {}
+
+  std::string module;
+  std::string sysroot;
+  std::string record;
+  std::string pathological;
+  int iterations;
+  int listen_ms;
+};
+
+void PrintUsage(const char* program) {
+  std::cerr << "Usage: " << program << " [options]\n"
+      << "  --module PATH        system_info extension module\n"
+      << "  --sysroot DIR        read system files from a recorded fixture\n"
+      << "  --record DIR         record the files read into DIR and exit\n"
+      << "  --pathological DIR   generate a fixture with "
+      << kPathologicalMounts << " mounts and a 50 MB dmesg in DIR\n"
+      << "                       and run against it\n"
+      << "  --iterations N       getPropertyValue calls per property\n"
+      << "  --listen-ms N        listening time per property\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      return false;
+
+    if (arg == "--module")
+      options.module = argv[++i];
+    else if (arg == "--sysroot")
+      options.sysroot = argv[++i];
+    else if (arg == "--record")
+      options.record = argv[++i];
+    else if (arg == "--pathological")
+      options.pathological = argv[++i];
+    else if (arg == "--iterations")
+      options.iterations = atoi(argv[++i]);
+    else if (arg == "--listen-ms")
+      options.listen_ms = atoi(argv[++i]);
+    else
+      return false;
+  }
+
+  return options.iterations > 0;
+}
+
+bool WriteFixtureFile(const std::string& root, const std::string& path,
+                      const std::string& content) {
+  std::string full_path = root + path;
+  for (size_t pos = full_path.find('/', 1); pos != std::string::npos;
+       pos = full_path.find('/', pos + 1)) {
+    if (mkdir(full_path.substr(0, pos).c_str(), 0755) && errno != EEXIST)
+      return false;
+  }
+
+  FILE* fp = fopen(full_path.c_str(), "w");
+  if (!fp)
+    return false;
+  size_t written = fwrite(content.data(), 1, content.size(), fp);
+  fclose(fp);
+
+  return written == content.size();
+}
+
+// Mount entries must point at real block devices and directories for the
+// storage path to go through udev and statvfs(), so the first real one is
+// repeated, like the bind mounts of a container host.
+std::string PathologicalMounts() {
+  std::string entry = "/dev/sda1 / ext4 rw,relatime 0 0\n";
+
+  FILE* fp = fopen("/proc/mounts", "r");
+  if (fp) {
+    char* line = NULL;
+    size_t length = 0;
+    while (getline(&line, &length, fp) != -1) {
+      if (line[0] == '/') {
+        entry = line;
+        break;
+      }
+    }
+    free(line);
+    fclose(fp);
+  }
+
+  std::string mounts;
+  for (int i = 0; i < kPathologicalMounts; ++i)
+    mounts += entry;
+  return mounts;
+}
+
+// The DMI line comes last, the worst case for the BUILD property.
+std::string PathologicalDmesg() {
+  const std::string filler =
+      "[    1.234567] usb 1-1: new high-speed USB device number 2 using "
+      "ehci-pci\n";
+
+  std::string dmesg;
+  dmesg.reserve(kPathologicalDmesgSize + 128);
+  while (dmesg.size() < kPathologicalDmesgSize)
+    dmesg += filler;
+  dmesg += "[    0.000000] DMI: Intel Corporation Benchmark Board, "
+           "BIOS 1.0 01/01/2014\n";
+  return dmesg;
+}
+
+bool GeneratePathologicalFixture(const std::string& root) {
+  return WriteFixtureFile(root, "/proc/stat",
+             "cpu  4705 356 584 3699 23 23 0 0 0 0\n") &&
+         WriteFixtureFile(root, "/proc/mounts", PathologicalMounts()) &&
+         WriteFixtureFile(root, "/var/log/dmesg", PathologicalDmesg()) &&
+         WriteFixtureFile(root, "/etc/timezone", "Europe/Helsinki\n") &&
+         WriteFixtureFile(root, ACPI_BACKLIGHT_DIR"/max_brightness", "15\n") &&
+         WriteFixtureFile(root, ACPI_BACKLIGHT_DIR"/actual_brightness",
+                          "10\n");
+}
+
+std::string GetPropertyValueMessage(const char* prop, int reply_id) {
+  picojson::object message;
+  message["cmd"] = picojson::value("getPropertyValue");
+  message["prop"] = picojson::value(prop);
+  std::ostringstream id;
+  id << reply_id;
+  message["_reply_id"] = picojson::value(id.str());
+  return picojson::value(message).serialize();
+}
+
+std::string ListeningMessage(const char* cmd, const char* prop) {
+  picojson::object message;
+  message["cmd"] = picojson::value(cmd);
+  message["prop"] = picojson::value(prop);
+  message["listenerId"] = picojson::value(0.0);
+  message["options"] = picojson::value(picojson::object());
+  return picojson::value(message).serialize();
+}
+
+void BenchmarkGet(XW_Instance instance, const char* prop, int iterations) {
+  benchmark::ExtensionHost& host = benchmark::ExtensionHost::GetInstance();
+
+  // The first call pays for the platform query, later ones may be served
+  // from the property cache.
+  benchmark::Measurement cold(std::string(prop) + ".get.cold");
+  cold.Start();
+  host.PostMessage(instance, GetPropertyValueMessage(prop, 0));
+  cold.Stop();
+  cold.Print();
+
+  benchmark::Measurement warm(std::string(prop) + ".get");
+  for (int i = 1; i <= iterations; ++i) {
+    std::string message = GetPropertyValueMessage(prop, i);
+    warm.Start();
+    host.PostMessage(instance, message);
+    warm.Stop();
+  }
+  warm.Print();
+}
+
+void BenchmarkListener(XW_Instance instance, const char* prop, int listen_ms) {
+  benchmark::ExtensionHost& host = benchmark::ExtensionHost::GetInstance();
+  benchmark::Measurement dispatch(std::string(prop) + ".listen.dispatch");
+
+  uint64_t messages = host.message_count();
+  host.PostMessage(instance, ListeningMessage("startListening", prop));
+
+  // Each main loop dispatch covers the platform update and the filtering
+  // and posting of the change.
+  int64_t deadline = benchmark::NowMicroseconds() +
+                     static_cast<int64_t>(listen_ms) * 1000;
+  while (benchmark::NowMicroseconds() < deadline) {
+    if (!g_main_context_pending(NULL)) {
+      g_usleep(1000);
+      continue;
+    }
+    dispatch.Start();
+    g_main_context_iteration(NULL, FALSE);
+    dispatch.Stop();
+  }
+
+  host.PostMessage(instance, ListeningMessage("stopListening", prop));
+  dispatch.Print();
+  std::cerr << prop << ": " << host.message_count() - messages
+            << " change messages in " << listen_ms << " ms\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  if (!options.pathological.empty()) {
+    if (!GeneratePathologicalFixture(options.pathological)) {
+      std::cerr << "Can't generate fixture in " << options.pathological
+                << "\n";
+      return 1;
+    }
+    options.sysroot = options.pathological;
+  }
+
+  // Read once by the extension, so they must be set before it is loaded.
+  if (!options.sysroot.empty())
+    setenv("SYSTEM_INFO_SYSROOT", options.sysroot.c_str(), 1);
+  if (!options.record.empty())
+    setenv("SYSTEM_INFO_RECORD_DIR", options.record.c_str(), 1);
+
+  benchmark::ExtensionHost& host = benchmark::ExtensionHost::GetInstance();
+  if (!host.Load(options.module))
+    return 1;
+  XW_Instance instance = host.CreateInstance();
+
+  const size_t count = sizeof(kProperties) / sizeof(kProperties[0]);
+  if (!options.record.empty()) {
+    // Every file read by a Get or a listener update is recorded.
+    for (size_t i = 0; i < count; ++i) {
+      host.PostMessage(instance, GetPropertyValueMessage(kProperties[i], 0));
+      BenchmarkListener(instance, kProperties[i], 0);
+    }
+    host.DestroyInstance(instance);
+    return 0;
+  }
+
+  benchmark::Measurement::PrintHeader();
+  for (size_t i = 0; i < count; ++i)
+    BenchmarkGet(instance, kProperties[i], options.iterations);
+  for (size_t i = 0; i < count; ++i)
+    BenchmarkListener(instance, kProperties[i], options.listen_ms);
+
+  host.DestroyInstance(instance);
+  return 0;
+}
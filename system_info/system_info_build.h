@@ -42,7 +42,10 @@ class SysInfoBuild : public SysInfoObject {
 
  private:
   explicit SysInfoBuild()
-      : timeout_cb_id_(0) {}
+      : timeout_cb_id_(0) {
+    // Hardware and build information do not change at runtime.
+    SetCacheTTL(kCacheForever);
+  }
 
   bool UpdateHardware();
   bool UpdateOSBuild();
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
@@ -41,22 +42,29 @@ void SysInfoBuild::Get(picojson::value& error,
 }
 
 bool SysInfoBuild::UpdateHardware() {
-  FILE* fp = fopen("/var/log/dmesg", "r");
+  FILE* fp = fopen(system_info::GetSysrootPath("/var/log/dmesg").c_str(), "r");
+  if (!fp)
+    return false;
 
-  int dmipos;
-  size_t length = 300;
+  // The DMI line is logged early during boot, stop at the first one instead
+  // of scanning the whole log.
+  size_t length = 0;
   char* cinfo = NULL;
-  std::string info;
-
-  do {
-    getline(&cinfo, &length, fp);
-    info = cinfo;
-    dmipos = info.find("] DMI: ", 0);
-  } while (dmipos == std::string::npos);
-  info.erase(0, dmipos + 7);
-  free(cinfo);
+  char* dmi = NULL;
+  while (getline(&cinfo, &length, fp) != -1) {
+    dmi = strstr(cinfo, "] DMI: ");
+    if (dmi)
+      break;
+  }
   fclose(fp);
 
+  if (!dmi) {
+    free(cinfo);
+    return false;
+  }
+  std::string info(dmi + 7);
+  free(cinfo);
+
   int head = 0;
   int tail = -1;
   std::string str;
@@ -59,7 +59,7 @@ void SysInfoCpu::StopListening() {
 }
 
 bool SysInfoCpu::UpdateLoad() {
-  FILE *fp = fopen("/proc/stat", "r");
+  FILE *fp = fopen(system_info::GetSysrootPath("/proc/stat").c_str(), "r");
   if (!fp)
     return false;
 
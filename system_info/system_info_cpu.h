@@ -33,6 +33,9 @@ class SysInfoCpu : public SysInfoObject {
 
   static const std::string name_;
 
+ protected:
+  const char* ThresholdKey() const { return "load"; }
+
  private:
   explicit SysInfoCpu()
       : load_(0.0),
@@ -0,0 +1,188 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "system_info/system_info_display.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common/picojson.h"
+
+#if defined(GENERIC_DESKTOP)
+  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/acpi_video0"
+#elif defined(TIZEN)
+  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/psb-bl"
+#else
+  #error "Unsupported platform"
+#endif
+
+const std::string SysInfoDisplay::name_ = "DISPLAY";
+
+SysInfoDisplay::SysInfoDisplay()
+    : resolution_width_(0),
+      resolution_height_(0),
+      dots_per_inch_width_(0),
+      dots_per_inch_height_(0),
+      physical_width_(0.0),
+      physical_height_(0.0),
+      brightness_(0.0),
+      connection_(NULL),
+      display_watch_id_(0),
+      brightness_fd_(-1),
+      max_brightness_(0),
+      brightness_watch_id_(0) {
+  // Both size and brightness are kept current by their watches, the cache
+  // is dropped when the display connection goes away.
+  SetCacheTTL(kCacheForever);
+}
+
+SysInfoDisplay::~SysInfoDisplay() {
+  DisconnectDisplay();
+  if (brightness_watch_id_ > 0)
+    g_source_remove(brightness_watch_id_);
+  if (brightness_fd_ >= 0)
+    close(brightness_fd_);
+}
+
+void SysInfoDisplay::Get(picojson::value& error,
+                         picojson::value& data) {
+  if (!ConnectDisplay()) {
+    system_info::SetPicoJsonObjectValue(error, "message",
+        picojson::value("Get display size failed."));
+    return;
+  }
+
+  WatchBrightness();
+  if (!UpdateBrightness()) {
+    system_info::SetPicoJsonObjectValue(error, "message",
+        picojson::value("Get display brightness failed."));
+    return;
+  }
+
+  SetData(data);
+  system_info::SetPicoJsonObjectValue(error, "message", picojson::value(""));
+}
+
+void SysInfoDisplay::StartListening() {
+  ConnectDisplay();
+  WatchBrightness();
+}
+
+void SysInfoDisplay::WatchBrightness() {
+  if (brightness_fd_ >= 0)
+    return;
+
+  char* str_val = system_info::ReadOneLine(
+      system_info::GetSysrootPath(ACPI_BACKLIGHT_DIR"/max_brightness").c_str());
+  if (!str_val) {
+    // FIXME(halton): ACPI is not enabled, fallback to maximum.
+    return;
+  }
+  max_brightness_ = atoi(str_val);
+  free(str_val);
+
+  std::string path =
+      system_info::GetSysrootPath(ACPI_BACKLIGHT_DIR"/actual_brightness");
+  brightness_fd_ = open(path.c_str(), O_RDONLY);
+  if (brightness_fd_ < 0)
+    return;
+
+  // sysfs attributes always poll readable, a change is signaled through
+  // POLLPRI | POLLERR until the attribute is read again.
+  GIOChannel* channel = g_io_channel_unix_new(brightness_fd_);
+  brightness_watch_id_ = g_io_add_watch(channel,
+      static_cast<GIOCondition>(G_IO_PRI | G_IO_ERR),
+      SysInfoDisplay::OnBrightnessChanged,
+      static_cast<gpointer>(this));
+  g_io_channel_unref(channel);
+}
+
+bool SysInfoDisplay::UpdateBrightness() {
+  if (brightness_fd_ < 0 || max_brightness_ <= 0) {
+    // FIXME(halton): ACPI is not enabled, fallback to maximum.
+    brightness_ = 1.0;
+    return true;
+  }
+
+  char str_val[32];
+  ssize_t length = pread(brightness_fd_, str_val, sizeof(str_val) - 1, 0);
+  if (length <= 0)
+    return false;
+  str_val[length] = '\0';
+
+  brightness_ = static_cast<double>(atoi(str_val)) / max_brightness_;
+  return true;
+}
+
+gboolean SysInfoDisplay::OnBrightnessChanged(GIOChannel* channel,
+                                             GIOCondition condition,
+                                             gpointer user_data) {
+  SysInfoDisplay* instance = static_cast<SysInfoDisplay*>(user_data);
+
+  double old_brightness = instance->brightness_;
+  if (!instance->UpdateBrightness()) {
+    // Fail to update brightness, wait for next notification.
+    return TRUE;
+  }
+
+  if (old_brightness != instance->brightness_)
+    instance->SendUpdate();
+
+  return TRUE;
+}
+
+void SysInfoDisplay::RefreshSize() {
+  int old_resolution_width = resolution_width_;
+  int old_resolution_height = resolution_height_;
+  double old_physical_width = physical_width_;
+  double old_physical_height = physical_height_;
+  if (!UpdateSize())
+    return;
+
+  if ((old_resolution_width != resolution_width_) ||
+      (old_resolution_height != resolution_height_) ||
+      (old_physical_width != physical_width_) ||
+      (old_physical_height != physical_height_))
+    SendUpdate();
+}
+
+void SysInfoDisplay::SendUpdate() {
+  picojson::value output = picojson::value(picojson::object());
+  picojson::value data = picojson::value(picojson::object());
+
+  SetData(data);
+  system_info::SetPicoJsonObjectValue(output, "cmd",
+      picojson::value("SystemInfoPropertyValueChanged"));
+  system_info::SetPicoJsonObjectValue(output, "prop",
+      picojson::value("DISPLAY"));
+  system_info::SetPicoJsonObjectValue(output, "data", data);
+
+  PostMessageToListeners(output);
+}
+
+void SysInfoDisplay::SetData(picojson::value& data) {
+  system_info::SetPicoJsonObjectValue(data, "brightness",
+      picojson::value(brightness_));
+
+  system_info::SetPicoJsonObjectValue(data, "resolutionWidth",
+      picojson::value(static_cast<double>(resolution_width_)));
+  system_info::SetPicoJsonObjectValue(data, "resolutionHeight",
+      picojson::value(static_cast<double>(resolution_height_)));
+  system_info::SetPicoJsonObjectValue(data, "physicalWidth",
+      picojson::value(physical_width_));
+  system_info::SetPicoJsonObjectValue(data, "physicalHeight",
+      picojson::value(physical_height_));
+
+  // dpi = N * 25.4 pixels / M inch
+  dots_per_inch_width_ = physical_width_ == 0 ? 0 :
+      static_cast<unsigned long>((resolution_width_ * 25.4) / physical_width_); // NOLINT
+  dots_per_inch_height_ = physical_height_ == 0 ? 0 :
+      static_cast<unsigned long>((resolution_height_ * 25.4) / physical_height_); // NOLINT
+
+  system_info::SetPicoJsonObjectValue(data, "dotsPerInchWidth",
+      picojson::value(static_cast<double>(dots_per_inch_width_)));
+  system_info::SetPicoJsonObjectValue(data, "dotsPerInchHeight",
+      picojson::value(static_cast<double>(dots_per_inch_height_)));
+}
@@ -14,42 +14,51 @@
 #include "system_info/system_info_instance.h"
 #include "system_info/system_info_utils.h"
 
+// Display server connection state, defined by the X11 and Wayland backends.
+struct DisplayConnection;
+
 class SysInfoDisplay : public SysInfoObject {
  public:
   static SysInfoObject& GetInstance() {
     static SysInfoDisplay instance;
     return instance;
   }
-  ~SysInfoDisplay() {
-    if (timeout_cb_id_ > 0)
-      g_source_remove(timeout_cb_id_);
-  }
+  ~SysInfoDisplay();
   // Get support
   void Get(picojson::value& error, picojson::value& data);
   // Listerner support
-  inline void StartListening() {
-    // FIXME(halton): Use Xlib event or D-Bus interface to monitor.
-    if (timeout_cb_id_ == 0) {
-      timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                     SysInfoDisplay::OnUpdateTimeout,
-                                     static_cast<gpointer>(this));
-    }
-  }
-  inline void StopListening() {
-    if (timeout_cb_id_ > 0) {
-      g_source_remove(timeout_cb_id_);
-      timeout_cb_id_ = 0;
-    }
-  }
+  void StartListening();
+  void StopListening() {}
 
   static const std::string name_;
 
+ protected:
+  const char* ThresholdKey() const { return "brightness"; }
+
  private:
   explicit SysInfoDisplay();
 
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  // The display server connection is opened once and its file descriptor is
+  // watched from the GLib main loop, so screen size changes are pushed by
+  // the server instead of being polled. Implemented per display backend.
+  bool ConnectDisplay();
+  void DisconnectDisplay();
   bool UpdateSize();
+  static gboolean OnDisplayEvent(GIOChannel* channel,
+                                 GIOCondition condition,
+                                 gpointer user_data);
+
+  // Brightness is watched through the sysfs notification raised by the
+  // backlight class on actual_brightness.
+  void WatchBrightness();
   bool UpdateBrightness();
+  static gboolean OnBrightnessChanged(GIOChannel* channel,
+                                      GIOCondition condition,
+                                      gpointer user_data);
+
+  // Re-reads the screen size and notifies listeners if it changed.
+  void RefreshSize();
+  void SendUpdate();
   void SetData(picojson::value& data);
 
   int resolution_width_;
@@ -59,7 +68,12 @@ class SysInfoDisplay : public SysInfoObject {
   double physical_width_;
   double physical_height_;
   double brightness_;
-  int timeout_cb_id_;
+
+  DisplayConnection* connection_;
+  guint display_watch_id_;
+  int brightness_fd_;
+  int max_brightness_;
+  guint brightness_watch_id_;
 
   DISALLOW_COPY_AND_ASSIGN(SysInfoDisplay);
 };
@@ -9,30 +9,19 @@
 
 #include "system_info/system_info_display.h"
 
-#include "common/picojson.h"
-
-#if defined(GENERIC_DESKTOP)
-  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/acpi_video0"
-#elif defined(TIZEN)
-  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/psb-bl"
-#else
-  #error "Unsupported platform"
-#endif
-
-class Display {
-  public:
-    Display();
-
-    wl_display* display;
-    wl_registry* registry;
-    wl_output* output;
-    int width;
-    int height;
-    double physical_width;
-    double physical_height;
+struct DisplayConnection {
+  DisplayConnection();
+
+  wl_display* display;
+  wl_registry* registry;
+  wl_output* output;
+  int width;
+  int height;
+  double physical_width;
+  double physical_height;
 };
 
-Display::Display()
+DisplayConnection::DisplayConnection()
     : display(NULL),
       registry(NULL),
       output(NULL),
@@ -51,7 +40,7 @@ static void display_handle_geometry(void* data,
                                     const char* make,
                                     const char* model,
                                     int transform) {
-  Display* d = reinterpret_cast<Display* >(data);
+  DisplayConnection* d = reinterpret_cast<DisplayConnection* >(data);
   d->physical_width = physical_width;
   d->physical_height = physical_height;
 }
@@ -62,7 +51,11 @@ static void display_handle_mode(void* data,
                                 int width,
                                 int height,
                                 int refresh) {
-  Display* d = reinterpret_cast<Display* >(data);
+  // Outputs advertise every supported mode, only track the current one.
+  if (!(flags & WL_OUTPUT_MODE_CURRENT))
+    return;
+
+  DisplayConnection* d = reinterpret_cast<DisplayConnection* >(data);
   d->width = width;
   d->height = height;
 }
@@ -72,14 +65,15 @@ static void registry_handle_global(void* data,
                                    uint32_t id,
                                    const char* interface,
                                    uint32_t version) {
-  Display* d = reinterpret_cast<Display* >(data);
+  DisplayConnection* d = reinterpret_cast<DisplayConnection* >(data);
 
   static const wl_output_listener kOutputListener = {
     display_handle_geometry,
     display_handle_mode
   };
 
-  if (strcmp(interface, "wl_output") == 0) {
+  // FIXME(XWALK-1091): Only the first output is reported.
+  if (strcmp(interface, "wl_output") == 0 && !d->output) {
     void* v = wl_registry_bind(registry, id, &wl_output_interface, 1);
     d->output = reinterpret_cast<wl_output*>(v);
     wl_output_add_listener(d->output, &kOutputListener, d);
@@ -95,156 +89,82 @@ static const wl_registry_listener kRegistryListener = {
     registry_handle_global_remove
 };
 
-static void get_wayland_screen_size(Display* display) {
-  display->registry = wl_display_get_registry(display->display);
-  wl_registry_add_listener(display->registry, &kRegistryListener, display);
-}
-
-const std::string SysInfoDisplay::name_ = "DISPLAY";
-
-SysInfoDisplay::SysInfoDisplay()
-    : resolution_width_(0),
-      resolution_height_(0),
-      dots_per_inch_width_(0),
-      dots_per_inch_height_(0),
-      physical_width_(0.0),
-      physical_height_(0.0),
-      brightness_(0.0),
-      timeout_cb_id_(0) {}
-
-void SysInfoDisplay::Get(picojson::value& error,
-                         picojson::value& data) {
-  if (!UpdateSize()) {
-    system_info::SetPicoJsonObjectValue(error, "message",
-        picojson::value("Get display size failed."));
-    return;
-  }
-
-  if (!UpdateBrightness()) {
-    system_info::SetPicoJsonObjectValue(error, "message",
-        picojson::value("Get display brightness failed."));
-    return;
-  }
-
-  SetData(data);
-  system_info::SetPicoJsonObjectValue(error, "message", picojson::value(""));
-}
-
-bool SysInfoDisplay::UpdateSize() {
-  Display screen;
+bool SysInfoDisplay::ConnectDisplay() {
+  if (connection_)
+    return true;
 
   // FIXME(XWALK-1091): Use gfx::Screen Chromium API instead of Wayland API.
-  screen.display = wl_display_connect(NULL);
-
-  if (!(screen.display)) {
+  wl_display* display = wl_display_connect(NULL);
+  if (!display) {
     std::cerr << "Wayland server connection error" << std::endl;
     return false;
   }
 
-  screen.width = -1;
-  get_wayland_screen_size(&screen);
-
-  // Wait for wayland server response using wl_output width return value.
-  while (screen.width == -1)
-    wl_display_roundtrip(screen.display);
-
-  resolution_width_ = screen.width;
-  resolution_height_ = screen.height;
-  physical_width_ = screen.physical_width;
-  physical_height_ = screen.physical_height;
-
-  wl_registry_destroy(screen.registry);
-  wl_display_flush(screen.display);
-  wl_display_disconnect(screen.display);
-
-  return true;
+  connection_ = new DisplayConnection;
+  connection_->display = display;
+  connection_->registry = wl_display_get_registry(display);
+  wl_registry_add_listener(connection_->registry, &kRegistryListener,
+                           connection_);
+
+  // The first roundtrip binds wl_output, the second one receives its
+  // geometry and mode. Later changes arrive through OnDisplayEvent().
+  wl_display_roundtrip(display);
+  wl_display_roundtrip(display);
+
+  GIOChannel* channel = g_io_channel_unix_new(wl_display_get_fd(display));
+  display_watch_id_ = g_io_add_watch(channel,
+      static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+      SysInfoDisplay::OnDisplayEvent,
+      static_cast<gpointer>(this));
+  g_io_channel_unref(channel);
+
+  return UpdateSize();
 }
 
-bool SysInfoDisplay::UpdateBrightness() {
-  char* str_val;
+void SysInfoDisplay::DisconnectDisplay() {
+  if (!connection_)
+    return;
 
-  str_val = system_info::ReadOneLine(ACPI_BACKLIGHT_DIR"/max_brightness");
-  if (!str_val) {
-    // FIXME(halton): ACPI is not enabled, fallback to maximum.
-    brightness_ = 1.0;
-    return true;
+  if (display_watch_id_ > 0) {
+    g_source_remove(display_watch_id_);
+    display_watch_id_ = 0;
   }
-  int max_val = atoi(str_val);
-  free(str_val);
+  if (connection_->output)
+    wl_output_destroy(connection_->output);
+  wl_registry_destroy(connection_->registry);
+  wl_display_flush(connection_->display);
+  wl_display_disconnect(connection_->display);
+  delete connection_;
+  connection_ = NULL;
+}
 
-  str_val = system_info::ReadOneLine(ACPI_BACKLIGHT_DIR"/max_brightness");
-  if (!str_val) {
-    // FIXME(halton): ACPI is not enabled, fallback to maximum.
-    brightness_ = 1.0;
-    return true;
-  }
-  int val = atoi(str_val);
-  free(str_val);
+bool SysInfoDisplay::UpdateSize() {
+  if (!connection_ || !connection_->output)
+    return false;
+
+  resolution_width_ = connection_->width;
+  resolution_height_ = connection_->height;
+  physical_width_ = connection_->physical_width;
+  physical_height_ = connection_->physical_height;
 
-  brightness_ = val / max_val;
   return true;
 }
 
-gboolean SysInfoDisplay::OnUpdateTimeout(gpointer user_data) {
+gboolean SysInfoDisplay::OnDisplayEvent(GIOChannel* channel,
+                                        GIOCondition condition,
+                                        gpointer user_data) {
   SysInfoDisplay* instance = static_cast<SysInfoDisplay*>(user_data);
 
-  double old_brightness = instance->brightness_;
-  if (!instance->UpdateBrightness()) {
-    // Fail to update brightness, wait for next round
-    return TRUE;
-  }
-
-  int old_resolution_width = instance->resolution_width_;
-  int old_resolution_height = instance->resolution_width_;
-  double old_physical_width = instance->physical_width_;
-  double old_physical_height = instance->physical_height_;
-  if (!instance->UpdateSize()) {
-    // Fail to update size, wait for next round
-    return TRUE;
-  }
-
-  if ((old_brightness != instance->brightness_) ||
-      (old_resolution_width != instance->resolution_width_) ||
-      (old_resolution_height != instance->resolution_width_) ||
-      (old_physical_width != instance->physical_width_) ||
-      (old_physical_height != instance->physical_height_)) {
-    picojson::value output = picojson::value(picojson::object());;
-    picojson::value data = picojson::value(picojson::object());
-
-    instance->SetData(data);
-    system_info::SetPicoJsonObjectValue(output, "cmd",
-        picojson::value("SystemInfoPropertyValueChanged"));
-    system_info::SetPicoJsonObjectValue(output, "prop",
-        picojson::value("DISPLAY"));
-    system_info::SetPicoJsonObjectValue(output, "data", data);
-
-    instance->PostMessageToListeners(output);
+  if ((condition & (G_IO_HUP | G_IO_ERR)) ||
+      wl_display_dispatch(instance->connection_->display) < 0) {
+    // Returning FALSE removes the watch.
+    instance->display_watch_id_ = 0;
+    instance->DisconnectDisplay();
+    instance->InvalidateCache();
+    return FALSE;
   }
+  wl_display_flush(instance->connection_->display);
 
+  instance->RefreshSize();
   return TRUE;
 }
-
-void SysInfoDisplay::SetData(picojson::value& data) {
-  system_info::SetPicoJsonObjectValue(data, "brightness",
-      picojson::value(brightness_));
-
-  system_info::SetPicoJsonObjectValue(data, "resolutionWidth",
-      picojson::value(static_cast<double>(resolution_width_)));
-  system_info::SetPicoJsonObjectValue(data, "resolutionHeight",
-      picojson::value(static_cast<double>(resolution_height_)));
-  system_info::SetPicoJsonObjectValue(data, "physicalWidth",
-      picojson::value(physical_width_));
-  system_info::SetPicoJsonObjectValue(data, "physicalHeight",
-      picojson::value(physical_height_));
-
-  // dpi = N * 25.4 pixels / M inch
-  dots_per_inch_width_ = physical_width_ == 0 ? 0 :
-      static_cast<unsigned long>((resolution_width_ * 25.4) / physical_width_); // NOLINT
-  dots_per_inch_height_ = physical_height_ == 0 ? 0 :
-      static_cast<unsigned long>((resolution_height_ * 25.4) / physical_height_); // NOLINT
-
-  system_info::SetPicoJsonObjectValue(data, "dotsPerInchWidth",
-      picojson::value(static_cast<double>(dots_per_inch_width_)));
-  system_info::SetPicoJsonObjectValue(data, "dotsPerInchHeight",
-      picojson::value(static_cast<double>(dots_per_inch_height_)));
-}
@@ -4,151 +4,105 @@
 
 #include "system_info/system_info_display.h"
 
-#include <stdio.h>
-
 #include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
 
-#include "common/picojson.h"
-
-#if defined(GENERIC_DESKTOP)
-  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/acpi_video0"
-#elif defined(TIZEN)
-  #define ACPI_BACKLIGHT_DIR "/sys/class/backlight/psb-bl"
-#else
-  #error "Unsupported platform"
-#endif
-
-const std::string SysInfoDisplay::name_ = "DISPLAY";
-
-SysInfoDisplay::SysInfoDisplay()
-    : resolution_width_(0),
-      resolution_height_(0),
-      dots_per_inch_width_(0),
-      dots_per_inch_height_(0),
-      physical_width_(0.0),
-      physical_height_(0.0),
-      brightness_(0.0),
-      timeout_cb_id_(0) {}
-
-void SysInfoDisplay::Get(picojson::value& error,
-                         picojson::value& data) {
-  if (!UpdateSize()) {
-    system_info::SetPicoJsonObjectValue(error, "message",
-        picojson::value("Get display size failed."));
-    return;
-  }
-
-  if (!UpdateBrightness()) {
-    system_info::SetPicoJsonObjectValue(error, "message",
-        picojson::value("Get display brightness failed."));
-    return;
-  }
+struct DisplayConnection {
+  DisplayConnection()
+      : display(NULL),
+        has_randr(false),
+        randr_event_base(0) {}
 
-  SetData(data);
-  system_info::SetPicoJsonObjectValue(error, "message", picojson::value(""));
-}
+  Display* display;
+  bool has_randr;
+  int randr_event_base;
+};
 
-bool SysInfoDisplay::UpdateSize() {
-  Display *dpy = XOpenDisplay(NULL);
+bool SysInfoDisplay::ConnectDisplay() {
+  if (connection_)
+    return true;
 
+  Display* dpy = XOpenDisplay(NULL);
   if (NULL == dpy) {
     return false;
   }
 
-  resolution_width_ = DisplayWidth(dpy, DefaultScreen(dpy));
-  resolution_height_ = DisplayHeight(dpy, DefaultScreen(dpy));
-  physical_width_ = DisplayWidthMM(dpy, DefaultScreen(dpy));
-  physical_height_ = DisplayHeightMM(dpy, DefaultScreen(dpy));
+  connection_ = new DisplayConnection;
+  connection_->display = dpy;
 
-  XCloseDisplay(dpy);
-  return true;
+  int randr_error_base;
+  if (XRRQueryExtension(dpy, &connection_->randr_event_base,
+                        &randr_error_base)) {
+    connection_->has_randr = true;
+    XRRSelectInput(dpy, DefaultRootWindow(dpy), RRScreenChangeNotifyMask);
+  }
+  XSync(dpy, False);
+
+  GIOChannel* channel = g_io_channel_unix_new(ConnectionNumber(dpy));
+  display_watch_id_ = g_io_add_watch(channel,
+      static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+      SysInfoDisplay::OnDisplayEvent,
+      static_cast<gpointer>(this));
+  g_io_channel_unref(channel);
+
+  return UpdateSize();
 }
 
-bool SysInfoDisplay::UpdateBrightness() {
-  char* str_val;
+void SysInfoDisplay::DisconnectDisplay() {
+  if (!connection_)
+    return;
 
-  str_val = system_info::ReadOneLine(ACPI_BACKLIGHT_DIR"/max_brightness");
-  if (!str_val) {
-    // FIXME(halton): ACPI is not enabled, fallback to maximum.
-    brightness_ = 1.0;
-    return true;
+  if (display_watch_id_ > 0) {
+    g_source_remove(display_watch_id_);
+    display_watch_id_ = 0;
   }
-  int max_val = atoi(str_val);
-  free(str_val);
+  XCloseDisplay(connection_->display);
+  delete connection_;
+  connection_ = NULL;
+}
 
-  str_val = system_info::ReadOneLine(ACPI_BACKLIGHT_DIR"/max_brightness");
-  if (!str_val) {
-    // FIXME(halton): ACPI is not enabled, fallback to maximum.
-    brightness_ = 1.0;
-    return true;
-  }
-  int val = atoi(str_val);
-  free(str_val);
+bool SysInfoDisplay::UpdateSize() {
+  if (!connection_)
+    return false;
+
+  Display* dpy = connection_->display;
+  resolution_width_ = DisplayWidth(dpy, DefaultScreen(dpy));
+  resolution_height_ = DisplayHeight(dpy, DefaultScreen(dpy));
+  physical_width_ = DisplayWidthMM(dpy, DefaultScreen(dpy));
+  physical_height_ = DisplayHeightMM(dpy, DefaultScreen(dpy));
 
-  brightness_ = val / max_val;
   return true;
 }
 
-gboolean SysInfoDisplay::OnUpdateTimeout(gpointer user_data) {
+gboolean SysInfoDisplay::OnDisplayEvent(GIOChannel* channel,
+                                        GIOCondition condition,
+                                        gpointer user_data) {
   SysInfoDisplay* instance = static_cast<SysInfoDisplay*>(user_data);
 
-  double old_brightness = instance->brightness_;
-  if (!instance->UpdateBrightness()) {
-    // Fail to update brightness, wait for next round
-    return TRUE;
+  if (condition & (G_IO_HUP | G_IO_ERR)) {
+    // Returning FALSE removes the watch.
+    instance->display_watch_id_ = 0;
+    instance->DisconnectDisplay();
+    instance->InvalidateCache();
+    return FALSE;
   }
 
-  int old_resolution_width = instance->resolution_width_;
-  int old_resolution_height = instance->resolution_width_;
-  double old_physical_width = instance->physical_width_;
-  double old_physical_height = instance->physical_height_;
-  if (!instance->UpdateSize()) {
-    // Fail to update size, wait for next round
-    return TRUE;
+  Display* dpy = instance->connection_->display;
+  bool screen_changed = false;
+  while (XPending(dpy)) {
+    XEvent event;
+    XNextEvent(dpy, &event);
+    if (instance->connection_->has_randr &&
+        event.type == instance->connection_->randr_event_base +
+                      RRScreenChangeNotify) {
+      // Updates the Screen dimensions cached by Xlib.
+      XRRUpdateConfiguration(&event);
+      screen_changed = true;
+    }
   }
 
-  if ((old_brightness != instance->brightness_) ||
-      (old_resolution_width != instance->resolution_width_) ||
-      (old_resolution_height != instance->resolution_width_) ||
-      (old_physical_width != instance->physical_width_) ||
-      (old_physical_height != instance->physical_height_)) {
-    picojson::value output = picojson::value(picojson::object());;
-    picojson::value data = picojson::value(picojson::object());
-
-    instance->SetData(data);
-    system_info::SetPicoJsonObjectValue(output, "cmd",
-        picojson::value("SystemInfoPropertyValueChanged"));
-    system_info::SetPicoJsonObjectValue(output, "prop",
-        picojson::value("DISPLAY"));
-    system_info::SetPicoJsonObjectValue(output, "data", data);
-
-    instance->PostMessageToListeners(output);
-  }
+  if (screen_changed)
+    instance->RefreshSize();
 
   return TRUE;
 }
-
-void SysInfoDisplay::SetData(picojson::value& data) {
-  system_info::SetPicoJsonObjectValue(data, "brightness",
-      picojson::value(brightness_));
-
-  system_info::SetPicoJsonObjectValue(data, "resolutionWidth",
-      picojson::value(static_cast<double>(resolution_width_)));
-  system_info::SetPicoJsonObjectValue(data, "resolutionHeight",
-      picojson::value(static_cast<double>(resolution_height_)));
-  system_info::SetPicoJsonObjectValue(data, "physicalWidth",
-      picojson::value(physical_width_));
-  system_info::SetPicoJsonObjectValue(data, "physicalHeight",
-      picojson::value(physical_height_));
-
-  // dpi = N * 25.4 pixels / M inch
-  dots_per_inch_width_ = physical_width_ == 0 ? 0 :
-      static_cast<unsigned long>((resolution_width_ * 25.4) / physical_width_); // NOLINT
-  dots_per_inch_height_ = physical_height_ == 0 ? 0 :
-      static_cast<unsigned long>((resolution_height_ * 25.4) / physical_height_); // NOLINT
-
-  system_info::SetPicoJsonObjectValue(data, "dotsPerInchWidth",
-      picojson::value(static_cast<double>(dots_per_inch_width_)));
-  system_info::SetPicoJsonObjectValue(data, "dotsPerInchHeight",
-      picojson::value(static_cast<double>(dots_per_inch_height_)));
-}
@@ -20,6 +20,7 @@
 #include "system_info/system_info_instance.h"
 
 #include <dlfcn.h>
+#include <math.h>
 #include <stdlib.h>
 #if defined(TIZEN)
 #include <pkgmgr-info.h>
@@ -55,7 +56,7 @@ void SystemInfoInstance::RegisterClass() {
 SystemInfoInstance::~SystemInfoInstance() {
   for (classes_iterator it = classes_.begin();
        it != classes_.end(); ++it) {
-    (it->second).RemoveListener(this);
+    (it->second).RemoveListeners(this);
   }
 }
 
@@ -93,7 +94,7 @@ void SystemInfoInstance::HandleGetPropertyValue(const picojson::value& input,
     system_info::SetPicoJsonObjectValue(error, "message",
         picojson::value("Property not supported: " + prop));
   } else {
-    (it->second).Get(error, data);
+    (it->second).GetCached(error, data);
   }
 
   if (!error.get("message").to_str().empty()) {
@@ -111,7 +112,8 @@ void SystemInfoInstance::HandleStartListening(const picojson::value& input) {
   classes_iterator it= classes_.find(prop);
 
   if (it != classes_.end()) {
-    (it->second).AddListener(this);
+    (it->second).AddListener(this, input.get("listenerId").to_str(),
+                             SysInfoListenerOptions(input.get("options")));
   }
 }
 
@@ -120,7 +122,7 @@ void SystemInfoInstance::HandleStopListening(const picojson::value& input) {
   classes_iterator it= classes_.find(prop);
 
   if (it != classes_.end()) {
-    (it->second).RemoveListener(this);
+    (it->second).RemoveListener(this, input.get("listenerId").to_str());
   }
 }
 
@@ -597,3 +599,264 @@ void SystemInfoInstance::HandleGetCapabilities() {
   picojson::value v(o);
   SendSyncReply(v.serialize().c_str());
 }
+
+void SysInfoObject::GetCached(picojson::value& error, picojson::value& data) {
+  if (IsCacheFresh()) {
+    AutoLock lock(&cache_mutex_);
+    data = cached_data_;
+    system_info::SetPicoJsonObjectValue(error, "message", picojson::value(""));
+    return;
+  }
+
+  Get(error, data);
+  if (error.get("message").to_str().empty())
+    UpdateCache(data);
+}
+
+void SysInfoObject::InvalidateCache() {
+  AutoLock lock(&cache_mutex_);
+  cache_valid_ = false;
+}
+
+void SysInfoObject::UpdateCache(const picojson::value& data) {
+  if (cache_ttl_ == kCacheDisabled || !data.is<picojson::object>())
+    return;
+
+  AutoLock lock(&cache_mutex_);
+  cached_data_ = data;
+  cache_timestamp_ = g_get_monotonic_time();
+  cache_valid_ = true;
+}
+
+bool SysInfoObject::IsCacheFresh() {
+  if (cache_ttl_ == kCacheDisabled)
+    return false;
+
+  {
+    AutoLock lock(&cache_mutex_);
+    if (!cache_valid_)
+      return false;
+    if (cache_ttl_ == kCacheForever)
+      return true;
+    // g_get_monotonic_time() is in microseconds.
+    if (g_get_monotonic_time() - cache_timestamp_ <
+        static_cast<gint64>(cache_ttl_) * 1000)
+      return true;
+  }
+
+  // Active listeners keep the cached value current.
+  AutoLock lock(&listeners_mutex_);
+  return !listeners_.empty();
+}
+
+namespace {
+
+// The listener of a pending post timeout is found again by |source|.
+struct PendingTimeout {
+  SysInfoObject* object;
+  guint source;
+};
+
+void DeletePendingTimeout(gpointer data) {
+  delete static_cast<PendingTimeout*>(data);
+}
+
+}  // namespace
+
+SysInfoListenerOptions::SysInfoListenerOptions(const picojson::value& options)
+    : low_threshold(-1.0),
+      high_threshold(-1.0),
+      minimum_delta(-1.0),
+      minimum_interval(-1.0) {
+  if (!options.is<picojson::object>())
+    return;
+
+  if (options.get("lowThreshold").is<double>())
+    low_threshold = options.get("lowThreshold").get<double>();
+  if (options.get("highThreshold").is<double>())
+    high_threshold = options.get("highThreshold").get<double>();
+  if (options.get("minimumDelta").is<double>())
+    minimum_delta = options.get("minimumDelta").get<double>();
+  if (options.get("minimumInterval").is<double>())
+    minimum_interval = options.get("minimumInterval").get<double>();
+}
+
+void SysInfoObject::AddListener(SystemInfoInstance* instance,
+                                const std::string& listener_id,
+                                const SysInfoListenerOptions& options) {
+  AutoLock lock(&listeners_mutex_);
+  listeners_.push_back(Listener(instance, listener_id, options));
+
+  if (listeners_.size() > 1)
+    return;
+  StartListening();
+}
+
+void SysInfoObject::RemoveListener(SystemInfoInstance* instance,
+                                   const std::string& listener_id) {
+  AutoLock lock(&listeners_mutex_);
+  if (listeners_.empty())
+    return;
+
+  for (std::list<Listener>::iterator it = listeners_.begin();
+       it != listeners_.end(); ++it) {
+    if (it->instance == instance && it->id == listener_id) {
+      it->CancelPending();
+      listeners_.erase(it);
+      break;
+    }
+  }
+
+  if (!listeners_.empty())
+    return;
+  StopListening();
+}
+
+void SysInfoObject::RemoveListeners(SystemInfoInstance* instance) {
+  AutoLock lock(&listeners_mutex_);
+  if (listeners_.empty())
+    return;
+
+  std::list<Listener>::iterator it = listeners_.begin();
+  while (it != listeners_.end()) {
+    if (it->instance == instance) {
+      it->CancelPending();
+      it = listeners_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  if (!listeners_.empty())
+    return;
+  StopListening();
+}
+
+void SysInfoObject::PostMessageToListeners(const picojson::value& output) {
+  const picojson::value& data = output.get("data");
+  if (output.contains("data"))
+    UpdateCache(data);
+
+  AutoLock lock(&listeners_mutex_);
+  gint64 now = g_get_monotonic_time();
+
+  // Ids of the accepting listeners, grouped by instance.
+  std::map<SystemInfoInstance*, picojson::array> accepted;
+  for (std::list<Listener>::iterator it = listeners_.begin();
+       it != listeners_.end(); ++it) {
+    Verdict verdict = it->Check(data, ThresholdKey(), now);
+    if (verdict == kDefer) {
+      it->Defer(this, output, now);
+      continue;
+    }
+
+    // A change held back is stale once a later one is posted or rejected.
+    it->CancelPending();
+    if (verdict == kPost) {
+      it->MarkPosted(data, ThresholdKey(), now);
+      accepted[it->instance].push_back(picojson::value(it->id));
+    }
+  }
+
+  for (std::map<SystemInfoInstance*, picojson::array>::iterator it =
+       accepted.begin(); it != accepted.end(); ++it) {
+    picojson::value message = output;
+    system_info::SetPicoJsonObjectValue(message, "listeners",
+        picojson::value(it->second));
+    it->first->PostMessage(message.serialize().c_str());
+  }
+}
+
+SysInfoObject::Verdict SysInfoObject::Listener::Check(
+    const picojson::value& data, const char* key, gint64 now) {
+  if (key && data.get(key).is<double>()) {
+    double value = data.get(key).get<double>();
+
+    // Like the W3C/Tizen options, a listener with thresholds is only
+    // notified while the value is at or beyond one of them.
+    if (options.low_threshold >= 0 || options.high_threshold >= 0) {
+      bool above = options.high_threshold >= 0 &&
+                   value >= options.high_threshold;
+      bool below = options.low_threshold >= 0 &&
+                   value <= options.low_threshold;
+      if (!above && !below)
+        return kReject;
+    }
+
+    // Hysteresis around the last notified value.
+    if (options.minimum_delta >= 0 && has_last_value &&
+        fabs(value - last_value) < options.minimum_delta)
+      return kReject;
+  }
+
+  // g_get_monotonic_time() is in microseconds.
+  if (options.minimum_interval >= 0 && last_post_time > 0 &&
+      now - last_post_time < options.minimum_interval * 1000)
+    return kDefer;
+  return kPost;
+}
+
+void SysInfoObject::Listener::MarkPosted(const picojson::value& data,
+                                         const char* key,
+                                         gint64 now) {
+  if (key && data.get(key).is<double>()) {
+    has_last_value = true;
+    last_value = data.get(key).get<double>();
+  }
+  last_post_time = now;
+}
+
+void SysInfoObject::Listener::Post(const picojson::value& output) {
+  picojson::value message = output;
+  system_info::SetPicoJsonObjectValue(message, "listeners",
+      picojson::value(picojson::array(1, picojson::value(id))));
+  instance->PostMessage(message.serialize().c_str());
+}
+
+void SysInfoObject::Listener::Defer(SysInfoObject* object,
+                                    const picojson::value& output,
+                                    gint64 now) {
+  pending = output;
+  if (pending_source)
+    return;
+
+  // Rounded up, for the interval to have expired when the timeout fires.
+  double remaining =
+      ceil(options.minimum_interval - (now - last_post_time) / 1000.0);
+  guint interval = remaining < G_MAXUINT ? remaining : G_MAXUINT;
+  PendingTimeout* timeout = new PendingTimeout;
+  timeout->object = object;
+  pending_source = g_timeout_add_full(G_PRIORITY_DEFAULT, interval,
+                                      OnPendingTimeout, timeout,
+                                      DeletePendingTimeout);
+  timeout->source = pending_source;
+}
+
+void SysInfoObject::Listener::CancelPending() {
+  if (pending_source)
+    g_source_remove(pending_source);
+  pending_source = 0;
+  pending = picojson::value();
+}
+
+// static
+gboolean SysInfoObject::OnPendingTimeout(gpointer data) {
+  PendingTimeout* timeout = static_cast<PendingTimeout*>(data);
+  SysInfoObject* object = timeout->object;
+
+  // The listener is found by the source under the lock, it may have been
+  // removed meanwhile.
+  AutoLock lock(&object->listeners_mutex_);
+  for (std::list<Listener>::iterator it = object->listeners_.begin();
+       it != object->listeners_.end(); ++it) {
+    if (it->pending_source != timeout->source)
+      continue;
+    it->pending_source = 0;
+    it->MarkPosted(it->pending.get("data"), object->ThresholdKey(),
+                   g_get_monotonic_time());
+    it->Post(it->pending);
+    it->pending = picojson::value();
+    break;
+  }
+  return FALSE;
+}
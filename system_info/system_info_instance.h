@@ -5,6 +5,8 @@
 #ifndef SYSTEM_INFO_SYSTEM_INFO_INSTANCE_H_
 #define SYSTEM_INFO_SYSTEM_INFO_INSTANCE_H_
 
+#include <glib.h>
+
 #include <list>
 #include <map>
 #include <string>
@@ -44,56 +46,128 @@ class SystemInfoInstance : public common::Instance {
   static void RegisterClass();
 };
 
+// Per-listener change filters, see SysInfoObject::PostMessageToListeners().
+// Negative values mean the option is not set.
+struct SysInfoListenerOptions {
+  SysInfoListenerOptions()
+      : low_threshold(-1.0),
+        high_threshold(-1.0),
+        minimum_delta(-1.0),
+        minimum_interval(-1.0) {}
+
+  explicit SysInfoListenerOptions(const picojson::value& options);
+
+  double low_threshold;
+  double high_threshold;
+  double minimum_delta;
+  // In milliseconds.
+  double minimum_interval;
+};
+
 class SysInfoObject {
  public:
-  SysInfoObject() {
+  SysInfoObject()
+      : cache_ttl_(kCacheDisabled),
+        cache_valid_(false),
+        cache_timestamp_(0) {
     pthread_mutex_init(&listeners_mutex_, NULL);
+    pthread_mutex_init(&cache_mutex_, NULL);
   }
 
   ~SysInfoObject() {
-    AutoLock* lock = new AutoLock(&listeners_mutex_);
-    for (std::list<SystemInfoInstance*>::iterator it = listeners_.begin();
-         it != listeners_.end(); it++) {
-      RemoveListener(*it);
-    }
-    delete lock;
     pthread_mutex_destroy(&listeners_mutex_);
+    pthread_mutex_destroy(&cache_mutex_);
   }
 
   // Get support
   virtual void Get(picojson::value& error, picojson::value& data) = 0;
 
-  // Listener support
-  void AddListener(SystemInfoInstance* instance) {
-    AutoLock lock(&listeners_mutex_);
-    listeners_.push_back(instance);
-
-    if (listeners_.size() > 1)
-      return;
-    StartListening();
-  }
-  void RemoveListener(SystemInfoInstance* instance) {
-    AutoLock lock(&listeners_mutex_);
-    listeners_.remove(instance);
-
-    if (!listeners_.empty())
-      return;
-    StopListening();
-  }
+  // Cached Get support. Serves the last known value from memory while it is
+  // younger than the property TTL, or for as long as listeners are active
+  // since every change is then published through PostMessageToListeners().
+  void GetCached(picojson::value& error, picojson::value& data);
+  void InvalidateCache();
+
+  // Listener support. Platform listening starts with the first listener and
+  // stops when the last one is removed.
+  void AddListener(SystemInfoInstance* instance,
+                   const std::string& listener_id,
+                   const SysInfoListenerOptions& options);
+  void RemoveListener(SystemInfoInstance* instance,
+                      const std::string& listener_id);
+  void RemoveListeners(SystemInfoInstance* instance);
   virtual void StartListening() {}
   virtual void StopListening() {}
-  void PostMessageToListeners(const picojson::value& output) {
-    AutoLock lock(&listeners_mutex_);
-    std::string result = output.serialize();
-    for (std::list<SystemInfoInstance*>::iterator it = listeners_.begin();
-         it != listeners_.end(); it++) {
-      (*it)->PostMessage(result.c_str());
-    }
-  }
+
+  // Filters |output| through the options of every listener and posts it,
+  // with the ids of the accepting listeners, to their instances. Rejected
+  // changes are dropped before serialization. A change within the minimum
+  // interval of a listener is held back until it expires, the latest one
+  // replacing any earlier.
+  void PostMessageToListeners(const picojson::value& output);
 
  protected:
+  // Cache TTL values, in milliseconds.
+  static const int kCacheDisabled = 0;
+  static const int kCacheForever = -1;
+
+  void SetCacheTTL(int ttl) { cache_ttl_ = ttl; }
+  void UpdateCache(const picojson::value& data);
+
+  // Name of the numeric data member thresholds and minimum delta apply to,
+  // or NULL if the property has none.
+  virtual const char* ThresholdKey() const { return NULL; }
+
+ private:
+  enum Verdict {
+    kReject,
+    kPost,
+    // Posted once the minimum interval expires.
+    kDefer
+  };
+
+  struct Listener {
+    Listener(SystemInfoInstance* instance, const std::string& id,
+             const SysInfoListenerOptions& options)
+        : instance(instance),
+          id(id),
+          options(options),
+          has_last_value(false),
+          last_value(0.0),
+          last_post_time(0),
+          pending_source(0) {}
+
+    Verdict Check(const picojson::value& data, const char* key, gint64 now);
+    void MarkPosted(const picojson::value& data, const char* key, gint64 now);
+    void Post(const picojson::value& output);
+    // Holds back |output| until the minimum interval expires.
+    void Defer(SysInfoObject* object, const picojson::value& output,
+               gint64 now);
+    void CancelPending();
+
+    SystemInfoInstance* instance;
+    std::string id;
+    SysInfoListenerOptions options;
+    bool has_last_value;
+    double last_value;
+    gint64 last_post_time;
+    // The latest change held back, and the timeout posting it.
+    picojson::value pending;
+    guint pending_source;
+  };
+
+  static gboolean OnPendingTimeout(gpointer data);
+
+  bool IsCacheFresh();
+
   pthread_mutex_t listeners_mutex_;
-  std::list<SystemInfoInstance*> listeners_;
+  std::list<Listener> listeners_;
+
+  int cache_ttl_;
+  bool cache_valid_;
+  gint64 cache_timestamp_;
+  picojson::value cached_data_;
+  pthread_mutex_t cache_mutex_;
 };
 
 typedef std::map<std::string, SysInfoObject&> SysInfoClassMap;
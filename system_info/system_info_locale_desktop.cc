@@ -16,7 +16,9 @@
 const std::string SysInfoLocale::name_ = "LOCALE";
 
 SysInfoLocale::SysInfoLocale()
-    : timeout_cb_id_(0) {}
+    : timeout_cb_id_(0) {
+  SetCacheTTL(system_info::default_cache_ttl);
+}
 
 SysInfoLocale::~SysInfoLocale() {}
 
@@ -79,15 +81,13 @@ bool SysInfoLocale::GetLanguage() {
 bool SysInfoLocale::GetCountry() {
   std::string str;
 
-  FILE* fp = fopen("/etc/timezone", "r");
-  std::string info;
-  char* cinfo = NULL;
-  size_t length = 100;
+  char* cinfo = system_info::ReadOneLine(
+      system_info::GetSysrootPath("/etc/timezone").c_str());
+  if (!cinfo)
+    return false;
 
-  getline(&cinfo, &length, fp);
-  info = cinfo;
+  std::string info = cinfo;
   free(cinfo);
-  fclose(fp);
 
   int pos = info.find('/', 0);
   str.assign(info, pos + 1, info.length() - pos - 1);
@@ -10,7 +10,9 @@
 
 const std::string SysInfoLocale::name_ = "LOCALE";
 
-SysInfoLocale::SysInfoLocale() {}
+SysInfoLocale::SysInfoLocale() {
+  SetCacheTTL(system_info::default_cache_ttl);
+}
 
 SysInfoLocale::~SysInfoLocale() {}
 
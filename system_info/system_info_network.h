@@ -28,15 +28,6 @@ enum SystemInfoNetworkType {
   SYSTEM_INFO_NETWORK_UNKNOWN
 };
 
-#if defined(GENERIC_DESKTOP)
-#define G_CALLBACK_1(METHOD, SENDER, ARG0)                                   \
-  static void METHOD ## Thunk(SENDER sender, ARG0 res, gpointer userdata) {  \
-    return reinterpret_cast<SysInfoNetwork*>(userdata)->METHOD(sender, res); \
-  }                                                                          \
-                                                                             \
-  void METHOD(SENDER, ARG0);
-#endif
-
 class SysInfoNetwork : public SysInfoObject {
  public:
   static SysInfoObject& GetInstance() {
@@ -61,24 +52,11 @@ class SysInfoNetwork : public SysInfoObject {
   SystemInfoNetworkType type_;
 
 #if defined(GENERIC_DESKTOP)
-  G_CALLBACK_1(OnNetworkManagerCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_1(OnActiveConnectionCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_1(OnDevicesCreated, GObject*, GAsyncResult*);
-
-  void UpdateActiveConnection(GVariant* value);
-  void UpdateActiveDevice(GVariant* value);
-  void UpdateDeviceType(GVariant* value);
+  static void OnNetworkManagerChanged(gpointer user_data);
   void SendUpdate(guint new_device_type);
 
-  static void OnNetworkManagerSignal(GDBusProxy* proxy, gchar* sender,
-      gchar* signal, GVariant* parameters, gpointer user_data);
-  static void OnActiveConnectionsSignal(GDBusProxy* proxy, gchar* sender,
-      gchar* signal, GVariant* parameters, gpointer user_data);
-
   SystemInfoNetworkType ToNetworkType(guint device_type);
 
-  std::string active_connection_;
-  std::string active_device_;
   guint device_type_;
 #elif defined(TIZEN)
   bool GetNetworkType();
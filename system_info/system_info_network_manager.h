@@ -0,0 +1,96 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SYSTEM_INFO_SYSTEM_INFO_NETWORK_MANAGER_H_
+#define SYSTEM_INFO_SYSTEM_INFO_NETWORK_MANAGER_H_
+
+#include <gio/gio.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "common/utils.h"
+
+// In-memory mirror of the NetworkManager D-Bus objects used by NETWORK and
+// WIFI_NETWORK: the manager, its active connections, their devices and the
+// access point and IP configurations referenced by those devices.
+//
+// Each object is fetched once with a single GetAll() call when it becomes
+// referenced, and is then kept current from the PropertiesChanged and
+// ObjectManager signals NetworkManager emits. Reads are pure memory lookups.
+// Changes are coalesced and observers are notified once per batch, only if a
+// property value actually changed.
+class NetworkManagerMirror {
+ public:
+  typedef void (*ChangedCallback)(gpointer user_data);
+
+  static NetworkManagerMirror& GetInstance() {
+    static NetworkManagerMirror instance;
+    return instance;
+  }
+  ~NetworkManagerMirror();
+
+  void AddObserver(ChangedCallback callback, gpointer user_data);
+  void RemoveObserver(ChangedCallback callback, gpointer user_data);
+
+  // Returns the mirrored value, owned by the mirror, or NULL if unknown.
+  GVariant* GetProperty(const std::string& path,
+                        const std::string& name) const;
+  // Object path properties ("o"). "/" is returned as an empty string.
+  std::string GetObjectPath(const std::string& path,
+                            const std::string& name) const;
+  // First element of an object path array property ("ao").
+  std::string GetFirstObjectPath(const std::string& path,
+                                 const std::string& name) const;
+
+  // Object path of the device of the first active connection.
+  std::string GetPrimaryDevice() const;
+
+ private:
+  typedef std::map<std::string, GVariant*> PropertyMap;
+  typedef std::map<std::string, PropertyMap> ObjectMap;
+  typedef std::pair<ChangedCallback, gpointer> Observer;
+
+  NetworkManagerMirror();
+
+  static void OnBusAcquired(GObject* source, GAsyncResult* res,
+                            gpointer user_data);
+  static void OnGetAllReply(GObject* source, GAsyncResult* res,
+                            gpointer user_data);
+  static void OnSignal(GDBusConnection* connection, const gchar* sender,
+                       const gchar* path, const gchar* interface,
+                       const gchar* signal, GVariant* parameters,
+                       gpointer user_data);
+  static void OnNameOwnerChanged(GDBusConnection* connection,
+                                 const gchar* sender, const gchar* path,
+                                 const gchar* interface, const gchar* signal,
+                                 GVariant* parameters, gpointer user_data);
+  static gboolean OnNotifyIdle(gpointer user_data);
+
+  void Reset();
+  void Fetch(const std::string& path, const char* interface);
+  void ApplyProperties(const std::string& path, GVariant* properties);
+  void TrackReferences();
+  void ScheduleNotify();
+
+  GDBusConnection* connection_;
+  guint signal_id_;
+  guint name_owner_id_;
+  guint notify_id_;
+  bool changed_;
+
+  ObjectMap objects_;
+  std::set<std::string> pending_;
+  // Incremented by Reset(), for the replies to the fetches made before to
+  // be dropped.
+  unsigned int generation_;
+  std::list<Observer> observers_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetworkManagerMirror);
+};
+
+#endif  // SYSTEM_INFO_SYSTEM_INFO_NETWORK_MANAGER_H_
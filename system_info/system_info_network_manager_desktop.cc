@@ -0,0 +1,399 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "system_info/system_info_network_manager.h"
+
+#include <NetworkManager.h>
+#include <string.h>
+
+namespace {
+
+const char sDBusService[] = "org.freedesktop.DBus";
+const char sDBusPath[] = "/org/freedesktop/DBus";
+const char sDBusInterface[] = "org.freedesktop.DBus";
+const char sPropertiesInterface[] = "org.freedesktop.DBus.Properties";
+const char sWirelessInterface[] = NM_DBUS_INTERFACE_DEVICE ".Wireless";
+
+struct FetchRequest {
+  FetchRequest(NetworkManagerMirror* mirror, const std::string& path,
+               const std::string& key, unsigned int generation)
+      : mirror(mirror), path(path), key(key), generation(generation) {}
+
+  NetworkManagerMirror* mirror;
+  std::string path;
+  std::string key;
+  unsigned int generation;
+};
+
+std::string PendingKey(const std::string& path, const char* interface) {
+  return path + " " + interface;
+}
+
+}  // namespace
+
+NetworkManagerMirror::NetworkManagerMirror()
+    : connection_(NULL),
+      signal_id_(0),
+      name_owner_id_(0),
+      notify_id_(0),
+      changed_(false),
+      generation_(0) {
+  g_bus_get(G_BUS_TYPE_SYSTEM, NULL, OnBusAcquired, this);
+}
+
+NetworkManagerMirror::~NetworkManagerMirror() {
+  if (notify_id_ > 0)
+    g_source_remove(notify_id_);
+  if (connection_) {
+    g_dbus_connection_signal_unsubscribe(connection_, signal_id_);
+    g_dbus_connection_signal_unsubscribe(connection_, name_owner_id_);
+    g_object_unref(connection_);
+  }
+  Reset();
+}
+
+void NetworkManagerMirror::AddObserver(ChangedCallback callback,
+                                       gpointer user_data) {
+  observers_.push_back(Observer(callback, user_data));
+}
+
+void NetworkManagerMirror::RemoveObserver(ChangedCallback callback,
+                                          gpointer user_data) {
+  observers_.remove(Observer(callback, user_data));
+}
+
+GVariant* NetworkManagerMirror::GetProperty(const std::string& path,
+                                            const std::string& name) const {
+  ObjectMap::const_iterator object = objects_.find(path);
+  if (object == objects_.end())
+    return NULL;
+
+  PropertyMap::const_iterator property = object->second.find(name);
+  if (property == object->second.end())
+    return NULL;
+
+  return property->second;
+}
+
+std::string NetworkManagerMirror::GetObjectPath(
+    const std::string& path, const std::string& name) const {
+  GVariant* value = GetProperty(path, name);
+  if (!value || !g_variant_is_of_type(value, G_VARIANT_TYPE_OBJECT_PATH))
+    return "";
+
+  const char* str = g_variant_get_string(value, NULL);
+  // NetworkManager uses "/" for "no object".
+  if (!str || strcmp(str, "/") == 0)
+    return "";
+
+  return str;
+}
+
+std::string NetworkManagerMirror::GetFirstObjectPath(
+    const std::string& path, const std::string& name) const {
+  GVariant* value = GetProperty(path, name);
+  if (!value || !g_variant_is_of_type(value, G_VARIANT_TYPE("ao")) ||
+      !g_variant_n_children(value))
+    return "";
+
+  GVariant* child = g_variant_get_child_value(value, 0);
+  std::string str = g_variant_get_string(child, NULL);
+  g_variant_unref(child);
+
+  return str;
+}
+
+std::string NetworkManagerMirror::GetPrimaryDevice() const {
+  std::string active_connection =
+      GetFirstObjectPath(NM_DBUS_PATH, "ActiveConnections");
+  if (active_connection.empty())
+    return "";
+
+  return GetFirstObjectPath(active_connection, "Devices");
+}
+
+void NetworkManagerMirror::OnBusAcquired(GObject*, GAsyncResult* res,
+                                         gpointer user_data) {
+  NetworkManagerMirror* self =
+      reinterpret_cast<NetworkManagerMirror*>(user_data);
+  GError* err = 0;
+
+  self->connection_ = g_bus_get_finish(res, &err);
+  if (!self->connection_) {
+    g_printerr("System bus connection error: %s\n", err->message);
+    g_error_free(err);
+    return;
+  }
+
+  // A single subscription covers the per-interface PropertiesChanged
+  // signals of older NetworkManager versions, the standard
+  // org.freedesktop.DBus.Properties one and the ObjectManager signals.
+  self->signal_id_ = g_dbus_connection_signal_subscribe(self->connection_,
+      NM_DBUS_SERVICE, NULL, NULL, NULL, NULL,
+      G_DBUS_SIGNAL_FLAGS_NONE, OnSignal, self, NULL);
+  self->name_owner_id_ = g_dbus_connection_signal_subscribe(self->connection_,
+      sDBusService, sDBusInterface, "NameOwnerChanged", sDBusPath,
+      NM_DBUS_SERVICE, G_DBUS_SIGNAL_FLAGS_NONE, OnNameOwnerChanged, self,
+      NULL);
+
+  self->Fetch(NM_DBUS_PATH, NM_DBUS_INTERFACE);
+}
+
+void NetworkManagerMirror::Fetch(const std::string& path,
+                                 const char* interface) {
+  std::string key = PendingKey(path, interface);
+  if (!connection_ || pending_.count(key))
+    return;
+
+  pending_.insert(key);
+  g_dbus_connection_call(connection_,
+      NM_DBUS_SERVICE,
+      path.c_str(),
+      sPropertiesInterface,
+      "GetAll",
+      g_variant_new("(s)", interface),
+      G_VARIANT_TYPE("(a{sv})"),
+      G_DBUS_CALL_FLAGS_NONE,
+      -1,
+      NULL,
+      OnGetAllReply,
+      new FetchRequest(this, path, key, generation_));
+}
+
+void NetworkManagerMirror::OnGetAllReply(GObject* source, GAsyncResult* res,
+                                         gpointer user_data) {
+  FetchRequest* request = reinterpret_cast<FetchRequest*>(user_data);
+  NetworkManagerMirror* self = request->mirror;
+  GError* err = 0;
+
+  GVariant* reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                  res, &err);
+  // From the NetworkManager that was there before a restart.
+  if (request->generation != self->generation_) {
+    if (reply)
+      g_variant_unref(reply);
+    else
+      g_error_free(err);
+    delete request;
+    return;
+  }
+
+  self->pending_.erase(request->key);
+  if (!reply) {
+    // Expected for the wireless interface of non-WiFi devices.
+    g_error_free(err);
+  } else {
+    GVariant* properties = g_variant_get_child_value(reply, 0);
+    self->ApplyProperties(request->path, properties);
+    g_variant_unref(properties);
+    g_variant_unref(reply);
+    self->TrackReferences();
+  }
+
+  self->ScheduleNotify();
+  delete request;
+}
+
+void NetworkManagerMirror::OnSignal(GDBusConnection* connection,
+                                    const gchar* sender,
+                                    const gchar* path,
+                                    const gchar* interface,
+                                    const gchar* signal,
+                                    GVariant* parameters,
+                                    gpointer user_data) {
+  NetworkManagerMirror* self =
+      reinterpret_cast<NetworkManagerMirror*>(user_data);
+
+  if (strcmp(signal, "PropertiesChanged") == 0) {
+    // Only objects referenced from the manager are mirrored.
+    if (!self->objects_.count(path))
+      return;
+
+    GVariant* properties = NULL;
+    if (g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv}as)")))
+      properties = g_variant_get_child_value(parameters, 1);
+    else if (g_variant_is_of_type(parameters, G_VARIANT_TYPE("(a{sv})")))
+      properties = g_variant_get_child_value(parameters, 0);
+    if (!properties)
+      return;
+
+    self->ApplyProperties(path, properties);
+    g_variant_unref(properties);
+  } else if (strcmp(signal, "InterfacesAdded") == 0) {
+    const gchar* object_path;
+    GVariantIter* iter;
+    const gchar* name;
+    GVariant* properties;
+
+    g_variant_get(parameters, "(&oa{sa{sv}})", &object_path, &iter);
+    if (self->objects_.count(object_path)) {
+      while (g_variant_iter_loop(iter, "{&s@a{sv}}", &name, &properties))
+        self->ApplyProperties(object_path, properties);
+    }
+    g_variant_iter_free(iter);
+  } else if (strcmp(signal, "InterfacesRemoved") == 0) {
+    const gchar* object_path;
+    GVariantIter* iter;
+
+    g_variant_get(parameters, "(&oas)", &object_path, &iter);
+    g_variant_iter_free(iter);
+
+    ObjectMap::iterator it = self->objects_.find(object_path);
+    if (it == self->objects_.end())
+      return;
+
+    for (PropertyMap::iterator property = it->second.begin();
+         property != it->second.end(); ++property)
+      g_variant_unref(property->second);
+    self->objects_.erase(it);
+    self->changed_ = true;
+  } else {
+    return;
+  }
+
+  self->TrackReferences();
+  self->ScheduleNotify();
+}
+
+void NetworkManagerMirror::OnNameOwnerChanged(GDBusConnection* connection,
+                                              const gchar* sender,
+                                              const gchar* path,
+                                              const gchar* interface,
+                                              const gchar* signal,
+                                              GVariant* parameters,
+                                              gpointer user_data) {
+  NetworkManagerMirror* self =
+      reinterpret_cast<NetworkManagerMirror*>(user_data);
+  const gchar* name;
+  const gchar* old_owner;
+  const gchar* new_owner;
+
+  g_variant_get(parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+
+  // NetworkManager restarted or went away, start over.
+  self->Reset();
+  self->changed_ = true;
+  if (new_owner && *new_owner)
+    self->Fetch(NM_DBUS_PATH, NM_DBUS_INTERFACE);
+  self->ScheduleNotify();
+}
+
+void NetworkManagerMirror::Reset() {
+  for (ObjectMap::iterator object = objects_.begin();
+       object != objects_.end(); ++object) {
+    for (PropertyMap::iterator property = object->second.begin();
+         property != object->second.end(); ++property)
+      g_variant_unref(property->second);
+  }
+  objects_.clear();
+  pending_.clear();
+  generation_++;
+}
+
+void NetworkManagerMirror::ApplyProperties(const std::string& path,
+                                           GVariant* properties) {
+  PropertyMap& object = objects_[path];
+  GVariantIter iter;
+  const gchar* name;
+  GVariant* value;
+
+  g_variant_iter_init(&iter, properties);
+  while (g_variant_iter_next(&iter, "{&sv}", &name, &value)) {
+    PropertyMap::iterator property = object.find(name);
+    if (property == object.end()) {
+      object[name] = value;
+    } else if (g_variant_equal(property->second, value)) {
+      g_variant_unref(value);
+      continue;
+    } else {
+      g_variant_unref(property->second);
+      property->second = value;
+    }
+    changed_ = true;
+  }
+}
+
+void NetworkManagerMirror::TrackReferences() {
+  // Walk manager -> active connections -> devices -> access point and IP
+  // configurations, collecting every object the properties depend on.
+  std::map<std::string, const char*> referenced;
+  referenced[NM_DBUS_PATH] = NM_DBUS_INTERFACE;
+
+  GVariant* connections = GetProperty(NM_DBUS_PATH, "ActiveConnections");
+  gsize n_connections = connections &&
+      g_variant_is_of_type(connections, G_VARIANT_TYPE("ao")) ?
+      g_variant_n_children(connections) : 0;
+  for (gsize i = 0; i < n_connections; ++i) {
+    GVariant* child = g_variant_get_child_value(connections, i);
+    std::string connection = g_variant_get_string(child, NULL);
+    g_variant_unref(child);
+    referenced[connection] = NM_DBUS_INTERFACE_ACTIVE_CONNECTION;
+
+    GVariant* devices = GetProperty(connection, "Devices");
+    gsize n_devices = devices &&
+        g_variant_is_of_type(devices, G_VARIANT_TYPE("ao")) ?
+        g_variant_n_children(devices) : 0;
+    for (gsize j = 0; j < n_devices; ++j) {
+      child = g_variant_get_child_value(devices, j);
+      std::string device = g_variant_get_string(child, NULL);
+      g_variant_unref(child);
+      referenced[device] = NM_DBUS_INTERFACE_DEVICE;
+
+      std::string access_point = GetObjectPath(device, "ActiveAccessPoint");
+      if (!access_point.empty())
+        referenced[access_point] = NM_DBUS_INTERFACE_ACCESS_POINT;
+      std::string ip6_config = GetObjectPath(device, "Ip6Config");
+      if (!ip6_config.empty())
+        referenced[ip6_config] = NM_DBUS_INTERFACE_IP6_CONFIG;
+    }
+  }
+
+  // Forget objects nothing points to anymore, e.g. the previous access
+  // point after roaming.
+  ObjectMap::iterator object = objects_.begin();
+  while (object != objects_.end()) {
+    if (referenced.count(object->first)) {
+      ++object;
+      continue;
+    }
+    for (PropertyMap::iterator property = object->second.begin();
+         property != object->second.end(); ++property)
+      g_variant_unref(property->second);
+    objects_.erase(object++);
+    changed_ = true;
+  }
+
+  for (std::map<std::string, const char*>::iterator it = referenced.begin();
+       it != referenced.end(); ++it) {
+    if (objects_.count(it->first))
+      continue;
+    Fetch(it->first, it->second);
+    if (strcmp(it->second, NM_DBUS_INTERFACE_DEVICE) == 0)
+      Fetch(it->first, sWirelessInterface);
+  }
+}
+
+void NetworkManagerMirror::ScheduleNotify() {
+  if (notify_id_ == 0)
+    notify_id_ = g_idle_add(NetworkManagerMirror::OnNotifyIdle, this);
+}
+
+gboolean NetworkManagerMirror::OnNotifyIdle(gpointer user_data) {
+  NetworkManagerMirror* self =
+      reinterpret_cast<NetworkManagerMirror*>(user_data);
+
+  self->notify_id_ = 0;
+  // Wait for newly referenced objects, so a roam or reconnection results in
+  // a single notification with the settled state.
+  if (!self->changed_ || !self->pending_.empty())
+    return FALSE;
+  self->changed_ = false;
+
+  std::list<Observer> observers = self->observers_;
+  for (std::list<Observer>::iterator it = observers.begin();
+       it != observers.end(); ++it)
+    it->first(it->second);
+
+  return FALSE;
+}
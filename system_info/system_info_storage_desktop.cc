@@ -20,6 +20,7 @@ SysInfoStorage::SysInfoStorage()
     : timeout_cb_id_(0) {
   udev_ = udev_new();
   units_ = picojson::value(picojson::array(0));
+  SetCacheTTL(system_info::default_timeout_interval);
 }
 
 SysInfoStorage::~SysInfoStorage() {
@@ -32,7 +33,7 @@ bool SysInfoStorage::Update(picojson::value& error) {
   units_arr.clear();
 
   FILE *aFile;
-  aFile = setmntent(sMountTable, "r");
+  aFile = setmntent(system_info::GetSysrootPath(sMountTable).c_str(), "r");
   if (!aFile) {
     system_info::SetPicoJsonObjectValue(error, "message",
         picojson::value("Read mount table failed."));
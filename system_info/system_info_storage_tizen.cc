@@ -19,6 +19,7 @@ const char* sStorageSDCardPath = "/opt/storage/sdcard";
 SysInfoStorage::SysInfoStorage()
     : timeout_cb_id_(0) {
   units_ = picojson::value(picojson::array(0));
+  SetCacheTTL(system_info::default_timeout_interval);
 }
 
 SysInfoStorage::~SysInfoStorage() {
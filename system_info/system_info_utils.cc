@@ -4,17 +4,56 @@
 
 #include "system_info/system_info_utils.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <fstream>
+#include <set>
 
 namespace {
 
 const int kDuid_buffer_size = 100;
 const char kDuid_str_key[] = "http://tizen.org/system/duid";
 
+pthread_mutex_t g_record_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+bool MakeDirectories(const std::string& path) {
+  for (size_t pos = path.find('/', 1); pos != std::string::npos;
+       pos = path.find('/', pos + 1)) {
+    if (mkdir(path.substr(0, pos).c_str(), 0755) && errno != EEXIST)
+      return false;
+  }
+
+  return true;
+}
+
+// Files under /proc and /sys report a zero size, so copy until EOF.
+void RecordFile(const std::string& source, const std::string& destination) {
+  int in = open(source.c_str(), O_RDONLY);
+  if (in < 0)
+    return;
+
+  int out = -1;
+  if (MakeDirectories(destination))
+    out = open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  char buffer[8192];
+  ssize_t length;
+  while (out >= 0 && (length = read(in, buffer, sizeof(buffer))) > 0) {
+    if (write(out, buffer, length) != length)
+      break;
+  }
+
+  if (out >= 0)
+    close(out);
+  close(in);
+}
+
 }  // namespace
 
 namespace system_info {
@@ -24,7 +63,8 @@ char* GetDuidProperty() {
   FILE *fp = NULL;
   static char duid[kDuid_buffer_size] = {0, };
   size_t len = strlen(kDuid_str_key);
-  fp = fopen("/opt/usr/etc/system_info_cache.ini", "r");
+  fp = fopen(GetSysrootPath("/opt/usr/etc/system_info_cache.ini").c_str(),
+             "r");
 
   if (fp) {
     while (fgets(duid, kDuid_buffer_size - 1, fp)) {
@@ -67,10 +107,11 @@ char* ReadOneLine(const char* path) {
     return NULL;
 
   read = getline(&line, &len, fp);
-  if (-1 == read)
-    return NULL;
-
   fclose(fp);
+  if (-1 == read) {
+    free(line);
+    return NULL;
+  }
 
   return line;
 }
@@ -112,4 +153,20 @@ std::string GetPropertyFromFile(const std::string& file_path,
   return "";
 }
 
+std::string GetSysrootPath(const std::string& path) {
+  static const char* sysroot = getenv("SYSTEM_INFO_SYSROOT");
+  static const char* record_dir = getenv("SYSTEM_INFO_RECORD_DIR");
+
+  std::string resolved = sysroot ? sysroot + path : path;
+  if (!record_dir)
+    return resolved;
+
+  static std::set<std::string> recorded;
+  AutoLock lock(&g_record_mutex);
+  if (recorded.insert(path).second)
+    RecordFile(resolved, record_dir + path);
+
+  return resolved;
+}
+
 }  // namespace system_info
@@ -24,6 +24,8 @@ namespace system_info {
 
 // The default timeout interval is set to 1s to match the top update interval.
 const int default_timeout_interval = 1000;
+// Properties that rarely change are served from memory for this long, in ms.
+const int default_cache_ttl = 5000;
 char* GetDuidProperty();
 int ReadOneByte(const char* path);
 // Free the returned value after using.
@@ -35,6 +37,11 @@ void SetPicoJsonObjectValue(picojson::value& obj,
                             const picojson::value& val);
 std::string GetPropertyFromFile(const std::string& file_path,
                                 const std::string& key);
+// Returns |path| prefixed with the SYSTEM_INFO_SYSROOT environment variable,
+// so a recorded fixture can stand in for the running system. When
+// SYSTEM_INFO_RECORD_DIR is set, the file is also copied under that
+// directory the first time it is resolved, recording a fixture.
+std::string GetSysrootPath(const std::string& path);
 inline bool PathExists(const char* path) {
   return 0 == access(path, F_OK);
 }
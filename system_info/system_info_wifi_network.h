@@ -17,16 +17,6 @@
 #include "system_info/system_info_instance.h"
 #include "system_info/system_info_utils.h"
 
-#if defined(GENERIC_DESKTOP)
-#define G_CALLBACK_WIFI(METHOD, SENDER, ARG0)                                \
-  static void METHOD ## Thunk(SENDER sender, ARG0 res, gpointer userdata) {  \
-    return reinterpret_cast<SysInfoWifiNetwork*>(userdata)->METHOD(sender,   \
-                                                                   res);     \
-  }                                                                          \
-                                                                             \
-  void METHOD(SENDER, ARG0);
-#endif
-
 class SysInfoWifiNetwork : public SysInfoObject {
  public:
   static SysInfoObject& GetInstance() {
@@ -40,6 +30,9 @@ class SysInfoWifiNetwork : public SysInfoObject {
 
   static const std::string name_;
 
+ protected:
+  const char* ThresholdKey() const { return "signalStrength"; }
+
  private:
   explicit SysInfoWifiNetwork();
   void PlatformInitialize();
@@ -55,38 +48,12 @@ class SysInfoWifiNetwork : public SysInfoObject {
   std::string status_;
 
 #if defined(GENERIC_DESKTOP)
-  G_CALLBACK_WIFI(OnAccessPointCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnActiveAccessPointCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnActiveConnectionCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnDevicesCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnNetworkManagerCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnIPAddressCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnIPv6AddressCreated, GObject*, GAsyncResult*);
-  G_CALLBACK_WIFI(OnUpdateIPv6Address, GObject*, GAsyncResult*);
-
+  static void OnNetworkManagerChanged(gpointer user_data);
+  bool UpdateFromNetworkManager();
   std::string IPAddressConverter(unsigned int ip);
-  void UpdateActiveAccessPoint(GVariant* value);
-  void UpdateActiveConnection(GVariant* value);
-  void UpdateActiveDevice(GVariant* value);
-  void UpdateDeviceType(GVariant* value);
-  void UpdateIPAddress(GVariant* value);
-  void UpdateIPv6Address(GVariant* value);
-  void UpdateSignalStrength(GVariant* value);
-  void UpdateSSID(GVariant* value);
-  void UpdateStatus(guint new_device_type);
-
-  static void OnAccessPointSignal(GDBusProxy* proxy, gchar* sender,
-      gchar* signal, GVariant* parameters, gpointer user_data);
-  static void OnActiveConnectionsSignal(GDBusProxy* proxy, gchar* sender,
-      gchar* signal, GVariant* parameters, gpointer user_data);
-  static void OnNetworkManagerSignal(GDBusProxy* proxy, gchar* sender,
-      gchar* signal, GVariant* parameters, gpointer user_data);
+  std::string IPv6AddressConverter(GVariant* addresses);
+  std::string SSIDConverter(GVariant* ssid);
 
-  guint device_type_;
-  std::string active_access_point_;
-  std::string active_connection_;
-  std::string active_device_;
-  std::string ipv6_config_;
   unsigned int ip_address_desktop_;
 #elif defined(TIZEN)
   bool GetIPv4Address();
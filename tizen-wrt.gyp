@@ -9,6 +9,7 @@
       'type': 'none',
       'dependencies': [
         'bluetooth/bluetooth.gyp:*',
+        'filesystem/filesystem.gyp:*',
         'mediaserver/mediaserver.gyp:*',
         'network_bearer_selection/network_bearer_selection.gyp:*',
         'notification/notification.gyp:*',
@@ -27,7 +28,6 @@
             'callhistory/callhistory.gyp:*',
             'content/content.gyp:*',
             'download/download.gyp:*',
-            'filesystem/filesystem.gyp:*',
             'messageport/messageport.gyp:*',
           ],
         }],